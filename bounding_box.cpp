@@ -0,0 +1,146 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file bounding_box.cpp
+ * Implementation of axis-aligned bounding boxes.
+ */
+
+#include <sstream>
+#include <cfloat>
+#include "bounding_box.h"
+
+using namespace std;
+
+Bounding_Box::Bounding_Box()
+{
+   for(int i = 0; i < 3; ++i)
+   {
+      min[i] = FLT_MAX;
+      max[i] = -FLT_MAX;
+   }
+}
+
+Bounding_Box::Bounding_Box(GLfloat min_x, GLfloat min_y, GLfloat min_z,
+                           GLfloat max_x, GLfloat max_y, GLfloat max_z)
+{
+   min[0] = min_x; min[1] = min_y; min[2] = min_z;
+   max[0] = max_x; max[1] = max_y; max[2] = max_z;
+}
+
+bool Bounding_Box::is_empty() const
+{
+   return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+}
+
+bool Bounding_Box::overlaps(const Bounding_Box &b) const
+{
+   for(int i = 0; i < 3; ++i)
+      if(min[i] > b.max[i] || b.min[i] > max[i])
+         return false;
+   return !is_empty() && !b.is_empty();
+}
+
+bool Bounding_Box::contains(const Bounding_Box &b) const
+{
+   if(b.is_empty())
+      return true;
+   for(int i = 0; i < 3; ++i)
+      if(b.min[i] < min[i] || b.max[i] > max[i])
+         return false;
+   return true;
+}
+
+bool Bounding_Box::hit_by_ray(const GLfloat origin[3],
+                              const GLfloat direction[3]) const
+{
+   if(is_empty())
+      return false;
+
+   // Clip the ray against the slab between the planes of each axis.
+   GLfloat near = 0, far = FLT_MAX;
+   for(int i = 0; i < 3; ++i)
+   {
+      if(direction[i] == 0)
+      {
+         if(origin[i] < min[i] || origin[i] > max[i])
+            return false;
+         continue;
+      }
+
+      GLfloat t1 = (min[i] - origin[i]) / direction[i];
+      GLfloat t2 = (max[i] - origin[i]) / direction[i];
+      if(t1 > t2)
+      {
+         GLfloat t = t1;
+         t1 = t2;
+         t2 = t;
+      }
+      if(t1 > near) near = t1;
+      if(t2 < far) far = t2;
+      if(near > far)
+         return false;
+   }
+   return true;
+}
+
+void Bounding_Box::add_point(GLfloat x, GLfloat y, GLfloat z)
+{
+   GLfloat p[3] = { x, y, z };
+   for(int i = 0; i < 3; ++i)
+   {
+      if(p[i] < min[i]) min[i] = p[i];
+      if(p[i] > max[i]) max[i] = p[i];
+   }
+}
+
+void Bounding_Box::intersect(const Bounding_Box &b)
+{
+   for(int i = 0; i < 3; ++i)
+   {
+      if(b.min[i] > min[i]) min[i] = b.min[i];
+      if(b.max[i] < max[i]) max[i] = b.max[i];
+   }
+}
+
+void Bounding_Box::unite(const Bounding_Box &b)
+{
+   for(int i = 0; i < 3; ++i)
+   {
+      if(b.min[i] < min[i]) min[i] = b.min[i];
+      if(b.max[i] > max[i]) max[i] = b.max[i];
+   }
+}
+
+string Bounding_Box::stringify() const
+{
+   if(is_empty())
+      return "[ empty ]";
+
+   ostringstream representation;
+   representation << "[ " << min[0] << " " << min[1] << " " << min[2] << " - "
+                  << max[0] << " " << max[1] << " " << max[2] << " ]";
+   return representation.str();
+}
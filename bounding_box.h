@@ -0,0 +1,79 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file bounding_box.h
+ * Axis-aligned bounding boxes in world coordinates.
+ */
+
+#ifndef __BOUNDING_BOX_H__
+#define __BOUNDING_BOX_H__
+
+#include <string>
+#include <GL/gl.h>
+
+/*!
+ * An axis-aligned box. A box where min is larger than max along any axis
+ * is empty, which is what a default constructed box is.
+ */
+class Bounding_Box
+{
+public:
+   //! Creates an empty box.
+   Bounding_Box();
+   Bounding_Box(GLfloat min_x, GLfloat min_y, GLfloat min_z,
+                GLfloat max_x, GLfloat max_y, GLfloat max_z);
+
+   bool is_empty() const;
+
+   //! True if the boxes have at least one point in common.
+   bool overlaps(const Bounding_Box &b) const;
+
+   //! True if every point of b is in the box. Any box contains an empty one.
+   bool contains(const Bounding_Box &b) const;
+
+   /*!
+    * True if the ray from origin in direction passes through the box.
+    * direction does not have to be normalized.
+    */
+   bool hit_by_ray(const GLfloat origin[3], const GLfloat direction[3]) const;
+
+   //! Grows the box to include a point.
+   void add_point(GLfloat x, GLfloat y, GLfloat z);
+
+   //! Shrinks the box to the part it has in common with b.
+   void intersect(const Bounding_Box &b);
+
+   //! Grows the box to include b.
+   void unite(const Bounding_Box &b);
+
+   //! Exports a string representation, for debugging.
+   std::string stringify() const;
+
+   GLfloat min[3];
+   GLfloat max[3];
+};
+
+#endif
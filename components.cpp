@@ -0,0 +1,294 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file components.cpp
+ * Grouping of the top unions of a CSG tree by overlap.
+ */
+
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include "debug.h"
+#include "csg_visitor.h"
+#include "prune.h"
+#include "components.h"
+
+using namespace std;
+
+//! Finds the representative of x in a union-find forest.
+static unsigned int find_root(vector<unsigned int> &parent, unsigned int x)
+{
+   while(parent[x] != x)
+   {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+   }
+   return x;
+}
+
+Component_Set::Component_Set(Incremental_Normalizer &normalizer) :
+   _normalizer(normalizer), _products_dirty(false), _prunings(0)
+{
+}
+
+Component_Set::~Component_Set()
+{
+   clear();
+}
+
+//! Remembers which term the primitives of a tree are in.
+struct Term_Recorder : public CSG_Visitor<const CSG_Node>
+{
+   Term_Recorder(multimap<const CSG_Object *, unsigned int> &term_of,
+                 unsigned int term) :
+      term_of(term_of), term(term)
+   {
+   }
+
+   void leave(const CSG_Node *tree)
+   {
+      if(tree->get_type() == CSG_Node::PRIMITIVE)
+         term_of.insert(make_pair((const CSG_Object *)tree->get_object(), term));
+   }
+
+   multimap<const CSG_Object *, unsigned int> &term_of;
+   unsigned int term;
+};
+
+void Component_Set::add_objects(const CSG_Node *tree, unsigned int term)
+{
+   Term_Recorder recorder(_term_of, term);
+   visit_tree(tree, recorder);
+}
+
+void Component_Set::assign(const CSG_Node *tree)
+{
+   clear();
+   if(!tree)
+      return;
+
+   // Walk the unions from left to right, like Product_List::assign().
+   vector<const CSG_Node *> stack(1, tree);
+   while(!stack.empty())
+   {
+      const CSG_Node *node = stack.back();
+      stack.pop_back();
+
+      if(node->get_type() == CSG_Node::UNION)
+      {
+         stack.push_back(node->get_right());
+         stack.push_back(node->get_left());
+         continue;
+      }
+
+      Term term;
+      term.tree = node;
+      term.normal = _normalizer.normalize_tree(node, &_arena);
+      term.bounds = get_bounds(node);
+      term.dirty = true;
+      term.component = 0;
+      _terms.push_back(term);
+      add_objects(node, _terms.size() - 1);
+   }
+
+   vector<unsigned int> all(_terms.size());
+   for(unsigned int i = 0; i < all.size(); ++i)
+      all[i] = i;
+   group(all);
+
+   DBG(cout << "Component_Set::assign: " << _terms.size() << " operands in "
+            << _components.size() << " components" << endl);
+}
+
+void Component_Set::clear()
+{
+   _terms.clear();
+   _arena.clear();
+   _components.clear();
+   _term_of.clear();
+   _products.clear();
+   _products_dirty = false;
+   _prunings = 0;
+}
+
+/*
+ * Makes new components of the given terms. Sweeps along the X axis, so that
+ * every box is only tested against the ones that start before it and have
+ * not ended yet.
+ */
+void Component_Set::group(const vector<unsigned int> &terms)
+{
+   vector<unsigned int> parent(terms.size());
+   vector<pair<GLfloat, unsigned int> > order;
+   for(unsigned int i = 0; i < terms.size(); ++i)
+   {
+      parent[i] = i;
+      const Bounding_Box &box = _terms[terms[i]].bounds;
+      if(!box.is_empty())
+         order.push_back(make_pair(box.min[0], i));
+   }
+   sort(order.begin(), order.end());
+
+   vector<unsigned int> active;
+   for(unsigned int k = 0; k < order.size(); ++k)
+   {
+      unsigned int i = order[k].second;
+      const Bounding_Box &box = _terms[terms[i]].bounds;
+
+      unsigned int kept = 0;
+      for(unsigned int a = 0; a < active.size(); ++a)
+      {
+         const Bounding_Box &other = _terms[terms[active[a]]].bounds;
+         if(other.max[0] < box.min[0])
+            continue; // Nothing later can reach it either.
+         active[kept++] = active[a];
+         if(other.overlaps(box))
+            parent[find_root(parent, i)] = find_root(parent, active[a]);
+      }
+      active.resize(kept);
+      active.push_back(i);
+   }
+
+   // Number the components in the order their first terms were given.
+   map<unsigned int, unsigned int> component_of_root;
+   for(unsigned int i = 0; i < terms.size(); ++i)
+   {
+      unsigned int root = find_root(parent, i);
+      map<unsigned int, unsigned int>::iterator c = component_of_root.find(root);
+      if(c == component_of_root.end())
+      {
+         c = component_of_root.insert(make_pair(root, _components.size())).first;
+         _components.push_back(Component());
+      }
+
+      Term &term = _terms[terms[i]];
+      Component &component = _components[c->second];
+      term.component = c->second;
+      component.terms.push_back(terms[i]);
+      if(component.bounds.is_empty())
+         component.bounds = term.bounds;
+      else if(!term.bounds.is_empty())
+         component.bounds.unite(term.bounds);
+   }
+
+   _products_dirty = true;
+}
+
+//! Removes a component by moving the last one into its place.
+void Component_Set::remove_component(unsigned int c)
+{
+   if(c != _components.size() - 1)
+   {
+      _components[c] = _components.back();
+      for(unsigned int i = 0; i < _components[c].terms.size(); ++i)
+         _terms[_components[c].terms[i]].component = c;
+   }
+   _components.pop_back();
+}
+
+void Component_Set::regroup(unsigned int t)
+{
+   Term &term = _terms[t];
+   term.bounds = get_bounds(term.tree);
+   term.dirty = true;
+
+   // The old component of the term may have fallen apart, and the term may
+   // have joined other components. Group all of them again.
+   vector<unsigned int> affected(1, term.component);
+   if(!term.bounds.is_empty())
+      for(unsigned int c = 0; c < _components.size(); ++c)
+         if(c != term.component && _components[c].bounds.overlaps(term.bounds))
+            affected.push_back(c);
+
+   // Remove from the back, so that no affected component is moved.
+   sort(affected.begin(), affected.end());
+   vector<unsigned int> terms;
+   for(unsigned int i = affected.size(); i-- > 0;)
+   {
+      const vector<unsigned int> &c = _components[affected[i]].terms;
+      terms.insert(terms.end(), c.begin(), c.end());
+      remove_component(affected[i]);
+   }
+   sort(terms.begin(), terms.end());
+
+   group(terms);
+}
+
+void Component_Set::moved(const CSG_Object *object)
+{
+   typedef multimap<const CSG_Object *, unsigned int>::const_iterator Iterator;
+   pair<Iterator, Iterator> range = _term_of.equal_range(object);
+   for(Iterator i = range.first; i != range.second; ++i)
+      regroup(i->second);
+}
+
+const Product_List &Component_Set::get_products()
+{
+   if(!_products_dirty)
+      return _products;
+
+   _products.clear();
+   for(unsigned int c = 0; c < _components.size(); ++c)
+   {
+      const Component &component = _components[c];
+      for(unsigned int i = 0; i < component.terms.size(); ++i)
+      {
+         Term &term = _terms[component.terms[i]];
+         if(term.dirty)
+         {
+            CSG_Node *pruned = prune(term.normal);
+            term.products.assign(pruned);
+            delete pruned;
+            term.dirty = false;
+            _prunings++;
+         }
+         _products.append(term.products);
+      }
+      _products.end_group(component.bounds);
+   }
+
+   _products_dirty = false;
+   return _products;
+}
+
+unsigned int Component_Set::size() const
+{
+   return _components.size();
+}
+
+int Component_Set::component_of(const CSG_Object *object) const
+{
+   multimap<const CSG_Object *, unsigned int>::const_iterator i =
+      _term_of.find(object);
+   if(i == _term_of.end())
+      return -1;
+   return _terms[i->second].component;
+}
+
+unsigned long Component_Set::prunings() const
+{
+   return _prunings;
+}
@@ -0,0 +1,129 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file components.h
+ * Splits a CSG tree into groups of primitives that do not touch each other.
+ */
+
+#ifndef __COMPONENTS_H__
+#define __COMPONENTS_H__
+
+#include <vector>
+#include <map>
+#include "csg_tree.h"
+#include "csg_arena.h"
+#include "bounding_box.h"
+#include "normalize.h"
+#include "product_list.h"
+
+/*!
+ * The operands of the unions at the top of a CSG tree, grouped into
+ * connected components by their bounding boxes. Two operands are in the
+ * same component if their boxes overlap, directly or through other
+ * operands.
+ *
+ * Every operand is normalized on its own, into an arena that is dropped all
+ * at once by clear() and assign(), and its pruned products are kept
+ * until one of its primitives moves. Moving a primitive only prunes its own
+ * operand again, and only regroups the component it was in together with
+ * the ones it now touches.
+ */
+class Component_Set
+{
+public:
+   //! The operands are normalized with normalizer, which must outlive this.
+   explicit Component_Set(Incremental_Normalizer &normalizer);
+   ~Component_Set();
+
+   /*!
+    * Replaces the contents with the components of tree, and normalizes
+    * them. Call after every change to the tree itself.
+    */
+   void assign(const CSG_Node *tree);
+
+   void clear();
+
+   /*!
+    * Updates everything after object has been moved, rotated or scaled.
+    * Does nothing if object is not in the tree.
+    */
+   void moved(const CSG_Object *object);
+
+   /*!
+    * The pruned products of all components, with one Product_List::Group
+    * per component.
+    */
+   const Product_List &get_products();
+
+   //! Number of components.
+   unsigned int size() const;
+
+   /*!
+    * The component object is in, or -1 if it is not in the tree. If object
+    * is in the tree more than once, the component of one of its places.
+    */
+   int component_of(const CSG_Object *object) const;
+
+   //! Number of times an operand has been pruned since assign().
+   unsigned long prunings() const;
+
+private:
+   Component_Set(const Component_Set &);
+   void operator=(const Component_Set &);
+
+   //! One operand of the top unions.
+   struct Term
+   {
+      const CSG_Node *tree;
+      CSG_Node *normal;       //!< Normalized copy of tree in _arena, or NULL if empty.
+      Bounding_Box bounds;
+      Product_List products;  //!< Pruned products of normal, unless dirty.
+      bool dirty;
+      unsigned int component;
+   };
+
+   struct Component
+   {
+      std::vector<unsigned int> terms;
+      Bounding_Box bounds;
+   };
+
+   void add_objects(const CSG_Node *tree, unsigned int term);
+   void group(const std::vector<unsigned int> &terms);
+   void remove_component(unsigned int c);
+   void regroup(unsigned int term);
+
+   Incremental_Normalizer &_normalizer;
+   CSG_Arena _arena;
+   std::vector<Term> _terms;
+   std::vector<Component> _components;
+   std::multimap<const CSG_Object *, unsigned int> _term_of;
+   Product_List _products;
+   bool _products_dirty;
+   unsigned long _prunings;
+};
+
+#endif
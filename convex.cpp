@@ -0,0 +1,311 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file convex.cpp
+ * The GJK algorithm on the primitives.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "convex.h"
+
+using namespace std;
+
+//! Most iterations of GJK. It needs far fewer on anything but round shapes.
+static const int MAX_ITERATIONS = 64;
+
+//! Closer than this, relative to their size, the shapes touch.
+static const double TOUCHING = 1e-6;
+
+//! A point of the Minkowski difference of two shapes.
+struct Gjk_Point
+{
+   double p[3];
+};
+
+static double dot(const double a[3], const double b[3])
+{
+   return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//! The furthest point of the unit shape of type in direction d.
+static void local_support(Primitive_Store::Type type, const double d[3],
+                          double s[3])
+{
+   switch(type)
+   {
+      case Primitive_Store::CUBE:
+         for(int i = 0; i < 3; ++i)
+            s[i] = d[i] >= 0 ? 0.5 : -0.5;
+         break;
+      case Primitive_Store::SPHERE:
+      {
+         double length = sqrt(dot(d, d));
+         for(int i = 0; i < 3; ++i)
+            s[i] = length > 0 ? 0.5 * d[i] / length : (i == 0 ? 0.5 : 0);
+         break;
+      }
+      case Primitive_Store::CYLINDER:
+      {
+         double radial = sqrt(d[0] * d[0] + d[2] * d[2]);
+         s[0] = radial > 0 ? 0.5 * d[0] / radial : 0;
+         s[1] = d[1] >= 0 ? 0.5 : -0.5;
+         s[2] = radial > 0 ? 0.5 * d[2] / radial : 0;
+         break;
+      }
+   }
+}
+
+/*!
+ * The furthest point of a primitive in world direction d. The direction is
+ * taken to the unit shape by the transpose of the linear part of the
+ * transformation, and the point found there back by the transformation.
+ */
+static void support(const CSG_Object *object, const double d[3], double w[3])
+{
+   const GLfloat *m = object->get_transform().data;
+   double local[3], s[3] = { 0, 0, 0 };
+   for(int c = 0; c < 3; ++c)
+      local[c] = m[4 * c] * d[0] + m[4 * c + 1] * d[1] + m[4 * c + 2] * d[2];
+   local_support(object->get_type(), local, s);
+   for(int r = 0; r < 3; ++r)
+      w[r] = m[12 + r] + m[r] * s[0] + m[4 + r] * s[1] + m[8 + r] * s[2];
+}
+
+//! The furthest point of the Minkowski difference a - b in direction d.
+static void support(const CSG_Object *a, const CSG_Object *b,
+                    const double d[3], double w[3])
+{
+   double opposite[3] = { -d[0], -d[1], -d[2] };
+   double wa[3], wb[3];
+   support(a, d, wa);
+   support(b, opposite, wb);
+   for(int i = 0; i < 3; ++i)
+      w[i] = wa[i] - wb[i];
+}
+
+/*!
+ * Solves the k by k system g x = b, k at most 3, by Gaussian elimination.
+ * Returns false if it is singular.
+ */
+static bool solve(double g[3][3], double b[3], int k, double x[3])
+{
+   for(int col = 0; col < k; ++col)
+   {
+      int pivot = col;
+      for(int row = col + 1; row < k; ++row)
+         if(fabs(g[row][col]) > fabs(g[pivot][col]))
+            pivot = row;
+      if(fabs(g[pivot][col]) < 1e-14 * (fabs(g[0][0]) + 1e-300))
+         return false;
+      for(int i = 0; i < k; ++i)
+         swap(g[col][i], g[pivot][i]);
+      swap(b[col], b[pivot]);
+      for(int row = col + 1; row < k; ++row)
+      {
+         double f = g[row][col] / g[col][col];
+         for(int i = col; i < k; ++i)
+            g[row][i] -= f * g[col][i];
+         b[row] -= f * b[col];
+      }
+   }
+   for(int row = k; row-- > 0;)
+   {
+      x[row] = b[row];
+      for(int i = row + 1; i < k; ++i)
+         x[row] -= g[row][i] * x[i];
+      x[row] /= g[row][row];
+   }
+   return true;
+}
+
+/*!
+ * Finds the point v of the convex hull of the simplex that is closest to
+ * the origin, and drops the points of the simplex that are not needed to
+ * reach it. Every subset of the at most four points is tried: the origin
+ * is projected on the affine hull of the subset, and the projection counts
+ * if it is inside the subset. The closest of those is the answer.
+ */
+static void closest_on_simplex(vector<Gjk_Point> &simplex, double v[3])
+{
+   int n = simplex.size();
+   double best = -1;
+   int best_mask = 1;
+   for(int mask = 1; mask < (1 << n); ++mask)
+   {
+      int index[4] = { 0, 0, 0, 0 }, k = 0;
+      for(int i = 0; i < n; ++i)
+         if(mask & (1 << i))
+            index[k++] = i;
+
+      const double *q0 = simplex[index[0]].p;
+      double edge[3][3], g[3][3], b[3], lambda[3];
+      for(int i = 1; i < k; ++i)
+         for(int j = 0; j < 3; ++j)
+            edge[i - 1][j] = simplex[index[i]].p[j] - q0[j];
+      for(int i = 0; i < k - 1; ++i)
+      {
+         for(int j = 0; j < k - 1; ++j)
+            g[i][j] = dot(edge[i], edge[j]);
+         b[i] = -dot(edge[i], q0);
+      }
+      if(k > 1 && !solve(g, b, k - 1, lambda))
+         continue;
+
+      double first = 1;
+      bool inside = true;
+      for(int i = 0; i < k - 1; ++i)
+      {
+         first -= lambda[i];
+         inside = inside && lambda[i] > 0;
+      }
+      if(!inside || first <= 0)
+         continue;
+
+      double point[3];
+      for(int j = 0; j < 3; ++j)
+      {
+         point[j] = q0[j];
+         for(int i = 0; i < k - 1; ++i)
+            point[j] += lambda[i] * edge[i][j];
+      }
+      double distance = dot(point, point);
+      if(best < 0 || distance < best)
+      {
+         best = distance;
+         best_mask = mask;
+         for(int j = 0; j < 3; ++j)
+            v[j] = point[j];
+      }
+   }
+
+   vector<Gjk_Point> kept;
+   for(int i = 0; i < n; ++i)
+      if(best_mask & (1 << i))
+         kept.push_back(simplex[i]);
+   simplex.swap(kept);
+}
+
+//! The length of the longest side of the box of a primitive.
+static double size(const CSG_Object *object)
+{
+   const Bounding_Box &box = object->get_bounds();
+   double longest = 0;
+   for(int i = 0; i < 3; ++i)
+      longest = max(longest, double(box.max[i] - box.min[i]));
+   return longest;
+}
+
+/*!
+ * Runs GJK on a - b, and returns the distance between a and b, or 0 if
+ * they touch. With separate, it stops as soon as it knows that they are
+ * further apart than touching, and returns a lower bound of the distance.
+ * Anything that is not proven to be further apart than touching, such as
+ * when it runs out of iterations, is taken to touch, so that pruning on
+ * the result never drops a product that is there.
+ */
+static double gjk(const CSG_Object *a, const CSG_Object *b, bool separate)
+{
+   double tolerance = TOUCHING * max(size(a), size(b));
+   if(tolerance == 0)
+      tolerance = TOUCHING;
+
+   const GLfloat *ma = a->get_transform().data;
+   const GLfloat *mb = b->get_transform().data;
+   double d[3];
+   for(int i = 0; i < 3; ++i)
+      d[i] = ma[12 + i] - mb[12 + i];
+   if(dot(d, d) == 0)
+      d[0] = 1;
+
+   vector<Gjk_Point> simplex(1);
+   support(a, b, d, simplex[0].p);
+   double v[3] = { simplex[0].p[0], simplex[0].p[1], simplex[0].p[2] };
+
+   for(int iteration = 0; iteration < MAX_ITERATIONS; ++iteration)
+   {
+      double vv = dot(v, v);
+      if(vv <= tolerance * tolerance)
+         return 0;
+      double length = sqrt(vv);
+
+      // Every point of a - b is at least this far along v. If that is
+      // further than touching, the shapes are apart.
+      double minus_v[3] = { -v[0], -v[1], -v[2] };
+      Gjk_Point w;
+      support(a, b, minus_v, w.p);
+      double lower = dot(v, w.p) / length;
+      if(separate && lower > tolerance)
+         return lower;
+      if(length - lower <= tolerance)
+         return lower > tolerance ? length : 0;
+
+      simplex.push_back(w);
+      closest_on_simplex(simplex, v);
+      if(simplex.size() == 4)
+         return 0; // The origin is inside the tetrahedron.
+   }
+   return 0;
+}
+
+bool primitives_overlap(const CSG_Object *a, const CSG_Object *b)
+{
+   if(!a->get_bounds().overlaps(b->get_bounds()))
+      return false;
+   return gjk(a, b, true) == 0;
+}
+
+GLfloat primitive_distance(const CSG_Object *a, const CSG_Object *b)
+{
+   return gjk(a, b, false);
+}
+
+bool primitive_contains(const CSG_Object *object, const GLfloat point[3])
+{
+   const Matrix &inverse = object->get_inverse();
+   if(inverse.data[15] == 0)
+      return false; // A flat shape has no inside.
+
+   const GLfloat *m = inverse.data;
+   double p[3];
+   for(int r = 0; r < 3; ++r)
+      p[r] = m[12 + r] + m[r] * point[0] + m[4 + r] * point[1] +
+         m[8 + r] * point[2];
+
+   const double limit = 0.5 * (1 + TOUCHING);
+   switch(object->get_type())
+   {
+      case Primitive_Store::CUBE:
+         return fabs(p[0]) <= limit && fabs(p[1]) <= limit &&
+            fabs(p[2]) <= limit;
+      case Primitive_Store::SPHERE:
+         return dot(p, p) <= limit * limit;
+      case Primitive_Store::CYLINDER:
+         return fabs(p[1]) <= limit && p[0] * p[0] + p[2] * p[2] <= limit * limit;
+   }
+   return false;
+}
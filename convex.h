@@ -0,0 +1,58 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file convex.h
+ * Exact tests on pairs of primitives, which are all convex.
+ */
+
+#ifndef __CONVEX_H__
+#define __CONVEX_H__
+
+#include <GL/gl.h>
+#include "csg_object.h"
+
+/*
+ * The primitives are the unit shapes of csg_object.h under their
+ * transformations: the cube from -0.5 to 0.5, the sphere of radius 0.5,
+ * and the cylinder of radius 0.5 around the Y axis from -0.5 to 0.5. Any
+ * affine transformation keeps them convex, so the tests below find the
+ * distance between them with the GJK algorithm, which only asks each shape
+ * for its furthest point in a direction.
+ *
+ * The results are exact up to rounding. To keep pruning safe, shapes that
+ * come closer than about a millionth of their size count as touching.
+ */
+
+//! True if the two primitives have a point in common.
+bool primitives_overlap(const CSG_Object *a, const CSG_Object *b);
+
+//! The distance between the two primitives, or 0 if they overlap.
+GLfloat primitive_distance(const CSG_Object *a, const CSG_Object *b);
+
+//! True if the world-space point is inside the primitive or on its surface.
+bool primitive_contains(const CSG_Object *object, const GLfloat point[3]);
+
+#endif
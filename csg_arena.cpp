@@ -0,0 +1,122 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_arena.cpp
+ * Implementation of the arena.
+ */
+
+#include <cassert>
+#include "csg_arena.h"
+
+using namespace std;
+
+//! Pieces per block.
+static const unsigned int BLOCK_PIECES = 1024;
+
+CSG_Arena::CSG_Arena() :
+   _piece(0), _next(NULL), _end(NULL), _free(NULL), _size(0)
+{
+   pthread_mutex_init(&_mutex, NULL);
+}
+
+CSG_Arena::~CSG_Arena()
+{
+   clear();
+   pthread_mutex_destroy(&_mutex);
+}
+
+void *CSG_Arena::allocate(size_t size)
+{
+   pthread_mutex_lock(&_mutex);
+
+   if(!_piece)
+   {
+      // Released pieces must hold the link to the next one.
+      _piece = size < sizeof(void *) ? sizeof(void *) : size;
+      _piece = (_piece + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+   }
+   assert(size <= _piece);
+
+   void *piece;
+   if(_free)
+   {
+      piece = _free;
+      _free = *(void **)_free;
+   }
+   else
+   {
+      if(_next == _end)
+      {
+         _blocks.push_back(new char[_piece * BLOCK_PIECES]);
+         _next = _blocks.back();
+         _end = _next + _piece * BLOCK_PIECES;
+      }
+      piece = _next;
+      _next += _piece;
+   }
+   _size++;
+
+   pthread_mutex_unlock(&_mutex);
+   return piece;
+}
+
+void CSG_Arena::release(void *piece)
+{
+   pthread_mutex_lock(&_mutex);
+   *(void **)piece = _free;
+   _free = piece;
+   _size--;
+   pthread_mutex_unlock(&_mutex);
+}
+
+void CSG_Arena::clear()
+{
+   pthread_mutex_lock(&_mutex);
+   for(unsigned int i = 0; i < _blocks.size(); ++i)
+      delete[] _blocks[i];
+   _blocks.clear();
+   _piece = 0;
+   _next = _end = NULL;
+   _free = NULL;
+   _size = 0;
+   pthread_mutex_unlock(&_mutex);
+}
+
+unsigned long CSG_Arena::size() const
+{
+   pthread_mutex_lock(&_mutex);
+   unsigned long size = _size;
+   pthread_mutex_unlock(&_mutex);
+   return size;
+}
+
+unsigned long CSG_Arena::capacity() const
+{
+   pthread_mutex_lock(&_mutex);
+   unsigned long capacity = _blocks.size() * _piece * BLOCK_PIECES;
+   pthread_mutex_unlock(&_mutex);
+   return capacity;
+}
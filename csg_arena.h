@@ -0,0 +1,88 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_arena.h
+ * Memory for CSG trees that are thrown away all at once.
+ */
+
+#ifndef __CSG_ARENA_H__
+#define __CSG_ARENA_H__
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+
+/*!
+ * Hands out pieces of memory of the same size from large blocks, so that
+ * the nodes of a tree allocated in it lie next to each other, and frees
+ * them all at once when it is cleared. Pieces that are released before that
+ * are reused. Used through CSG_Node::operator new(size_t, CSG_Arena *).
+ *
+ * All functions can be called from several threads at the same time.
+ */
+class CSG_Arena
+{
+public:
+   CSG_Arena();
+
+   //! Frees all memory, like clear().
+   ~CSG_Arena();
+
+   /*!
+    * Returns a piece of size bytes. Every call must ask for the same size
+    * until the arena is cleared.
+    */
+   void *allocate(std::size_t size);
+
+   //! Gives back a piece from allocate(), to be reused.
+   void release(void *piece);
+
+   /*!
+    * Frees all memory at once, without destroying anything in it. Nothing
+    * that was allocated in the arena may be used or deleted afterwards.
+    */
+   void clear();
+
+   //! Number of pieces that have been allocated and not released.
+   unsigned long size() const;
+
+   //! Number of bytes taken from the heap.
+   unsigned long capacity() const;
+
+private:
+   CSG_Arena(const CSG_Arena &);
+   void operator=(const CSG_Arena &);
+
+   std::vector<char *> _blocks;
+   std::size_t _piece;  //!< Size of every piece, or 0 before the first.
+   char *_next;         //!< Next unused piece in the last block.
+   char *_end;          //!< End of the last block.
+   void *_free;         //!< Released pieces, linked through their first word.
+   unsigned long _size;
+   mutable pthread_mutex_t _mutex;
+};
+
+#endif
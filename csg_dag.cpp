@@ -0,0 +1,348 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_dag.cpp
+ * Implementation of the hash-consed CSG DAG.
+ */
+
+#include <cassert>
+#include <cstddef>
+#ifdef DEBUG
+#  include <iostream>
+#endif
+#include "debug.h"
+#include "csg_dag.h"
+#include "csg_visitor.h"
+
+using namespace std;
+
+static const unsigned long INITIAL_BUCKETS = 256;
+
+CSG_Dag_Node::CSG_Dag_Node(CSG_Node::CSG_Type type, CSG_Object *object,
+                           const CSG_Dag_Node *left, const CSG_Dag_Node *right,
+                           unsigned long hash) :
+   _type(type), _object(object), _left(left), _right(right),
+   _hash(hash), _next(NULL), _normal(NULL), _mark(0)
+{
+}
+
+const CSG_Dag_Node *CSG_Dag_Node::get_left() const
+{
+   assert(_left);
+   return _left;
+}
+
+const CSG_Dag_Node *CSG_Dag_Node::get_right() const
+{
+   assert(_right);
+   return _right;
+}
+
+CSG_Object *CSG_Dag_Node::get_object() const
+{
+   assert(_object);
+   return _object;
+}
+
+CSG_Node::CSG_Type CSG_Dag_Node::get_type() const
+{
+   return _type;
+}
+
+const CSG_Dag_Node *CSG_Dag_Node::get_normal() const
+{
+   return _normal;
+}
+
+CSG_Dag::CSG_Dag() :
+   _buckets(INITIAL_BUCKETS, (CSG_Dag_Node *)NULL), _epoch(0),
+   _size(0), _allocations(0), _shared(0)
+{
+}
+
+CSG_Dag::~CSG_Dag()
+{
+   clear();
+}
+
+//! Mixes a value into a hash. Borrowed from Bob Jenkins' one-at-a-time hash.
+static unsigned long mix(unsigned long hash, unsigned long value)
+{
+   for(int i = 0; i < 4; ++i)
+   {
+      hash += value & 0xFF;
+      hash += hash << 10;
+      hash ^= hash >> 6;
+      value >>= 8;
+   }
+   return hash;
+}
+
+const CSG_Dag_Node *CSG_Dag::intern(CSG_Node::CSG_Type type, CSG_Object *object,
+                                    const CSG_Dag_Node *left,
+                                    const CSG_Dag_Node *right)
+{
+   unsigned long hash = mix(0, type);
+   if(object)
+   {
+      size_t address = (size_t)object;
+      hash = mix(hash, (unsigned long)address);
+      hash = mix(hash, (unsigned long)(address >> 16 >> 16));
+   }
+   else
+   {
+      hash = mix(hash, left->_hash);
+      hash = mix(hash, right->_hash);
+   }
+   hash += hash << 3;
+   hash ^= hash >> 11;
+   hash += hash << 15;
+
+   CSG_Dag_Node *&bucket = _buckets[hash % _buckets.size()];
+   for(CSG_Dag_Node *n = bucket; n; n = n->_next)
+   {
+      if(n->_hash == hash && n->_type == type && n->_object == object &&
+         n->_left == left && n->_right == right)
+      {
+         _shared++;
+         return n;
+      }
+   }
+
+   CSG_Dag_Node *n = new CSG_Dag_Node(type, object, left, right, hash);
+   n->_next = bucket;
+   bucket = n;
+   _size++;
+   _allocations++;
+
+   if(_size > _buckets.size())
+      grow();
+
+   return n;
+}
+
+void CSG_Dag::grow()
+{
+   vector<CSG_Dag_Node *> buckets(_buckets.size() * 2, (CSG_Dag_Node *)NULL);
+
+   for(unsigned long i = 0; i < _buckets.size(); ++i)
+   {
+      CSG_Dag_Node *n = _buckets[i];
+      while(n)
+      {
+         CSG_Dag_Node *next = n->_next;
+         CSG_Dag_Node *&bucket = buckets[n->_hash % buckets.size()];
+         n->_next = bucket;
+         bucket = n;
+         n = next;
+      }
+   }
+
+   _buckets.swap(buckets);
+}
+
+const CSG_Dag_Node *CSG_Dag::primitive(CSG_Object *object)
+{
+   assert(object);
+   return intern(CSG_Node::PRIMITIVE, object, NULL, NULL);
+}
+
+const CSG_Dag_Node *CSG_Dag::operation(CSG_Node::CSG_Type type,
+                                       const CSG_Dag_Node *left,
+                                       const CSG_Dag_Node *right)
+{
+   assert(type != CSG_Node::PRIMITIVE);
+   assert(left && right);
+   return intern(type, NULL, left, right);
+}
+
+/*!
+ * Imports trees into a DAG, and if imported is not NULL, looks there for
+ * subtrees it has imported before and remembers the new ones.
+ */
+struct Dag_Importer : public CSG_Folder<const CSG_Node, const CSG_Dag_Node *>
+{
+   typedef map<const CSG_Node *, const CSG_Dag_Node *> Imported;
+
+   Dag_Importer(CSG_Dag &dag, Imported *imported) :
+      dag(dag), imported(imported)
+   {
+   }
+
+   bool find(const CSG_Node *tree, const CSG_Dag_Node *&node)
+   {
+      if(!imported)
+         return false;
+      Imported::iterator i = imported->find(tree);
+      if(i == imported->end())
+         return false;
+      node = i->second;
+      return true;
+   }
+
+   const CSG_Dag_Node *remember(const CSG_Node *tree, const CSG_Dag_Node *node)
+   {
+      if(imported)
+         (*imported)[tree] = node;
+      return node;
+   }
+
+   const CSG_Dag_Node *primitive(const CSG_Node *tree)
+   {
+      return remember(tree, dag.primitive(tree->get_object()));
+   }
+
+   const CSG_Dag_Node *operation(const CSG_Node *tree,
+                                 const CSG_Dag_Node *left,
+                                 const CSG_Dag_Node *right)
+   {
+      return remember(tree, dag.operation(tree->get_type(), left, right));
+   }
+
+   CSG_Dag &dag;
+   Imported *imported;
+};
+
+//! Expands DAG nodes into trees.
+struct Dag_Expander : public CSG_Folder<const CSG_Dag_Node, CSG_Node *>
+{
+   explicit Dag_Expander(CSG_Arena *arena) : arena(arena) {}
+
+   CSG_Node *primitive(const CSG_Dag_Node *node)
+   {
+      return new (arena) CSG_Node(node->get_object());
+   }
+
+   CSG_Node *operation(const CSG_Dag_Node *node, CSG_Node *left, CSG_Node *right)
+   {
+      return CSG_Node::create_and_insert(node->get_type(), left, right);
+   }
+
+   CSG_Arena *arena;
+};
+
+const CSG_Dag_Node *CSG_Dag::import(const CSG_Node *tree)
+{
+   Dag_Importer importer(*this, NULL);
+   return fold_tree<const CSG_Dag_Node *>(tree, importer);
+}
+
+const CSG_Dag_Node *CSG_Dag::import(const CSG_Node *tree,
+                                    map<const CSG_Node *, const CSG_Dag_Node *> &imported)
+{
+   Dag_Importer importer(*this, &imported);
+   return fold_tree<const CSG_Dag_Node *>(tree, importer);
+}
+
+CSG_Node *CSG_Dag::expand(const CSG_Dag_Node *node, CSG_Arena *arena) const
+{
+   Dag_Expander expander(arena);
+   return fold_tree<CSG_Node *>(node, expander);
+}
+
+void CSG_Dag::set_normal(const CSG_Dag_Node *node, const CSG_Dag_Node *normal)
+{
+   node->_normal = normal;
+}
+
+void CSG_Dag::clear()
+{
+   for(unsigned long i = 0; i < _buckets.size(); ++i)
+   {
+      CSG_Dag_Node *n = _buckets[i];
+      while(n)
+      {
+         CSG_Dag_Node *next = n->_next;
+         delete n;
+         n = next;
+      }
+      _buckets[i] = NULL;
+   }
+   _size = 0;
+}
+
+void CSG_Dag::mark(const CSG_Dag_Node *node)
+{
+   vector<const CSG_Dag_Node *> stack(1, node);
+   while(!stack.empty())
+   {
+      node = stack.back();
+      stack.pop_back();
+      if(!node || node->_mark == _epoch)
+         continue;
+
+      node->_mark = _epoch;
+      stack.push_back(node->_normal);
+      if(node->_type != CSG_Node::PRIMITIVE)
+      {
+         stack.push_back(node->_left);
+         stack.push_back(node->_right);
+      }
+   }
+}
+
+void CSG_Dag::collect(const vector<const CSG_Dag_Node *> &roots)
+{
+   DBG(cout << "CSG_Dag::collect: " << _size << " nodes before" << endl);
+
+   _epoch++;
+   for(unsigned long i = 0; i < roots.size(); ++i)
+      mark(roots[i]);
+
+   for(unsigned long i = 0; i < _buckets.size(); ++i)
+   {
+      CSG_Dag_Node **link = &_buckets[i];
+      while(*link)
+      {
+         CSG_Dag_Node *n = *link;
+         if(n->_mark == _epoch)
+            link = &n->_next;
+         else
+         {
+            *link = n->_next;
+            delete n;
+            _size--;
+         }
+      }
+   }
+
+   DBG(cout << "CSG_Dag::collect: " << _size << " nodes after" << endl);
+}
+
+unsigned long CSG_Dag::size() const
+{
+   return _size;
+}
+
+unsigned long CSG_Dag::allocations() const
+{
+   return _allocations;
+}
+
+unsigned long CSG_Dag::shared() const
+{
+   return _shared;
+}
@@ -0,0 +1,161 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_dag.h
+ * A hash-consed, immutable representation of CSG expressions.
+ */
+
+#ifndef __CSG_DAG_H__
+#define __CSG_DAG_H__
+
+#include <vector>
+#include <map>
+#include "csg_tree.h"
+
+/*!
+ * An immutable node in a CSG_Dag.
+ *
+ * Nodes can only be created by a CSG_Dag, which makes sure that two
+ * structurally equal expressions are always represented by the same node.
+ * Subexpressions can therefore be shared freely between any number of
+ * parents, and comparing two expressions is a pointer comparison.
+ */
+class CSG_Dag_Node
+{
+public:
+   //! Get the left child. Can only be used in an operation node.
+   const CSG_Dag_Node *get_left() const;
+   //! Get the right child. Can only be used in an operation node.
+   const CSG_Dag_Node *get_right() const;
+   //! Get the CSG_Object. Can only be used in a primitive node.
+   CSG_Object *get_object() const;
+   //! Get the type of the node.
+   CSG_Node::CSG_Type get_type() const;
+
+   /*!
+    * The normalized form of this expression, or NULL if nobody has
+    * calculated it yet. Set by the DAG normalizer in normalize.cpp.
+    */
+   const CSG_Dag_Node *get_normal() const;
+
+private:
+   friend class CSG_Dag;
+
+   CSG_Dag_Node(CSG_Node::CSG_Type type, CSG_Object *object,
+                const CSG_Dag_Node *left, const CSG_Dag_Node *right,
+                unsigned long hash);
+
+   CSG_Node::CSG_Type _type;
+   CSG_Object *_object;         //!< Will be NULL in an operation node.
+   const CSG_Dag_Node *_left;   //!< Will be NULL in a primitive node.
+   const CSG_Dag_Node *_right;  //!< Will be NULL in a primitive node.
+
+   unsigned long _hash;         //!< Hash of (type, object, left, right).
+   CSG_Dag_Node *_next;         //!< Next node in the same hash bucket.
+
+   mutable const CSG_Dag_Node *_normal;
+   mutable unsigned long _mark; //!< Last collect() that reached this node.
+};
+
+/*!
+ * Owns a set of hash-consed CSG_Dag_Node:s. All nodes live until the
+ * CSG_Dag is cleared or destroyed.
+ */
+class CSG_Dag
+{
+public:
+   CSG_Dag();
+   ~CSG_Dag();
+
+   //! Returns the (unique) node representing a primitive.
+   const CSG_Dag_Node *primitive(CSG_Object *object);
+
+   //! Returns the (unique) node representing an operation.
+   const CSG_Dag_Node *operation(CSG_Node::CSG_Type type,
+                                 const CSG_Dag_Node *left,
+                                 const CSG_Dag_Node *right);
+
+   /*!
+    * Returns the node representing the same expression as a CSG tree.
+    * The tree is not changed.
+    */
+   const CSG_Dag_Node *import(const CSG_Node *tree);
+
+   /*!
+    * Like import(const CSG_Node *), but looks in imported for the node of
+    * every subtree before walking it, and remembers the nodes of the
+    * subtrees it walks there. Whoever changes or deletes a subtree must
+    * erase it and its ancestors from imported first.
+    */
+   const CSG_Dag_Node *import(const CSG_Node *tree,
+                              std::map<const CSG_Node *, const CSG_Dag_Node *> &imported);
+
+   /*!
+    * Builds a new CSG tree from an expression. Shared subexpressions
+    * are copied once for every place they are used. The caller owns
+    * the result.
+    *
+    * \param arena Where to allocate the tree. NULL means the heap.
+    */
+   CSG_Node *expand(const CSG_Dag_Node *node, CSG_Arena *arena = NULL) const;
+
+   //! Remembers that normal is the normalized form of node.
+   void set_normal(const CSG_Dag_Node *node, const CSG_Dag_Node *normal);
+
+   //! Destroys all nodes.
+   void clear();
+
+   /*!
+    * Destroys all nodes that can not be reached from roots, following
+    * children and normalized forms.
+    */
+   void collect(const std::vector<const CSG_Dag_Node *> &roots);
+
+   //! Number of nodes currently in the DAG.
+   unsigned long size() const;
+   //! Number of nodes created since the DAG was constructed.
+   unsigned long allocations() const;
+   //! Number of times an existing node was returned instead of a new one.
+   unsigned long shared() const;
+
+private:
+   CSG_Dag(const CSG_Dag &);
+   void operator=(const CSG_Dag &);
+
+   const CSG_Dag_Node *intern(CSG_Node::CSG_Type type, CSG_Object *object,
+                              const CSG_Dag_Node *left,
+                              const CSG_Dag_Node *right);
+   void grow();
+   void mark(const CSG_Dag_Node *node);
+
+   std::vector<CSG_Dag_Node *> _buckets;
+   unsigned long _epoch;    //!< Current mark value used by collect().
+   unsigned long _size;
+   unsigned long _allocations;
+   unsigned long _shared;
+};
+
+#endif
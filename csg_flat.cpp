@@ -0,0 +1,233 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_flat.cpp
+ * Implementation of the flat CSG tree.
+ */
+
+#include <cassert>
+#include "csg_visitor.h"
+#include "csg_flat.h"
+
+using namespace std;
+
+CSG_Flat_Tree::CSG_Flat_Tree()
+{
+}
+
+CSG_Flat_Tree::CSG_Flat_Tree(const CSG_Node *tree)
+{
+   assign(tree);
+}
+
+//! Appends the nodes of a tree to a flat tree, which puts them in post-order.
+struct Flat_Builder : public CSG_Folder<const CSG_Node, unsigned int>
+{
+   explicit Flat_Builder(CSG_Flat_Tree &flat) : flat(flat) {}
+
+   unsigned int primitive(const CSG_Node *node)
+   {
+      return flat.add_primitive(node->get_object());
+   }
+
+   unsigned int operation(const CSG_Node *node, unsigned int left,
+                          unsigned int right)
+   {
+      return flat.add_operation(node->get_type(), left, right);
+   }
+
+   CSG_Flat_Tree &flat;
+};
+
+void CSG_Flat_Tree::assign(const CSG_Node *tree)
+{
+   clear();
+   if(!tree)
+      return;
+
+   Flat_Builder builder(*this);
+   fold_tree<unsigned int>(tree, builder);
+}
+
+void CSG_Flat_Tree::clear()
+{
+   types.clear();
+   lefts.clear();
+   rights.clear();
+   primitives.clear();
+   objects.clear();
+   _object_indices.clear();
+}
+
+bool CSG_Flat_Tree::empty() const
+{
+   return types.empty();
+}
+
+unsigned int CSG_Flat_Tree::size() const
+{
+   return types.size();
+}
+
+unsigned int CSG_Flat_Tree::root() const
+{
+   assert(!empty());
+   return types.size() - 1;
+}
+
+unsigned int CSG_Flat_Tree::object_index(CSG_Object *object)
+{
+   map<CSG_Object *, unsigned int>::iterator i = _object_indices.find(object);
+   if(i != _object_indices.end())
+      return i->second;
+   _object_indices[object] = objects.size();
+   objects.push_back(object);
+   return objects.size() - 1;
+}
+
+unsigned int CSG_Flat_Tree::add_primitive(CSG_Object *object)
+{
+   types.push_back(CSG_Node::PRIMITIVE);
+   lefts.push_back(0);
+   rights.push_back(0);
+   primitives.push_back(object_index(object));
+   return types.size() - 1;
+}
+
+unsigned int CSG_Flat_Tree::add_operation(CSG_Node::CSG_Type type,
+                                          unsigned int left,
+                                          unsigned int right)
+{
+   assert(type != CSG_Node::PRIMITIVE);
+   assert(left < types.size() && right < types.size());
+   types.push_back(type);
+   lefts.push_back(left);
+   rights.push_back(right);
+   primitives.push_back(0);
+   return types.size() - 1;
+}
+
+void CSG_Flat_Tree::extract(unsigned int node, CSG_Flat_Tree &result) const
+{
+   assert(&result != this);
+   result.clear();
+   result.objects = objects;
+   result._object_indices = _object_indices;
+
+   // Depth first, with the new index of every finished operand on a stack.
+   vector<pair<unsigned int, bool> > stack(1, make_pair(node, false));
+   vector<unsigned int> done;
+   while(!stack.empty())
+   {
+      unsigned int i = stack.back().first;
+      bool operands_done = stack.back().second;
+      stack.pop_back();
+
+      if(types[i] == CSG_Node::PRIMITIVE)
+      {
+         result.types.push_back(CSG_Node::PRIMITIVE);
+         result.lefts.push_back(0);
+         result.rights.push_back(0);
+         result.primitives.push_back(primitives[i]);
+         done.push_back(result.size() - 1);
+      }
+      else if(operands_done)
+      {
+         unsigned int right = done.back();
+         done.pop_back();
+         done.back() = result.add_operation((CSG_Node::CSG_Type)types[i],
+                                            done.back(), right);
+      }
+      else
+      {
+         stack.push_back(make_pair(i, true));
+         stack.push_back(make_pair(rights[i], false));
+         stack.push_back(make_pair(lefts[i], false));
+      }
+   }
+}
+
+CSG_Node *CSG_Flat_Tree::to_tree(CSG_Arena *arena) const
+{
+   if(empty())
+      return NULL;
+
+   // Every node is finished before the operation that uses it.
+   vector<CSG_Node *> nodes(size());
+   for(unsigned int i = 0; i < size(); ++i)
+   {
+      if(types[i] == CSG_Node::PRIMITIVE)
+         nodes[i] = new (arena) CSG_Node(objects[primitives[i]]);
+      else
+      {
+         assert(nodes[lefts[i]] && nodes[rights[i]]);
+         nodes[i] = CSG_Node::create_and_insert((CSG_Node::CSG_Type)types[i],
+                                                nodes[lefts[i]],
+                                                nodes[rights[i]]);
+         nodes[lefts[i]] = nodes[rights[i]] = NULL;
+      }
+   }
+   return nodes.back();
+}
+
+string CSG_Flat_Tree::stringify() const
+{
+   // In post-order, the string is the nodes in order, with a space before
+   // the first node of every right operand.
+   vector<unsigned int> start(size());
+   vector<bool> space(size(), false);
+   for(unsigned int i = 0; i < size(); ++i)
+      if(types[i] == CSG_Node::PRIMITIVE)
+         start[i] = i;
+      else
+      {
+         start[i] = start[lefts[i]];
+         space[start[rights[i]]] = true;
+      }
+
+   string s;
+   for(unsigned int i = 0; i < size(); ++i)
+   {
+      if(space[i])
+         s += " ";
+      switch(types[i])
+      {
+         case CSG_Node::UNION:
+            s += " + ";
+            break;
+         case CSG_Node::DIFFERENCE:
+            s += " - ";
+            break;
+         case CSG_Node::INTERSECTION:
+            s += " * ";
+            break;
+         default:
+            s += "[ " + objects[primitives[i]]->stringify() + " ]";
+            break;
+      }
+   }
+   return s;
+}
@@ -0,0 +1,114 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_flat.h
+ * CSG trees stored in arrays instead of linked nodes.
+ */
+
+#ifndef __CSG_FLAT_H__
+#define __CSG_FLAT_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include "csg_tree.h"
+#include "csg_arena.h"
+
+/*!
+ * A CSG tree with its nodes in arrays, one array per field, and nodes
+ * referring to each other by index. A walk over all nodes runs through
+ * memory in order instead of chasing pointers.
+ *
+ * The operands of a node always come before it, and the last node is the
+ * root. After assign(), extract() and normalize(const CSG_Flat_Tree &,
+ * CSG_Flat_Tree &), the nodes are in post-order, so every subtree is a
+ * run of consecutive nodes that ends with its root, and the right operand
+ * of an operation is the node just before it. Nodes added with
+ * add_primitive() and add_operation() may also be operands of several
+ * operations, which makes the arrays a DAG. Such a DAG can not be turned
+ * back into CSG_Node trees or strings before it has been extract()ed.
+ */
+class CSG_Flat_Tree
+{
+public:
+   CSG_Flat_Tree();
+
+   //! Copies tree, which may be NULL.
+   explicit CSG_Flat_Tree(const CSG_Node *tree);
+
+   //! Replaces the contents with a copy of tree, which may be NULL.
+   void assign(const CSG_Node *tree);
+
+   void clear();
+
+   bool empty() const;
+
+   //! Number of nodes.
+   unsigned int size() const;
+
+   //! Index of the root. The tree must not be empty.
+   unsigned int root() const;
+
+   //! Appends a primitive node, and returns its index.
+   unsigned int add_primitive(CSG_Object *object);
+
+   //! Appends an operation node, and returns its index.
+   unsigned int add_operation(CSG_Node::CSG_Type type, unsigned int left,
+                              unsigned int right);
+
+   /*!
+    * Replaces the contents of result with the subtree rooted in node, in
+    * post-order. Nodes that are operands of several operations are copied
+    * once for every place they are used.
+    */
+   void extract(unsigned int node, CSG_Flat_Tree &result) const;
+
+   /*!
+    * Builds a CSG_Node tree with the same structure.
+    *
+    * \param arena Where to allocate the tree. NULL means the heap.
+    * \return The new tree, which the caller owns, or NULL if this is empty.
+    */
+   CSG_Node *to_tree(CSG_Arena *arena = NULL) const;
+
+   //! The same string as CSG_Node::stringify() gives for to_tree().
+   std::string stringify() const;
+
+   std::vector<unsigned char> types;   //!< A CSG_Node::CSG_Type per node.
+   std::vector<unsigned int> lefts;    //!< Left operand of an operation.
+   std::vector<unsigned int> rights;   //!< Right operand of an operation.
+   std::vector<unsigned int> primitives; //!< Index in objects of a primitive.
+
+   //! The objects of the primitives. Every object is in it once.
+   std::vector<CSG_Object *> objects;
+
+private:
+   unsigned int object_index(CSG_Object *object);
+
+   std::map<CSG_Object *, unsigned int> _object_indices;
+};
+
+#endif
@@ -0,0 +1,159 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_history.cpp
+ * Implementation of the version history of a CSG tree.
+ */
+
+#ifdef DEBUG
+#  include <iostream>
+#endif
+#include "debug.h"
+#include "csg_history.h"
+
+using namespace std;
+
+//! Don't bother collecting garbage in DAGs smaller than this.
+static const unsigned long MIN_COLLECT_LIMIT = 4096;
+
+CSG_History::CSG_History(unsigned int max_versions) :
+   _versions(1, (const CSG_Dag_Node *)NULL), _current(0),
+   _max_versions(max_versions > 0 ? max_versions : 1),
+   _collect_limit(MIN_COLLECT_LIMIT)
+{
+}
+
+void CSG_History::invalidate(const CSG_Node *node)
+{
+   for(; node; node = node->get_parent())
+      _imported.erase(node);
+}
+
+void CSG_History::record(const CSG_Node *tree)
+{
+   const CSG_Dag_Node *version = tree ? _dag.import(tree, _imported) : NULL;
+
+   _versions.erase(_versions.begin() + _current + 1, _versions.end());
+   _versions.push_back(version);
+   if(_versions.size() > _max_versions)
+      _versions.erase(_versions.begin());
+   _current = _versions.size() - 1;
+
+   DBG(cout << "CSG_History::record: version " << _current << ", "
+            << _dag.size() << " DAG nodes" << endl);
+
+   if(_dag.size() > _collect_limit)
+      collect();
+}
+
+bool CSG_History::can_undo() const
+{
+   return _current > 0;
+}
+
+bool CSG_History::can_redo() const
+{
+   return _current + 1 < _versions.size();
+}
+
+bool CSG_History::undo(CSG_Node *&tree)
+{
+   if(!can_undo())
+      return false;
+   _current--;
+   tree = restore();
+   return true;
+}
+
+bool CSG_History::redo(CSG_Node *&tree)
+{
+   if(!can_redo())
+      return false;
+   _current++;
+   tree = restore();
+   return true;
+}
+
+/*
+ * Builds a tree of the current version, and remembers its nodes instead
+ * of the ones of the tree it replaces. Importing it again only finds the
+ * nodes that are already in the DAG.
+ */
+CSG_Node *CSG_History::restore()
+{
+   _imported.clear();
+
+   const CSG_Dag_Node *version = _versions[_current];
+   if(!version)
+      return NULL;
+   CSG_Node *tree = _dag.expand(version);
+   _dag.import(tree, _imported);
+   return tree;
+}
+
+//! Destroys the DAG nodes that no version and no remembered node uses.
+void CSG_History::collect()
+{
+   vector<const CSG_Dag_Node *> roots;
+   roots.reserve(_versions.size() + _imported.size());
+   for(unsigned int i = 0; i < _versions.size(); ++i)
+      if(_versions[i])
+         roots.push_back(_versions[i]);
+
+   map<const CSG_Node *, const CSG_Dag_Node *>::const_iterator i;
+   for(i = _imported.begin(); i != _imported.end(); ++i)
+      roots.push_back(i->second);
+
+   _dag.collect(roots);
+
+   _collect_limit = 2 * _dag.size();
+   if(_collect_limit < MIN_COLLECT_LIMIT)
+      _collect_limit = MIN_COLLECT_LIMIT;
+}
+
+const CSG_Dag_Node *CSG_History::current() const
+{
+   return _versions[_current];
+}
+
+void CSG_History::clear(const CSG_Node *tree)
+{
+   _imported.clear();
+   _dag.clear();
+   _versions.assign(1, tree ? _dag.import(tree, _imported) : NULL);
+   _current = 0;
+   _collect_limit = MIN_COLLECT_LIMIT;
+}
+
+unsigned int CSG_History::size() const
+{
+   return _versions.size();
+}
+
+CSG_Dag &CSG_History::get_dag()
+{
+   return _dag;
+}
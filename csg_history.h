@@ -0,0 +1,117 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_history.h
+ * Versions of a CSG tree for undo and redo.
+ */
+
+#ifndef __CSG_HISTORY_H__
+#define __CSG_HISTORY_H__
+
+#include <vector>
+#include <map>
+#include "csg_tree.h"
+#include "csg_dag.h"
+
+/*!
+ * The versions of an edited CSG tree, kept as expressions in a CSG_Dag of
+ * its own.
+ *
+ * Expressions in a CSG_Dag never change, and equal subexpressions are
+ * the same node, so every version shares all its unchanged subtrees with
+ * the one before it. Recording a version after an edit only imports the
+ * nodes on the path from the change to the root, as long as the edited
+ * nodes are invalidate()d like for an Incremental_Normalizer, and costs
+ * only as many new DAG nodes as that path is long. Old versions can be
+ * read, e.g. normalized with normalize(CSG_Dag &, const CSG_Dag_Node *),
+ * at any time.
+ *
+ * Only the tree is recorded. The CSG_Object:s of the primitives are
+ * shared with the caller, who must keep every object alive as long as
+ * a version may use it, and moving an object changes all versions.
+ */
+class CSG_History
+{
+public:
+   //! Keeps at most max_versions versions, dropping the oldest ones first.
+   explicit CSG_History(unsigned int max_versions = 100);
+
+   /*!
+    * Forgets node and all of its ancestors. Must be called before the
+    * subtree rooted in node is changed or deleted.
+    */
+   void invalidate(const CSG_Node *node);
+
+   /*!
+    * Makes tree, which may be NULL, the newest version, and drops the
+    * versions that could have been redone.
+    */
+   void record(const CSG_Node *tree);
+
+   bool can_undo() const;
+   bool can_redo() const;
+
+   /*!
+    * Steps back to the previous version, and returns a new copy of it in
+    * tree, which may be NULL. The copy is meant to replace the tree that
+    * was recorded, which must not be invalidate()d before it is deleted.
+    * The caller owns the copy.
+    *
+    * \return false if there is no previous version, in which case tree is
+    *         left alone.
+    */
+   bool undo(CSG_Node *&tree);
+
+   //! Like undo(), but steps forward to the next version.
+   bool redo(CSG_Node *&tree);
+
+   //! The current version, or NULL if it is empty.
+   const CSG_Dag_Node *current() const;
+
+   //! Forgets all versions, and makes tree, which may be NULL, the only one.
+   void clear(const CSG_Node *tree = NULL);
+
+   //! Number of versions.
+   unsigned int size() const;
+
+   CSG_Dag &get_dag();
+
+private:
+   CSG_History(const CSG_History &);
+   void operator=(const CSG_History &);
+
+   CSG_Node *restore();
+   void collect();
+
+   CSG_Dag _dag;
+   std::map<const CSG_Node *, const CSG_Dag_Node *> _imported;
+   std::vector<const CSG_Dag_Node *> _versions;
+   unsigned int _current;        //!< Index of the current version in _versions.
+   unsigned int _max_versions;
+   unsigned long _collect_limit; //!< DAG size that triggers garbage collection.
+};
+
+#endif
@@ -28,48 +28,51 @@
  * Implementation of primitive objects.
  */
 
-#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <assert.h>
 
-#include <GL/glut.h>
-
 #include "csg_object.h"
+#include "csg_tree.h"
+#include "mesh_cache.h"
+#include "level_of_detail.h"
+#include "impostor.h"
 #include "debug.h"
 #include "persistence.h"
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
 using namespace std;
 
-CSG_Object::CSG_Object(string name):
-   _name(name), _precision(10),
-   _red(1.0), _green(1.0), _blue(1.0)
+CSG_Object::CSG_Object(Primitive_Store::Type type, string name):
+   _name(name), _slot(primitive_store().allocate(this, type))
 {
 }
 
 CSG_Object::~CSG_Object()
 {
+   for(unsigned int i = 0; i < _bounded.size(); ++i)
+      CSG_Node::forget_object(_bounded[i]);
+   primitive_store().release(_slot);
 }
 
 void CSG_Object::set_precision(int precision)
 {
-   _precision = (precision < 3) ? 3 : precision;
+   primitive_store().set_precision(_slot, (precision < 3) ? 3 : precision);
 }
 
-int CSG_Object::get_precision()
+int CSG_Object::get_precision() const
 {
-   return _precision;
+   return primitive_store().get_precision(_slot);
 }
 
 string CSG_Object::stringify()
 {
+   const Primitive_Store &store = primitive_store();
+   const GLfloat *color = store.get_color(_slot);
    ostringstream representation;
-   representation << type_name() << " " << escape(_name) << " " << _precision << " "
-                  << _red << " " << _green << " " << _blue << " " << _trans.stringify();
+   representation << type_name() << " " << escape(_name) << " "
+                  << store.get_precision(_slot) << " " << color[0] << " "
+                  << color[1] << " " << color[2] << " "
+                  << store.get_transform(_slot).stringify();
    return representation.str();
 }
 
@@ -95,10 +98,12 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
 
    _name = unescape(parameters[1]);
 
+   int precision;
+   GLfloat red, green, blue;
    istringstream iss;
 
    iss.str(parameters[2]);
-   if(!(iss >> _precision))
+   if(!(iss >> precision))
    {
       cout << "Error reading precision: '" << parameters[2] << "' is not an int" << endl;
       return false;
@@ -106,7 +111,7 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
    iss.clear();
 
    iss.str(parameters[3]);
-   if(!(iss >> _red))
+   if(!(iss >> red))
    {
       cout << "Error reading red color component: '" << parameters[3] <<
               "' is not a GLfloat" << endl;
@@ -115,7 +120,7 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
    iss.clear();
 
    iss.str(parameters[4]);
-   if(!(iss >> _green))
+   if(!(iss >> green))
    {
       cout << "Error reading green color component: '" << parameters[4] <<
               "' is not a GLfloat" << endl;
@@ -124,7 +129,7 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
    iss.clear();
 
    iss.str(parameters[5]);
-   if(!(iss >> _blue))
+   if(!(iss >> blue))
    {
       cout << "Error reading blue color component: '" << parameters[5] <<
               "' is not a GLfloat" << endl;
@@ -146,12 +151,17 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
 
    vector<string> transformation_data(first, last);
 
-   if(!_trans.from_string(transformation_data))
+   Matrix transform;
+   if(!transform.from_string(transformation_data))
    {
       cout << "Error reading transformation matrix" << endl;
       return false;
    }
 
+   primitive_store().set_precision(_slot, precision);
+   set_color(red, green, blue);
+   set_transform(transform);
+
    DBG(cout << "Loaded " << _name << endl);
 
    return true;
@@ -159,12 +169,34 @@ bool CSG_Object::from_string(const std::vector<std::string> &parameters)
 
 void CSG_Object::set_transform(const Matrix &m)
 {
-   _trans = m;
+   primitive_store().set_transform(_slot, m);
+   for(unsigned int i = 0; i < _bounded.size(); ++i)
+      _bounded[i]->invalidate_bounds();
+}
+
+const Matrix &CSG_Object::get_transform() const
+{
+   return primitive_store().get_transform(_slot);
+}
+
+const Matrix &CSG_Object::get_inverse() const
+{
+   return primitive_store().get_inverse(_slot);
 }
 
-Matrix CSG_Object::get_transform() const
+const Bounding_Box &CSG_Object::get_bounds() const
 {
-   return _trans;
+   return primitive_store().get_bounds(_slot);
+}
+
+Primitive_Store::Type CSG_Object::get_type() const
+{
+   return primitive_store().get_type(_slot);
+}
+
+Primitive_Store::Slot CSG_Object::get_slot() const
+{
+   return _slot;
 }
 
 void CSG_Object::set_name(string name)
@@ -179,12 +211,13 @@ string CSG_Object::get_name() const
 
 void CSG_Object::set_color(GLfloat red, GLfloat green, GLfloat blue)
 {
-   _red = red; _green = green; _blue = blue;
+   primitive_store().set_color(_slot, red, green, blue);
 }
 
 void CSG_Object::get_color(GLfloat &red, GLfloat &green, GLfloat &blue)
 {
-   red = _red; green = _green; blue = _blue;
+   const GLfloat *color = primitive_store().get_color(_slot);
+   red = color[0]; green = color[1]; blue = color[2];
 }
 
 void prepare_highlight(GLfloat red, GLfloat green, GLfloat blue)
@@ -200,18 +233,35 @@ void prepare_highlight(GLfloat red, GLfloat green, GLfloat blue)
    glColor3f(red, green, blue);
 }
 
+CSG_Object_Cube::CSG_Object_Cube(string name) :
+   CSG_Object(Primitive_Store::CUBE, name)
+{
+}
+
 string CSG_Object_Cube::type_name()
 {
    return "Cube";
 }
 
-void CSG_Object_Cube::render()
+/*!
+ * Draws the mesh of a primitive from mesh_cache(), solid or as a wireframe,
+ * with its transformation, at the precision level_of_detail() picks. Solid
+ * primitives are drawn as impostors() instead where they can be.
+ */
+static void draw_mesh(CSG_Object *object, bool wire)
 {
-   DBG(cout << "Rendering " << get_name() << "   ");
    glPushMatrix();
-   glMultMatrixf(get_transform().data);
-   glutSolidCube(1);
+   glMultMatrixf(object->get_transform().data);
+   if(wire || !impostors().draw(object->get_type()))
+      mesh_cache().draw(object->get_type(), level_of_detail().precision(object),
+                        wire);
    glPopMatrix();
+}
+
+void CSG_Object_Cube::render()
+{
+   DBG(cout << "Rendering " << get_name() << "   ");
+   draw_mesh(this, false);
    DBG(cout << endl);
 }
 
@@ -219,27 +269,15 @@ void CSG_Object_Cube::render_highlight(GLfloat red, GLfloat green, GLfloat blue)
 {
    DBG(cout << "Rendering highlight for " << get_name() << "   ");
    prepare_highlight(red, green, blue);
-   glPushMatrix();
-   glMultMatrixf(get_transform().data);
-   glutWireCube(1);
-   glPopMatrix();
+   draw_mesh(this, true);
    glPopAttrib();
    DBG(cout << endl);  
 }
 
 
 CSG_Object_Cylinder::CSG_Object_Cylinder(string name) :
-   CSG_Object(name),
-   dirty(true),
-   num_vertices(0), num_indices(0),
-   vertices(NULL), indices(NULL)
-{
-}
-
-CSG_Object_Cylinder::~CSG_Object_Cylinder()
+   CSG_Object(Primitive_Store::CYLINDER, name)
 {
-   delete[] vertices;
-   delete[] indices;
 }
 
 string CSG_Object_Cylinder::type_name()
@@ -247,154 +285,27 @@ string CSG_Object_Cylinder::type_name()
    return "Cylinder";
 }
 
-void CSG_Object_Cylinder::set_precision(int precision)
-{
-   CSG_Object::set_precision(precision);
-   dirty = true;
-}
-
-void CSG_Object_Cylinder::rebuild_vertices()
-{
-   const int num_faces = get_precision();
-   
-   DBG(cout << "Recalculating cylinder vertices" << endl);
-
-   delete[] vertices;
-   delete[] indices;
-   
-   num_vertices = num_faces * 2;
-   num_indices = num_faces * 4 + 2;
-   
-   vertices = new GLfloat[num_vertices * 3];
-   indices = new GLuint[num_indices];
-   
-   //Do main hull
-   //DBG(cout << "Calculating vertices of main hull of cylinder" << endl);
-   GLuint vertex_num = 0;
-   for(int i = 0; i < num_faces; ++i)
-   {
-      GLfloat angle = 360.0 - 360.0 * i / num_faces;
-      
-      GLfloat sine = 0.5 * cos((M_PI / 180.0) * angle);
-      GLfloat cosine = 0.5 * sin((M_PI / 180.0) * angle);
-      
-      vertices[vertex_num + 0] = sine;
-      vertices[vertex_num + 1] = 0.5;
-      vertices[vertex_num + 2] = cosine;
-      vertex_num += 3;
-      vertices[vertex_num + 0] = sine;
-      vertices[vertex_num + 1] = -0.5;
-      vertices[vertex_num + 2] = cosine;
-      vertex_num += 3;
-      
-   }
-   
-   //for(int i = 0; i < num_vertices; i++)
-   //   DBG(cout << "Vertex: " << i << ": (" <<
-   //       vertices[i * 3 + 0] << ", " <<
-   //       vertices[i * 3 + 1] << ", " <<
-   //       vertices[i * 3 + 2] << ")" << endl);
-   
-   //DBG(cout << "Calculating indices of main hull of cylinder" << endl);
-   for(int index_num = 0; index_num < num_indices - 2 * num_faces; index_num++)
-      indices[index_num] = index_num % num_vertices;
-   
-   //Do end bits
-   //DBG(cout << "Calculating indices of end bits of cylinder" << endl);
-   int index_num = num_indices - 2 * num_faces;
-   for(int corner = 0; corner < num_faces * 2; corner += 2)
-      indices[index_num++] = corner;
-   for(int corner = num_faces * 2 - 1; corner > 0; corner -= 2)
-      indices[index_num++] = corner;
-   
-   //for(int i = 0; i < num_indices; i++)
-   //   DBG(cout << "Index " << i << ": vertex " << (int)indices[i] << endl);
-   
-   dirty = false;
-   
-   DBG(cout << "Done recalculating vertices" << endl);
-}
-
 void CSG_Object_Cylinder::render()
 {
-   if(dirty) rebuild_vertices();
-
    DBG(cout << "Rendering " << get_name() << "   ");
-
-   const int num_faces = get_precision();
-
-   glPushAttrib(GL_ENABLE_BIT);
-   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
-
-   glEnable(GL_NORMALIZE);
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glEnableClientState(GL_NORMAL_ARRAY);
-
-   glPushMatrix();
-   glMultMatrixf(get_transform().data);
-
-   //Draw main hull
-   //DBG(cout << "Drawing main hull of cylinder" << endl);
-   glVertexPointer(3, GL_FLOAT, 0, vertices);
-   glNormalPointer(GL_FLOAT, 0, vertices);
-   glDrawElements(GL_QUAD_STRIP, num_indices - 2 * num_faces, GL_UNSIGNED_INT, indices);
-
-   //Draw end bits
-   //DBG(cout << "Drawing end bits of cylinder" << endl);
-   glVertexPointer(3, GL_FLOAT, 0, vertices);
-   glNormalPointer(GL_FLOAT, 0, vertices);
-   glDrawElements(GL_POLYGON, num_faces, GL_UNSIGNED_INT, indices + num_indices - 2 * num_faces);
-   glDrawElements(GL_POLYGON, num_faces, GL_UNSIGNED_INT, indices + num_indices - num_faces);
-
-   glPopMatrix();
-
-   glPopClientAttrib();
-   glPopAttrib();
-
+   draw_mesh(this, false);
    DBG(cout << endl);
 }
 
 void CSG_Object_Cylinder::render_highlight(GLfloat red, GLfloat green, GLfloat blue)
 {
-   if(dirty) rebuild_vertices();
-
    DBG(cout << "Rendering highlight for " << get_name() << "   ");
-
-   const int num_faces = get_precision();
-
-   glPushAttrib(GL_ENABLE_BIT);
-   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
    prepare_highlight(red, green, blue);
-
-   glEnable(GL_NORMALIZE);
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glEnableClientState(GL_NORMAL_ARRAY);
-   
-   glPushMatrix();
-   glMultMatrixf(get_transform().data);
-
-   //Draw main hull
-   //DBG(cout << "Drawing main hull of cylinder" << endl);
-   glVertexPointer(3, GL_FLOAT, 0, vertices);
-   glNormalPointer(GL_FLOAT, 0, vertices);
-   glDrawElements(GL_LINES, num_indices - 2 * num_faces, GL_UNSIGNED_INT, indices);
-   
-   //Draw end bits
-   //DBG(cout << "Drawing end bits of cylinder" << endl);
-   glVertexPointer(3, GL_FLOAT, 0, vertices);
-   glNormalPointer(GL_FLOAT, 0, vertices);
-   glDrawElements(GL_LINE_LOOP, num_faces, GL_UNSIGNED_INT, indices + num_indices - 2 * num_faces);
-   glDrawElements(GL_LINE_LOOP, num_faces, GL_UNSIGNED_INT, indices + num_indices - num_faces);
-   
-   glPopMatrix();
-
-   glPopAttrib(); // from prepare_highlight
-   glPopClientAttrib();
+   draw_mesh(this, true);
    glPopAttrib();
-
    DBG(cout << endl);
 }
 
+CSG_Object_Sphere::CSG_Object_Sphere(string name) :
+   CSG_Object(Primitive_Store::SPHERE, name)
+{
+}
+
 string CSG_Object_Sphere::type_name()
 {
    return "Sphere";
@@ -403,10 +314,7 @@ string CSG_Object_Sphere::type_name()
 void CSG_Object_Sphere::render()
 {
    DBG(cout << "Rendering " << get_name() << "   ");
-   glPushMatrix();
-   glMultMatrixf(get_transform().data);
-   glutSolidSphere(0.5, get_precision(), get_precision());
-   glPopMatrix();
+   draw_mesh(this, false);
    DBG(cout << endl);
 }
 
@@ -414,12 +322,7 @@ void CSG_Object_Sphere::render_highlight(GLfloat red, GLfloat green, GLfloat blu
 {
    DBG(cout << "Rendering highlight for " << get_name() << "   ");
    prepare_highlight(red, green, blue);
-   glPushMatrix();
-   glMultMatrixf(get_transform().data);
-   glutWireSphere(0.5, get_precision(), get_precision());
-   glPopMatrix();
+   draw_mesh(this, true);
    glPopAttrib();
    DBG(cout << endl);
 }
-
-
@@ -34,19 +34,26 @@
 #include <string>
 #include <GL/gl.h>
 #include "matrix.h"
+#include "bounding_box.h"
+#include "primitive_store.h"
+
+class CSG_Node;
 
 /*!
- * Abstract base class representing a primitive object.
+ * Abstract base class representing a primitive object. Everything but the
+ * name is kept in a slot of primitive_store(), see Primitive_Store.
  */
 class CSG_Object
 {
 public:
 
-   CSG_Object(std::string name = "Untitled");
+   CSG_Object(Primitive_Store::Type type, std::string name = "Untitled");
    virtual ~CSG_Object();
 
    /*!
     * Renders this primitive, using the transformation chosen with set_transform().
+    * The mesh is shared with all primitives of the same type and precision,
+    * see mesh_cache().
     * Does NOT draw the highlight anymore.
     * Only draw vertices in here. Do not change any OpenGL state.
     */
@@ -65,7 +72,7 @@ public:
     * cubes. Values lower than 3 are clamped to 3.
     */
    void set_precision(int precision);
-   int get_precision();
+   int get_precision() const;
 
    /*!
     * Output a representation of this object as a string.
@@ -87,10 +94,26 @@ public:
 
    /*!
     * The transformation that is applied before render() is called.
+    * set_transform() throws away the cached bounds of the nodes with this
+    * object, see CSG_Node::get_bounds(). The reference is only good until
+    * the next object is created.
     */
-   Matrix get_transform() const;
+   const Matrix &get_transform() const;
    void set_transform(const Matrix &m);
 
+   //! The inverse of get_transform(), with the same lifetime.
+   const Matrix &get_inverse() const;
+
+   /*!
+    * The world-space bounding box of this primitive, with the current
+    * transformation. The reference is only good until the next object is
+    * created.
+    */
+   const Bounding_Box &get_bounds() const;
+
+   Primitive_Store::Type get_type() const;
+   Primitive_Store::Slot get_slot() const;
+
    //! Name of the object. Only used for debugging.
    void set_name(std::string name);
    std::string get_name() const;
@@ -99,15 +122,21 @@ public:
    void get_color(GLfloat &red, GLfloat &green, GLfloat &blue);
 
 private:
+   CSG_Object(const CSG_Object &);
+   void operator=(const CSG_Object &);
+
    std::string _name;
-   Matrix _trans;
-   int _precision;
-   GLfloat _red, _green, _blue;
+   Primitive_Store::Slot _slot;
+
+   friend class CSG_Node;
+   std::vector<CSG_Node *> _bounded; //!< Primitive nodes that cache our bounds.
 };
 
 class CSG_Object_Cube : public CSG_Object
 {
 public:
+   CSG_Object_Cube(std::string name = "Untitled");
+
    std::string type_name();
    void render();
    void render_highlight(GLfloat red, GLfloat green, GLfloat blue);
@@ -117,28 +146,17 @@ class CSG_Object_Cylinder : public CSG_Object
 {
 public:
    CSG_Object_Cylinder(std::string name = "Untitled");
-   ~CSG_Object_Cylinder();
 
    std::string type_name();
-   void set_precision(int precision);
    void render();
    void render_highlight(GLfloat red, GLfloat green, GLfloat blue);
-
-
-private:
-   bool dirty;  //!< True if we need to recalculate vertices at next call to render().
-   void rebuild_vertices();
-
-   int num_vertices;  //!< Number of stored vertices (precision * 2).
-   int num_indices;   //!< Number of storde indices (precision * 4 + 2).
-
-   GLfloat *vertices; //!< Stored vertices, ready to be sent to OpenGL.
-   GLuint *indices;   //!< Stored indices, ready to be sent to OpenGL.
 };
 
 class CSG_Object_Sphere : public CSG_Object
 {
 public:
+   CSG_Object_Sphere(std::string name = "Untitled");
+
    std::string type_name();
    void render();
    void render_highlight(GLfloat red, GLfloat green, GLfloat blue);
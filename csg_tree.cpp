@@ -30,42 +30,107 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <map>
+#include <sstream>
+#include <vector>
 #ifdef DEBUG
 #  include <iostream>
 #  include <iomanip>
 #endif
 #include "debug.h"
 #include "csg_tree.h"
+#include "csg_arena.h"
+#include "csg_visitor.h"
 
 using namespace std;
 
-CSG_Node::CSG_Node(CSG_Object *object) : 
-   _type(PRIMITIVE), _object(object), _left(NULL), _right(NULL), _parent(NULL)
+/*!
+ * Every node is preceded by the arena it is allocated in, so that delete
+ * knows where to give it back. The union keeps the node aligned.
+ */
+union Node_Header
 {
+   CSG_Arena *arena;
+   double align_double;
+   long align_long;
+};
+
+void *CSG_Node::operator new(size_t size)
+{
+   return operator new(size, NULL);
 }
 
-CSG_Node::CSG_Node(const CSG_Node &node) :
-   _type(node._type), _object(node._object), _parent(NULL)
+void *CSG_Node::operator new(size_t size, CSG_Arena *arena)
+{
+   size += sizeof(Node_Header);
+   Node_Header *header = (Node_Header *)(arena ? arena->allocate(size) :
+                                         ::operator new(size));
+   header->arena = arena;
+   return header + 1;
+}
+
+void CSG_Node::operator delete(void *p)
+{
+   if(!p)
+      return;
+   Node_Header *header = (Node_Header *)p - 1;
+   if(header->arena)
+      header->arena->release(header);
+   else
+      ::operator delete(header);
+}
+
+void CSG_Node::operator delete(void *p, CSG_Arena *)
+{
+   operator delete(p);
+}
+
+CSG_Arena *CSG_Node::get_arena() const
 {
-   if (node._left)
+   return ((const Node_Header *)this - 1)->arena;
+}
+
+//! Copies the operands of a node for the copy constructor.
+struct Node_Copier : public CSG_Folder<const CSG_Node, CSG_Node *>
+{
+   explicit Node_Copier(CSG_Arena *arena) : arena(arena) {}
+
+   CSG_Node *primitive(const CSG_Node *node)
    {
-      _left = new CSG_Node(*node._left);
-      _left->_parent = this;
+      return new (arena) CSG_Node(node->get_object());
    }
-   else
-      _left = NULL;
 
-   if (node._right)
+   CSG_Node *operation(const CSG_Node *node, CSG_Node *left, CSG_Node *right)
    {
-      _right = new CSG_Node(*node._right);
-      _right->_parent = this;
+      return CSG_Node::create_and_insert(node->get_type(), left, right);
    }
-   else 
-      _right = NULL;
+
+   CSG_Arena *arena;
+};
+
+CSG_Node::CSG_Node(CSG_Object *object) : 
+   _type(PRIMITIVE), _object(object), _left(NULL), _right(NULL), _parent(NULL),
+   _bounds_cached(false), _registered(false)
+{
+}
+
+CSG_Node::CSG_Node(const CSG_Node &node) :
+   _type(node._type), _object(node._object), _left(NULL), _right(NULL),
+   _parent(NULL), _bounds_cached(false), _registered(false)
+{
+   if (_type == PRIMITIVE)
+      return;
+
+   Node_Copier copier(get_arena());
+   _left = fold_tree<CSG_Node *>(node._left, copier);
+   _left->_parent = this;
+   _right = fold_tree<CSG_Node *>(node._right, copier);
+   _right->_parent = this;
 }
 
 CSG_Node::CSG_Node(CSG_Type type, CSG_Node *left, CSG_Node *right) :
-   _type(type), _object(NULL), _left(left), _right(right)
+   _type(type), _object(NULL), _left(left), _right(right),
+   _bounds_cached(false), _registered(false)
 {
    assert(!(_left->_parent && _right->_parent));
 
@@ -73,6 +138,8 @@ CSG_Node::CSG_Node(CSG_Type type, CSG_Node *left, CSG_Node *right) :
       _parent = _left->_parent;
    else
       _parent = _right->_parent;
+   if (_parent)
+      _parent->invalidate_bounds();
 
    _left->_parent = this;
    _right->_parent = this;
@@ -87,18 +154,45 @@ CSG_Node::~CSG_Node()
    //DBG(cout << "Deleting node 0x" << hex << (unsigned int)this <<
    //    ", left = 0x" << hex << (unsigned int)_left <<
    //    ", right = 0x" << hex << (unsigned int)_right << endl);
-   //DBG(cout << "Deleting left = 0x" << hex << (unsigned int)_left << endl);
-   delete _left;
-   //DBG(cout << "Deleting right = 0x" << hex << (unsigned int)_right << endl);
-   delete _right;
-   //DBG(cout << "Deleting this = 0x" << hex << (unsigned int)this << endl);
+
+   if (_registered)
+   {
+      vector<CSG_Node *> &bounded = _object->_bounded;
+      for (unsigned int i = 0; i < bounded.size(); ++i)
+         if (bounded[i] == this)
+         {
+            bounded[i] = bounded.back();
+            bounded.pop_back();
+            break;
+         }
+   }
+
+   // Every node is emptied before it is deleted, so that the destructor
+   // never recurses, however deep the tree is.
+   if (!_left)
+      return;
+   vector<CSG_Node *> stack;
+   stack.push_back(_left);
+   stack.push_back(_right);
+   while (!stack.empty())
+   {
+      CSG_Node *node = stack.back();
+      stack.pop_back();
+      if (node->_left)
+      {
+         stack.push_back(node->_left);
+         stack.push_back(node->_right);
+         node->_left = node->_right = NULL;
+      }
+      delete node;
+   }
 }
 
 CSG_Node *CSG_Node::create_and_insert(CSG_Type type,
                                       CSG_Node *left,
                                       CSG_Node *right)
 {
-   return new CSG_Node(type, left, right);
+   return new (left->get_arena()) CSG_Node(type, left, right);
 }
 
 CSG_Node *CSG_Node::detach_left()
@@ -106,6 +200,7 @@ CSG_Node *CSG_Node::detach_left()
    assert(_type != PRIMITIVE);
    assert(_parent);
    assert(_parent->_left == this || _parent->_right == this);
+   _parent->invalidate_bounds();
    (_parent->_left == this ? _parent->_left : _parent->_right) = _right;
    _right->_parent = _parent;
    CSG_Node *ret = _left;
@@ -120,6 +215,7 @@ CSG_Node *CSG_Node::detach_right()
    assert(_type != PRIMITIVE);
    assert(_parent);
    assert(_parent->_left == this || _parent->_right == this);
+   _parent->invalidate_bounds();
    (_parent->_left == this ? _parent->_left : _parent->_right) = _left;
    _left->_parent = _parent;
    CSG_Node *ret = _right;
@@ -158,6 +254,7 @@ void CSG_Node::delete_and_replace_left(CSG_Node *tree)
    assert(_type != PRIMITIVE);
    assert(tree);
    assert(!tree->_parent);
+   invalidate_bounds();
    delete _left;
    _left = tree;  
    tree->_parent = this;
@@ -168,34 +265,112 @@ void CSG_Node::delete_and_replace_right(CSG_Node *tree)
    assert(_type != PRIMITIVE);
    assert(tree);
    assert(!tree->_parent);
+   invalidate_bounds();
    delete _right;
    _right = tree;
    tree->_parent = this;
 }
 
+//! Builds the string for CSG_Node::stringify().
+struct Tree_Stringifier : public CSG_Visitor<const CSG_Node>
+{
+   bool between(const CSG_Node *)
+   {
+      s += " ";
+      return true;
+   }
+
+   void leave(const CSG_Node *node)
+   {
+      switch(node->get_type())
+      {
+         case CSG_Node::UNION:
+            s += " + ";
+            break;
+         case CSG_Node::DIFFERENCE:
+            s += " - ";
+            break;
+         case CSG_Node::INTERSECTION:
+            s += " * ";
+            break;
+         case CSG_Node::PRIMITIVE:
+            s += "[ " + node->get_object()->stringify() + " ]";
+            break;
+         default:
+            s += "I don't think this tree is in Kansas anymore...";
+            break;
+      }
+   }
+
+   string s;
+};
+
 string CSG_Node::stringify() const
 {
-   switch(_type)
+   Tree_Stringifier stringifier;
+   visit_tree(this, stringifier);
+   return stringifier.s;
+}
+
+//! Writes the parts of a tree that structural_hash() covers, in RPN.
+//! A primitive that has been seen before is written as the number it got
+//! the first time.
+struct Shape_Writer : public CSG_Visitor<const CSG_Node>
+{
+   void leave(const CSG_Node *node)
+   {
+      if(node->get_type() != CSG_Node::PRIMITIVE)
+      {
+         shape << node->get_type() << " ";
+         return;
+      }
+
+      CSG_Object *object = node->get_object();
+      map<CSG_Object *, int>::iterator i = seen.find(object);
+      if(i != seen.end())
+         shape << "#" << i->second << " ";
+      else
+      {
+         int leaf = seen.size();
+         seen[object] = leaf;
+         shape << object->type_name() << " "
+               << object->get_transform().stringify() << " ";
+      }
+   }
+
+   map<CSG_Object *, int> seen;
+   ostringstream shape;
+};
+
+unsigned long CSG_Node::structural_hash(unsigned long *check) const
+{
+   Shape_Writer writer;
+   visit_tree(this, writer);
+
+   // Bob Jenkins' one-at-a-time hash, like in CSG_Dag.
+   string s = writer.shape.str();
+   unsigned long hash = 0;
+   for(string::size_type i = 0; i < s.size(); ++i)
+   {
+      hash += (unsigned char)s[i];
+      hash += hash << 10;
+      hash ^= hash >> 6;
+   }
+   hash += hash << 3;
+   hash ^= hash >> 11;
+   hash += hash << 15;
+
+   // FNV-1a, which shares nothing with the hash above.
+   if(check)
    {
-      case UNION:
-         return _left->stringify() + " " +
-                _right->stringify() + " + ";
-         break;
-      case DIFFERENCE:
-         return _left->stringify() + " " +
-                _right->stringify() + " - ";
-         break;
-      case INTERSECTION:
-         return _left->stringify() + " " +
-                _right->stringify() + " * ";
-         break;
-      case PRIMITIVE:
-         return "[ " + _object->stringify() + " ]";
-         break;
-      default:
-         return "I don't think this tree is in Kansas anymore...";
-         break;
+      *check = 2166136261UL;
+      for(string::size_type i = 0; i < s.size(); ++i)
+      {
+         *check ^= (unsigned char)s[i];
+         *check *= 16777619UL;
+      }
    }
+   return hash;
 }
 
 CSG_Node *CSG_Node::get_left() const
@@ -230,5 +405,86 @@ void CSG_Node::set_type(CSG_Node::CSG_Type type)
 {
    assert(_type != PRIMITIVE);
    assert(type != PRIMITIVE);
+   invalidate_bounds();
    _type = type;
 }
+
+/*!
+ * Computes the boxes for CSG_Node::get_bounds(), and caches them in the
+ * nodes on the heap. An operation node is only cached if both its children
+ * are, so every cached node has a cached subtree, and invalidate_bounds()
+ * can stop at the first node that is not cached.
+ */
+struct Bounds_Folder : public CSG_Folder<const CSG_Node, Bounding_Box>
+{
+   bool find(const CSG_Node *tree, Bounding_Box &box)
+   {
+      if (!tree->_bounds_cached)
+         return false;
+      box = tree->_bounds;
+      return true;
+   }
+
+   Bounding_Box primitive(const CSG_Node *tree)
+   {
+      Bounding_Box box = tree->_object->get_bounds();
+      if (!tree->get_arena())
+         tree->cache_bounds(box);
+      return box;
+   }
+
+   Bounding_Box operation(const CSG_Node *tree, const Bounding_Box &left,
+                          const Bounding_Box &right)
+   {
+      Bounding_Box box = left;
+      if (tree->_type == CSG_Node::UNION)
+      {
+         // Uniting with a box that is empty along only some axes would
+         // still grow it along the others.
+         if (box.is_empty())
+            box = right;
+         else if (!right.is_empty())
+            box.unite(right);
+      }
+      else if (tree->_type == CSG_Node::INTERSECTION)
+         box.intersect(right);
+
+      if (tree->_left->_bounds_cached && tree->_right->_bounds_cached &&
+          !tree->get_arena())
+         tree->cache_bounds(box);
+      return box;
+   }
+};
+
+Bounding_Box CSG_Node::get_bounds() const
+{
+   if (_bounds_cached)
+      return _bounds;
+   Bounds_Folder folder;
+   return fold_tree<Bounding_Box>(this, folder);
+}
+
+void CSG_Node::cache_bounds(const Bounding_Box &box) const
+{
+   // A primitive has to hear from its object when the box changes.
+   if (_type == PRIMITIVE && !_registered)
+   {
+      _object->_bounded.push_back(const_cast<CSG_Node *>(this));
+      _registered = true;
+   }
+   _bounds = box;
+   _bounds_cached = true;
+}
+
+void CSG_Node::invalidate_bounds()
+{
+   for (CSG_Node *node = this; node && node->_bounds_cached;
+        node = node->_parent)
+      node->_bounds_cached = false;
+}
+
+void CSG_Node::forget_object(CSG_Node *node)
+{
+   node->_registered = false;
+   node->invalidate_bounds();
+}
@@ -31,8 +31,11 @@
 #ifndef __CSG_TREE_H__
 #define __CSG_TREE_H__
 
+#include <cstddef>
 #include "csg_object.h"
 
+class CSG_Arena;
+
 //#include <random_compiler_errors.h>
 #undef DIFFERENCE
 //#include <rants/ms_windows/stupid_defines.h>
@@ -42,6 +45,13 @@
  *
  * All objects of this class should be allocated with new! Using global
  * or stack objects in a tree will cause bugs when the tree is destroyed!
+ *
+ * A node is allocated on the heap by plain new, or in an arena by
+ * new (arena) CSG_Node(...). Either can be deleted, which destroys the
+ * subtree as usual, but a tree in an arena can also be dropped all at once
+ * by clearing the arena. Copies and new operation nodes go where the nodes
+ * they are made from are, so a tree is either all on the heap or all in
+ * one arena, as long as nobody inserts a tree from elsewhere into it.
  */
 class CSG_Node
 {
@@ -62,16 +72,26 @@ public:
    };
 
    /*!
-    * Recursively destroys this subtree (but not any CSG_Object:s
-    * pointed to by the leafs).
+    * Destroys this subtree (but not any CSG_Object:s pointed to by the
+    * leafs). Does not recurse, so any depth is fine.
     */
    ~CSG_Node();
 
+   //! Allocates a node on the heap.
+   static void *operator new(std::size_t size);
+
+   //! Allocates a node in arena, or on the heap if arena is NULL.
+   static void *operator new(std::size_t size, CSG_Arena *arena);
+
+   static void operator delete(void *p);
+   static void operator delete(void *p, CSG_Arena *arena);
+
    //! Creates a new primitive node.
    explicit CSG_Node(CSG_Object *object);
 
    /*!
-    * Recursively copies the subtree rooted in node.
+    * Copies the subtree rooted in node, without recursion, to wherever
+    * this node is allocated.
     * Note that this sets parent of the copy to NULL.
     */
    explicit CSG_Node(const CSG_Node &node);
@@ -84,6 +104,7 @@ public:
     * become the parent of the new node.
     * It is an error for both the left and right child to already have
     * a parent.
+    * The new node is allocated where the left child is.
     * \param type What kind of operation the new node is.
     * \param left Left child.
     * \param right Right child.
@@ -137,6 +158,18 @@ public:
     */
    std::string stringify() const;
 
+   /*!
+    * Returns a hash of the shape of the subtree rooted at this node: the
+    * node types, the type and transformation of every primitive, and which
+    * leaves are the same primitive. Names and colors do not count. The
+    * transformations are hashed with the precision they are saved with, so
+    * a tree that is saved and loaded again gets the same hash.
+    *
+    * \param check If not NULL, gets a second hash of the same, computed
+    *              another way, to tell apart trees whose hashes collide.
+    */
+   unsigned long structural_hash(unsigned long *check = NULL) const;
+
    //! Get the left child. Can only be used in an operation node.
    CSG_Node *get_left() const;
    //! Get the right child. Can only be used in an operation node.
@@ -147,14 +180,45 @@ public:
    CSG_Object *get_object() const;
    //! Get the type of the object.
    CSG_Type get_type() const;
+   //! Get the arena the node is allocated in, or NULL if it is on the heap.
+   CSG_Arena *get_arena() const;
 
    //! Set the type of the object. Can only be used in an operation node.
    void set_type(CSG_Type type);
 
+   /*!
+    * Returns a world-space box around everything that the subtree rooted
+    * at this node can cover: the box of the object for a primitive, the
+    * union of the boxes of the children for a union, their intersection
+    * for an intersection, and the box of the left child for a difference.
+    *
+    * The boxes are cached in the nodes. Changing the tree, or calling
+    * CSG_Object::set_transform(), throws away the boxes on the path to the
+    * root, so that only that path is computed again the next time. Nodes
+    * in an arena are not cached, and compute their boxes every time.
+    * Not thread safe, even on different trees with the same objects.
+    */
+   Bounding_Box get_bounds() const;
+
+   /*!
+    * Throws away the cached boxes of this node and all of its ancestors.
+    * Only needed after changing something that the boxes depend on behind
+    * the back of the tree and the objects.
+    */
+   void invalidate_bounds();
+
 private:
+   friend class CSG_Object;
+   friend struct Bounds_Folder;
+
    CSG_Node(CSG_Type type, CSG_Node *left, CSG_Node *right);
    void operator=(const CSG_Node &);
 
+   void cache_bounds(const Bounding_Box &box) const;
+
+   //! Called by a dying object, so that node does not unregister from it.
+   static void forget_object(CSG_Node *node);
+
    CSG_Type _type;
    CSG_Object *_object; //!< Will be NULL in an operation node.
 
@@ -162,6 +226,10 @@ private:
    CSG_Node *_right;    //!< Will be NULL in a primitive node.
 
    CSG_Node *_parent;
+
+   mutable Bounding_Box _bounds; //!< Only valid if _bounds_cached.
+   mutable bool _bounds_cached;
+   mutable bool _registered;     //!< In the list of nodes of _object.
 };
 
 #endif
@@ -0,0 +1,175 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file csg_visitor.h
+ * Depth-first traversal of CSG trees and DAGs without recursion.
+ */
+
+#ifndef __CSG_VISITOR_H__
+#define __CSG_VISITOR_H__
+
+#include <vector>
+#include <utility>
+#include "csg_tree.h"
+
+/*!
+ * Base class for visitors of visit_tree(), with hooks that do nothing.
+ * Derived classes hide the ones they need. Node is CSG_Node or
+ * CSG_Dag_Node, const or not.
+ */
+template <class Node>
+struct CSG_Visitor
+{
+   /*!
+    * Called on the way down. If it returns false, the children of node are
+    * skipped and leave() is not called for it.
+    */
+   bool enter(Node *) { return true; }
+
+   /*!
+    * Called for operations after the left subtree has been visited. If it
+    * returns false, the right subtree is skipped, but leave() is still
+    * called.
+    */
+   bool between(Node *) { return true; }
+
+   //! Called on the way up. The calls come in RPN order.
+   void leave(Node *) {}
+};
+
+/*!
+ * Visits the tree rooted in root depth first, left before right. The stack
+ * is kept on the heap, so the depth of the tree is only limited by memory.
+ * Nodes in a DAG are visited once for every path to them, unless enter()
+ * says otherwise.
+ */
+template <class Node, class Visitor>
+void visit_tree(Node *root, Visitor &visitor)
+{
+   enum State { ENTER, BETWEEN, LEAVE };
+   std::vector<std::pair<Node *, int> > stack;
+   stack.push_back(std::make_pair(root, (int)ENTER));
+
+   while(!stack.empty())
+   {
+      Node *node = stack.back().first;
+      int state = stack.back().second++;
+
+      switch(state)
+      {
+         case ENTER:
+            if(!visitor.enter(node))
+               stack.pop_back();
+            else if(node->get_type() == CSG_Node::PRIMITIVE)
+            {
+               stack.pop_back();
+               visitor.leave(node);
+            }
+            else
+               stack.push_back(std::make_pair(node->get_left(), (int)ENTER));
+            break;
+         case BETWEEN:
+            if(visitor.between(node))
+               stack.push_back(std::make_pair(node->get_right(), (int)ENTER));
+            break;
+         default:
+            stack.pop_back();
+            visitor.leave(node);
+            break;
+      }
+   }
+}
+
+/*!
+ * Base class for folders of fold_tree(). Value is what is computed for
+ * every node.
+ */
+template <class Node, class Value>
+struct CSG_Folder
+{
+   /*!
+    * If the value of node is already known, stores it in value and returns
+    * true. The subtree of node is then skipped.
+    */
+   bool find(Node *, Value &) { return false; }
+};
+
+//! Adapts a folder to visit_tree().
+template <class Node, class Value, class Folder>
+class CSG_Fold_Visitor : public CSG_Visitor<Node>
+{
+public:
+   explicit CSG_Fold_Visitor(Folder &folder) : _folder(folder) {}
+
+   bool enter(Node *node)
+   {
+      Value value;
+      if(!_folder.find(node, value))
+         return true;
+      _values.push_back(value);
+      return false;
+   }
+
+   void leave(Node *node)
+   {
+      if(node->get_type() == CSG_Node::PRIMITIVE)
+      {
+         _values.push_back(_folder.primitive(node));
+         return;
+      }
+      Value right = _values.back();
+      _values.pop_back();
+      _values.back() = _folder.operation(node, _values.back(), right);
+   }
+
+   Value result() const
+   {
+      return _values.back();
+   }
+
+private:
+   Folder &_folder;
+   std::vector<Value> _values;
+};
+
+/*!
+ * Computes a value for every node of the tree rooted in root, bottom up and
+ * without recursion, and returns the value of root. Folder must have
+ *
+ *    Value primitive(Node *node);
+ *    Value operation(Node *node, const Value &left, const Value &right);
+ *
+ * and a find() like the one in CSG_Folder, which it can inherit.
+ */
+template <class Value, class Node, class Folder>
+Value fold_tree(Node *root, Folder &folder)
+{
+   CSG_Fold_Visitor<Node, Value, Folder> visitor(folder);
+   visit_tree(root, visitor);
+   return visitor.result();
+}
+
+#endif
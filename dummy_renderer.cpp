@@ -30,6 +30,7 @@
 
 #include <GL/glut.h>
 #include "renderer_interface.h"
+#include "csg_visitor.h"
 
 using namespace std;
 
@@ -41,6 +42,24 @@ const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
    return NULL;
 }
 
+const CSG_Node *prerender(const CSG_Node *tree, const Product_List &products,
+                          int mouse_x, int mouse_y, bool select_invisible)
+{
+   return NULL;
+}
+
+const CSG_Node *prerender(const CSG_Node *tree, const CSG_Flat_Tree &normal,
+                          int mouse_x, int mouse_y, bool select_invisible)
+{
+   return NULL;
+}
+
+const CSG_Node *prerender(const CSG_Node *tree, Product_Stream &stream,
+                          int mouse_x, int mouse_y, bool select_invisible)
+{
+   return NULL;
+}
+
 void render(const CSG_Node *tree)
 {
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -60,18 +79,26 @@ void set_render_whole()
 {
 }
 
-void traverse(const CSG_Node *tree)
+void set_overlap_graph(const Overlap_Graph *graph)
+{
+}
+
+//! Draws every primitive in its own color.
+struct Dummy_Drawer : public CSG_Visitor<const CSG_Node>
 {
-   if(tree->get_type() == CSG_Node::PRIMITIVE)
+   void leave(const CSG_Node *tree)
    {
+      if(tree->get_type() != CSG_Node::PRIMITIVE)
+         return;
       GLfloat r, g, b;
       tree->get_object()->get_color(r, g, b);
       glColor3f(r, g, b);
       tree->get_object()->render();
    }
-   else
-   {
-      traverse(tree->get_left());
-      traverse(tree->get_right());
-   }
+};
+
+void traverse(const CSG_Node *tree)
+{
+   Dummy_Drawer drawer;
+   visit_tree(tree, drawer);
 }
@@ -0,0 +1,302 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file impostor.cpp
+ * Implementation of the ray-cast impostors.
+ */
+
+// Declares the shader functions of OpenGL 2.0, where gl.h has them.
+#define GL_GLEXT_PROTOTYPES
+
+#include <iostream>
+#include "debug.h"
+#include "mesh_cache.h"
+#include "impostor.h"
+
+using namespace std;
+
+/*!
+ * Passes on the corner of the bounding cube in object coordinates, and the
+ * direction from the eye to it. An orthographic projection has the eye
+ * infinitely far away, with the same direction everywhere.
+ */
+static const char *VERTEX_SHADER =
+   "#version 120\n"
+   "varying vec3 position;\n"
+   "varying vec3 direction;\n"
+   "void main()\n"
+   "{\n"
+   "   position = gl_Vertex.xyz;\n"
+   "   if(gl_ProjectionMatrix[2][3] == 0.0)\n"
+   "      direction = -(gl_ModelViewMatrixInverse * vec4(0.0, 0.0, 1.0, 0.0)).xyz;\n"
+   "   else\n"
+   "      direction = position - (gl_ModelViewMatrixInverse *\n"
+   "                              vec4(0.0, 0.0, 0.0, 1.0)).xyz;\n"
+   "   gl_FrontColor = gl_Color;\n"
+   "   gl_BackColor = gl_Color;\n"
+   "   gl_Position = ftransform();\n"
+   "}\n";
+
+/*!
+ * Intersects the ray position + t direction with the unit shape, and keeps
+ * the point where it enters on front faces and where it leaves on back
+ * faces. The shape is a sphere of radius 0.5, or a cylinder of radius 0.5
+ * around the Y axis between y = -0.5 and 0.5, as in mesh_cache(). The
+ * shape uniform is its Primitive_Store::Type.
+ */
+static const char *FRAGMENT_SHADER =
+   "#version 120\n"
+   "uniform int shape;\n"
+   "uniform bool lighting;\n"
+   "uniform bool light;\n"
+   "varying vec3 position;\n"
+   "varying vec3 direction;\n"
+   "void main()\n"
+   "{\n"
+   "   vec3 p = position, d = direction;\n"
+   "   float a, b, c;\n"
+   "   if(shape == 2)\n"
+   "   {\n"
+   "      a = dot(d, d); b = dot(p, d); c = dot(p, p) - 0.25;\n"
+   "   }\n"
+   "   else\n"
+   "   {\n"
+   "      a = dot(d.xz, d.xz); b = dot(p.xz, d.xz); c = dot(p.xz, p.xz) - 0.25;\n"
+   "   }\n"
+   "   float disc = b * b - a * c;\n"
+   "   if(disc < 0.0 || (a == 0.0 && c > 0.0))\n"
+   "      discard;\n"
+   "   float enter = -1e30, leave = 1e30;\n"
+   "   if(a > 0.0)\n"
+   "   {\n"
+   "      enter = (-b - sqrt(disc)) / a;\n"
+   "      leave = (-b + sqrt(disc)) / a;\n"
+   "   }\n"
+   "   vec3 enter_normal = p + enter * d, leave_normal = p + leave * d;\n"
+   "   if(shape == 1)\n"
+   "   {\n"
+   "      enter_normal.y = leave_normal.y = 0.0;\n"
+   "      if(d.y == 0.0 && abs(p.y) > 0.5)\n"
+   "         discard;\n"
+   "      if(d.y != 0.0)\n"
+   "      {\n"
+   "         float bottom = (-0.5 - p.y) / d.y, top = (0.5 - p.y) / d.y;\n"
+   "         float cap = sign(d.y);\n"
+   "         if(min(bottom, top) > enter)\n"
+   "         {\n"
+   "            enter = min(bottom, top);\n"
+   "            enter_normal = vec3(0.0, -cap, 0.0);\n"
+   "         }\n"
+   "         if(max(bottom, top) < leave)\n"
+   "         {\n"
+   "            leave = max(bottom, top);\n"
+   "            leave_normal = vec3(0.0, cap, 0.0);\n"
+   "         }\n"
+   "      }\n"
+   "      if(enter > leave)\n"
+   "         discard;\n"
+   "   }\n"
+   "\n"
+   "   vec3 hit = p + (gl_FrontFacing ? enter : leave) * d;\n"
+   "   vec4 eye = gl_ModelViewMatrix * vec4(hit, 1.0);\n"
+   "   vec4 clip = gl_ProjectionMatrix * eye;\n"
+   "   gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w +\n"
+   "                         gl_DepthRange.near + gl_DepthRange.far);\n"
+   "\n"
+   "   if(!lighting)\n"
+   "   {\n"
+   "      gl_FragColor = gl_Color;\n"
+   "      return;\n"
+   "   }\n"
+   "   // Two-sided lighting turns the normals of back faces around.\n"
+   "   vec3 n = normalize(gl_NormalMatrix *\n"
+   "                      (gl_FrontFacing ? enter_normal : -leave_normal));\n"
+   "   vec4 l = gl_LightSource[0].position;\n"
+   "   vec3 to_light = normalize(l.xyz - l.w * eye.xyz);\n"
+   "   vec3 half_way = normalize(to_light + vec3(0.0, 0.0, 1.0));\n"
+   "   float diffuse = max(dot(n, to_light), 0.0);\n"
+   "   float specular = 0.0;\n"
+   "   if(!light)\n"
+   "      diffuse = 0.0;\n"
+   "   else if(diffuse > 0.0)\n"
+   "      specular = pow(max(dot(n, half_way), 0.0),\n"
+   "                     gl_FrontFacing ? gl_FrontMaterial.shininess :\n"
+   "                                      gl_BackMaterial.shininess);\n"
+   "   float lit = light ? 1.0 : 0.0;\n"
+   "   if(gl_FrontFacing)\n"
+   "      gl_FragColor = gl_FrontLightModelProduct.sceneColor +\n"
+   "         lit * gl_FrontLightProduct[0].ambient +\n"
+   "         diffuse * gl_FrontLightProduct[0].diffuse +\n"
+   "         specular * gl_FrontLightProduct[0].specular;\n"
+   "   else\n"
+   "      gl_FragColor = gl_BackLightModelProduct.sceneColor +\n"
+   "         lit * gl_BackLightProduct[0].ambient +\n"
+   "         diffuse * gl_BackLightProduct[0].diffuse +\n"
+   "         specular * gl_BackLightProduct[0].specular;\n"
+   "   gl_FragColor.a = gl_FrontFacing ? gl_FrontMaterial.diffuse.a :\n"
+   "                                     gl_BackMaterial.diffuse.a;\n"
+   "}\n";
+
+//! How far outside its bounding cube the eye must be, in object coordinates.
+static const GLfloat EYE_MARGIN = 0.01;
+
+Impostors::Impostors() :
+   _enabled(false), _available(-1), _program(0), _shape(-1), _lighting(-1),
+   _light(-1)
+{
+}
+
+void Impostors::set_enabled(bool enabled)
+{
+   _enabled = enabled;
+}
+
+bool Impostors::enabled() const
+{
+   return _enabled;
+}
+
+#ifdef GL_VERSION_2_0
+//! Compiles a shader, or returns 0 if it does not compile.
+static GLuint compile(GLenum type, const char *source)
+{
+   GLuint shader = glCreateShader(type);
+   glShaderSource(shader, 1, &source, NULL);
+   glCompileShader(shader);
+   GLint compiled;
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+   if(!compiled)
+   {
+      DBG(cout << "Impostors: a shader does not compile" << endl);
+      glDeleteShader(shader);
+      return 0;
+   }
+   return shader;
+}
+#endif
+
+/*!
+ * Compiles and links the shaders, unless that has already been tried.
+ * Returns false if they do not work.
+ */
+bool Impostors::prepare()
+{
+#ifdef GL_VERSION_2_0
+   if(_available >= 0)
+      return _available;
+   int version = gl_version();
+   if(version < 0)
+      return false; // No context yet, so ask again next time.
+   _available = 0;
+   if(version < 21)
+      return false;
+
+   GLuint vertex = compile(GL_VERTEX_SHADER, VERTEX_SHADER);
+   GLuint fragment = compile(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+   if(!vertex || !fragment)
+   {
+      glDeleteShader(vertex);
+      glDeleteShader(fragment);
+      return false;
+   }
+
+   _program = glCreateProgram();
+   glAttachShader(_program, vertex);
+   glAttachShader(_program, fragment);
+   glLinkProgram(_program);
+   glDeleteShader(vertex); // They go when the program does.
+   glDeleteShader(fragment);
+   GLint linked;
+   glGetProgramiv(_program, GL_LINK_STATUS, &linked);
+   if(!linked)
+   {
+      DBG(cout << "Impostors: the shaders do not link" << endl);
+      glDeleteProgram(_program);
+      _program = 0;
+      return false;
+   }
+
+   _shape = glGetUniformLocation(_program, "shape");
+   _lighting = glGetUniformLocation(_program, "lighting");
+   _light = glGetUniformLocation(_program, "light");
+   _available = 1;
+   DBG(cout << "Impostors: using impostors" << endl);
+   return true;
+#else
+   return false;
+#endif
+}
+
+bool Impostors::available()
+{
+   return _enabled && prepare();
+}
+
+bool Impostors::covers(const Matrix &modelview, const Matrix &projection)
+{
+   // An orthographic projection has no eye to be inside anything.
+   if(projection.data[11] == 0)
+      return true;
+
+   Vector eye = affine_inverse(modelview) * Vector(0, 0, 0, 1);
+   for(int i = 0; i < 3; ++i)
+      if(eye.data[i] < -0.5 - EYE_MARGIN || eye.data[i] > 0.5 + EYE_MARGIN)
+         return true;
+   return false;
+}
+
+bool Impostors::draw(Primitive_Store::Type type)
+{
+   if(type == Primitive_Store::CUBE || !available())
+      return false;
+#ifdef GL_VERSION_2_0
+   Matrix modelview, projection;
+   glGetFloatv(GL_MODELVIEW_MATRIX, modelview.data);
+   glGetFloatv(GL_PROJECTION_MATRIX, projection.data);
+   if(!covers(modelview, projection))
+      return false;
+
+   glUseProgram(_program);
+   glUniform1i(_shape, type);
+   glUniform1i(_lighting, glIsEnabled(GL_LIGHTING));
+   glUniform1i(_light, glIsEnabled(GL_LIGHT0));
+   mesh_cache().draw(Primitive_Store::CUBE, 0);
+   glUseProgram(0);
+   return true;
+#else
+   return false;
+#endif
+}
+
+Impostors &impostors()
+{
+   static Impostors *impostors = new Impostors;
+   return *impostors;
+}
@@ -0,0 +1,109 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file impostor.h
+ * Spheres and cylinders ray-cast in a fragment shader.
+ */
+
+#ifndef __IMPOSTOR_H__
+#define __IMPOSTOR_H__
+
+#include <GL/gl.h>
+#include "matrix.h"
+#include "primitive_store.h"
+
+/*!
+ * Draws spheres and cylinders as the faces of their bounding cube, with a
+ * fragment shader that casts the ray of every pixel against the exact unit
+ * shape. A front face writes the depth where the ray enters the shape, and
+ * a back face the depth where it leaves it, so the shape looks to the depth
+ * and stencil tests just like a mesh that glCullFace() has culled the same
+ * faces of, only without the facets. Rays that miss the shape are
+ * discarded.
+ *
+ * The shader lights the shape with light 0, the light model and the
+ * material like the fixed pipeline does with two-sided lighting, except
+ * that it does it per pixel and without attenuation or spot lights. With
+ * lighting disabled it writes the current color.
+ *
+ * Cubes have nothing to gain and are always left to the mesh. Neither are
+ * shapes with the eye inside their bounding cube, since it has no front
+ * faces there.
+ *
+ * The shader only needs OpenGL 2.1 and GLSL 1.20.
+ */
+class Impostors
+{
+public:
+   Impostors();
+
+   void set_enabled(bool enabled);
+   bool enabled() const;
+
+   /*!
+    * True if draw() can draw: impostors are enabled and the shader works.
+    * Needs a context.
+    */
+   bool available();
+
+   /*!
+    * Draws a unit shape of type, with the current transformation, as an
+    * impostor.
+    *
+    * \return false, without drawing anything, for cubes, when available()
+    *         is false, and when covers() is false for the current matrices.
+    */
+   bool draw(Primitive_Store::Type type);
+
+   /*!
+    * True if the bounding cube of a unit shape drawn with these matrices
+    * has both front and back faces over every pixel of the shape, so that
+    * the impostor can stand in for the mesh.
+    */
+   static bool covers(const Matrix &modelview, const Matrix &projection);
+
+private:
+   Impostors(const Impostors &);
+   void operator=(const Impostors &);
+
+   bool prepare();
+
+   bool _enabled;
+   int _available;  //!< 1 if the shader works, 0 if not, -1 if not checked yet.
+   GLuint _program;
+   GLint _shape;    //!< Uniform locations.
+   GLint _lighting;
+   GLint _light;
+};
+
+//! The impostors that all objects draw themselves with, when enabled.
+Impostors &impostors();
+
+#endif
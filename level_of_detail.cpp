@@ -0,0 +1,196 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file level_of_detail.cpp
+ * Implementation of the level of detail selection.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "debug.h"
+#include "mesh_cache.h"
+#include "level_of_detail.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace std;
+
+//! The precisions that round primitives are drawn with, from coarse to fine.
+static const int LEVELS[] = { 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+static const int NUM_LEVELS = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+//! A coarser level is only taken once its error is this part of the tolerance.
+static const GLfloat HYSTERESIS = 0.5;
+
+//! How much the vertex budget changes the tolerance per frame.
+static const GLfloat PRESSURE_STEP = 1.25;
+
+Level_Of_Detail::Level_Of_Detail() :
+   _enabled(false), _tolerance(0.5), _pressure(1), _budget(0),
+   _vertices(0), _full_vertices(0)
+{
+}
+
+void Level_Of_Detail::set_enabled(bool enabled)
+{
+   _enabled = enabled;
+}
+
+bool Level_Of_Detail::enabled() const
+{
+   return _enabled;
+}
+
+void Level_Of_Detail::set_tolerance(GLfloat pixels)
+{
+   _tolerance = pixels;
+   _pressure = 1;
+}
+
+void Level_Of_Detail::set_vertex_budget(unsigned long vertices)
+{
+   _budget = vertices;
+   _pressure = 1;
+}
+
+//! The coarsest level that draws a circle of radius pixels within tolerance.
+int Level_Of_Detail::level_for(GLfloat pixels, GLfloat tolerance) const
+{
+   for(int i = 0; i < NUM_LEVELS; ++i)
+      if(pixels * (1 - cos(M_PI / LEVELS[i])) <= tolerance)
+         return LEVELS[i];
+   return LEVELS[NUM_LEVELS - 1];
+}
+
+//! Length of column c of the linear part of m.
+static GLfloat column_length(const Matrix &m, int c)
+{
+   const GLfloat *d = m.data + 4 * c;
+   return sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+void Level_Of_Detail::update(const vector<CSG_Object *> &objects,
+                             const Matrix &view, GLfloat focal)
+{
+   GLfloat tolerance = _tolerance * _pressure;
+   _vertices = _full_vertices = 0;
+   bool reducible = false; // Could a larger tolerance make anything coarser?
+
+   for(unsigned int i = 0; i < objects.size(); ++i)
+   {
+      const CSG_Object *object = objects[i];
+      Primitive_Store::Type type = object->get_type();
+      int own = object->get_precision();
+      Primitive_Store::Slot slot = object->get_slot();
+      if(slot >= _precision.size())
+      {
+         _precision.resize(slot + 1, 0);
+         _owner.resize(slot + 1, NULL);
+      }
+      if(_owner[slot] != object)
+      {
+         _owner[slot] = object;
+         _precision[slot] = 0;
+      }
+
+      int chosen = own;
+      if(type != Primitive_Store::CUBE)
+      {
+         // The radius of the round part, and how far in front of the eye
+         // its centre is.
+         const Matrix &m = object->get_transform();
+         GLfloat radius = max(column_length(m, 0), column_length(m, 2));
+         if(type == Primitive_Store::SPHERE)
+            radius = max(radius, column_length(m, 1));
+         radius *= 0.5;
+         Vector centre = view * Vector(m.data[12], m.data[13], m.data[14], 1);
+         GLfloat distance = -centre.data[2];
+
+         if(distance <= radius)
+            chosen = LEVELS[NUM_LEVELS - 1]; // The eye is inside or close.
+         else
+         {
+            GLfloat pixels = radius * focal / distance;
+            int current = _precision[slot];
+            chosen = level_for(pixels, tolerance);
+            if(current > chosen)
+            {
+               // Only go coarser once it is well within the tolerance.
+               int coarse = level_for(pixels, tolerance * HYSTERESIS);
+               chosen = coarse < current ? coarse : current;
+            }
+            if(min(chosen, own) > LEVELS[0])
+               reducible = true;
+         }
+         _precision[slot] = chosen;
+         if(chosen > own)
+            chosen = own;
+      }
+
+      _vertices += mesh_cache().get(type, chosen).vertices.size() / 3;
+      _full_vertices += mesh_cache().get(type, own).vertices.size() / 3;
+   }
+
+   // Once everything is as coarse as it goes, more pressure would only grow
+   // without bound and then take many frames to come back down.
+   if(_budget && _vertices > _budget && reducible)
+      _pressure *= PRESSURE_STEP;
+   else if(_budget && _vertices < _budget / 2 && _pressure > 1)
+      _pressure = max(GLfloat(1), _pressure / PRESSURE_STEP);
+
+   DBG(cout << "Level_Of_Detail::update: " << _vertices << " of "
+            << _full_vertices << " vertices, tolerance " << tolerance
+            << " pixels" << endl);
+}
+
+int Level_Of_Detail::precision(const CSG_Object *object) const
+{
+   int own = object->get_precision();
+   Primitive_Store::Slot slot = object->get_slot();
+   if(!_enabled || slot >= _precision.size() || _owner[slot] != object ||
+      !_precision[slot] || _precision[slot] > own)
+      return own;
+   return _precision[slot];
+}
+
+unsigned long Level_Of_Detail::vertices() const
+{
+   return _vertices;
+}
+
+unsigned long Level_Of_Detail::full_vertices() const
+{
+   return _full_vertices;
+}
+
+Level_Of_Detail &level_of_detail()
+{
+   static Level_Of_Detail *lod = new Level_Of_Detail;
+   return *lod;
+}
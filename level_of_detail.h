@@ -0,0 +1,110 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file level_of_detail.h
+ * Picks the tessellation of every primitive from its size on the screen.
+ */
+
+#ifndef __LEVEL_OF_DETAIL_H__
+#define __LEVEL_OF_DETAIL_H__
+
+#include <vector>
+#include <GL/gl.h>
+#include "matrix.h"
+#include "csg_object.h"
+
+/*!
+ * Chooses the precision that spheres and cylinders are drawn with, instead
+ * of the one stored in each object, from how large their round parts are
+ * on the screen. A circle of radius r pixels drawn as an n-gon is off by
+ * at most r (1 - cos(pi / n)) pixels, and every primitive gets the
+ * coarsest of a few fixed levels whose error is within the tolerance, but
+ * never a finer one than its own precision. The levels are few so that
+ * mesh_cache() only holds a few meshes per type.
+ *
+ * A primitive goes to a finer level as soon as it needs to, but only back
+ * to a coarser level once that is well within the tolerance, so that a
+ * primitive on the edge between two levels does not switch every frame.
+ *
+ * With a vertex budget, the tolerance is raised a little every frame that
+ * the chosen meshes have more vertices than the budget and some sphere or
+ * cylinder can still get coarser, and lowered again when they have much
+ * fewer.
+ */
+class Level_Of_Detail
+{
+public:
+   Level_Of_Detail();
+
+   //! While disabled, precision() is the precision of the object.
+   void set_enabled(bool enabled);
+   bool enabled() const;
+
+   /*!
+    * The error allowed on the screen, in pixels. The default is 0.5.
+    * Undoes what the vertex budget has added to it.
+    */
+   void set_tolerance(GLfloat pixels);
+
+   //! Most vertices the meshes of all primitives may have, or 0 for no limit.
+   void set_vertex_budget(unsigned long vertices);
+
+   /*!
+    * Chooses the levels of objects for a frame.
+    *
+    * \param view   The transformation from world to eye coordinates.
+    * \param focal  Pixels per unit at distance 1 from the eye, which is
+    *               half the viewport height times element 5 of a
+    *               perspective projection matrix.
+    */
+   void update(const std::vector<CSG_Object *> &objects, const Matrix &view,
+               GLfloat focal);
+
+   //! The precision to draw object with.
+   int precision(const CSG_Object *object) const;
+
+   //! Vertices in the meshes chosen by the last update(), once per object.
+   unsigned long vertices() const;
+   //! Vertices in the meshes of the same objects at their own precisions.
+   unsigned long full_vertices() const;
+
+private:
+   int level_for(GLfloat pixels, GLfloat tolerance) const;
+
+   bool _enabled;
+   GLfloat _tolerance;
+   GLfloat _pressure; //!< Factor on the tolerance from the vertex budget.
+   unsigned long _budget;
+   std::vector<int> _precision;               //!< By slot, 0 if not chosen.
+   std::vector<const CSG_Object *> _owner;    //!< By slot, who it was chosen for.
+   unsigned long _vertices;
+   unsigned long _full_vertices;
+};
+
+//! The levels that all objects are drawn with.
+Level_Of_Detail &level_of_detail();
+
+#endif
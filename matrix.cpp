@@ -164,3 +164,35 @@ Matrix rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z)
 
    return rx.transpose() * ry.transpose() * rz * ry * rx;
 }
+
+Matrix affine_inverse(const Matrix &m)
+{
+   const GLfloat *a = m.data;
+
+   // Cofactors of the upper left 3x3 part, stored transposed.
+   GLfloat c[9] = { a[5] * a[10] - a[9] * a[6],
+                    a[9] * a[2]  - a[1] * a[10],
+                    a[1] * a[6]  - a[5] * a[2],
+                    a[8] * a[6]  - a[4] * a[10],
+                    a[0] * a[10] - a[8] * a[2],
+                    a[4] * a[2]  - a[0] * a[6],
+                    a[4] * a[9]  - a[8] * a[5],
+                    a[8] * a[1]  - a[0] * a[9],
+                    a[0] * a[5]  - a[4] * a[1] };
+   GLfloat det = a[0] * c[0] + a[4] * c[1] + a[8] * c[2];
+
+   GLfloat zeros[16] = { 0 };
+   Matrix inverse(zeros);
+   if(det == 0)
+      return inverse;
+
+   for(int col = 0; col < 3; ++col)
+      for(int row = 0; row < 3; ++row)
+         inverse.data[col * 4 + row] = c[col * 3 + row] / det;
+   for(int row = 0; row < 3; ++row)
+      inverse.data[12 + row] = -(inverse.data[row] * a[12] +
+                                 inverse.data[4 + row] * a[13] +
+                                 inverse.data[8 + row] * a[14]);
+   inverse.data[15] = 1;
+   return inverse;
+}
@@ -90,6 +90,12 @@ Matrix scale(GLfloat x, GLfloat y, GLfloat z);
  */
 Matrix rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z);
 
+/*!
+ * The inverse of an affine transformation, one whose bottom row is
+ * (0, 0, 0, 1). A singular matrix gives a matrix of zeros.
+ */
+Matrix affine_inverse(const Matrix &m);
+
 // Implementation
 
 Matrix::Matrix(const GLfloat *d)
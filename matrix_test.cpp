@@ -24,10 +24,21 @@
 //
 
 #include <cassert>
+#include <cmath>
 #include "matrix.h"
 
 using namespace std;
 
+//! True if affine_inverse(m) * m is the identity, up to rounding.
+bool inverts(const Matrix &m)
+{
+   Matrix identity, round_trip = affine_inverse(m) * m;
+   for(int i = 0; i < 16; ++i)
+      if(fabs(round_trip.data[i] - identity.data[i]) >= 1e-5)
+         return false;
+   return true;
+}
+
 int main()
 {
    Matrix m;
@@ -91,5 +102,12 @@ int main()
    assert(Matrix(translation) * Vector(origin) != Vector(0, 0, 0, 1));
    assert(Matrix(translation) * Vector(origin) == Vector(1, 2, 3, 1));
 
+   assert(affine_inverse(Matrix(translation)) == translate(-1, -2, -3));
+   assert(affine_inverse(scale(2, 4, 8)) == scale(0.5, 0.25, 0.125));
+   assert(affine_inverse(Matrix(rotation)) == Matrix(rotation));
+   assert(affine_inverse(scale(1, 0, 1)) != identity);
+
+   assert(inverts(translate(1, 2, 3) * rotate_x(0.5) * scale(2, 2, 2)));
+
    return 0;
 }
@@ -0,0 +1,693 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file mesh_cache.cpp
+ * Implementation of the mesh cache.
+ */
+
+// Declares the buffer object functions of OpenGL 1.5, and the shader and
+// instancing functions of OpenGL 3.3, where gl.h has them.
+#define GL_GLEXT_PROTOTYPES
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include "debug.h"
+#include "mesh_cache.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace std;
+
+/*!
+ * Transforms every copy by its own matrix, all the way to clip
+ * coordinates. The matrix takes four attribute locations from
+ * TRANSFORM_LOCATION. Location 0 is gl_Vertex.
+ */
+static const char *INSTANCE_SHADER =
+   "#version 120\n"
+   "attribute mat4 transform;\n"
+   "void main()\n"
+   "{\n"
+   "   gl_Position = transform * gl_Vertex;\n"
+   "}\n";
+static const GLuint TRANSFORM_LOCATION = 1;
+
+int gl_version()
+{
+   const char *version = (const char *)glGetString(GL_VERSION);
+   if(!version)
+      return -1;
+   int major = 0, minor = 0;
+   char dot;
+   istringstream in(version);
+   in >> major >> dot >> minor;
+   DBG(cout << "gl_version: " << version << endl);
+   return major * 10 + minor;
+}
+
+//! Adds a vertex and its normal to mesh, and returns its index.
+static GLuint add_vertex(Mesh_Cache::Mesh &mesh, const GLfloat position[3],
+                         const GLfloat normal[3])
+{
+   mesh.vertices.insert(mesh.vertices.end(), position, position + 3);
+   mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+   return mesh.vertices.size() / 3 - 1;
+}
+
+static void add_triangle(Mesh_Cache::Mesh &mesh, GLuint a, GLuint b, GLuint c)
+{
+   mesh.triangles.push_back(a);
+   mesh.triangles.push_back(b);
+   mesh.triangles.push_back(c);
+}
+
+static void add_line(Mesh_Cache::Mesh &mesh, GLuint a, GLuint b)
+{
+   mesh.lines.push_back(a);
+   mesh.lines.push_back(b);
+}
+
+//! Six faces of four vertices each, so that every face has its own normal.
+static void build_cube(Mesh_Cache::Mesh &mesh)
+{
+   static const GLfloat corner[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+   for(int axis = 0; axis < 3; ++axis)
+      for(int sign = -1; sign <= 1; sign += 2)
+      {
+         // The cross product of the u and v axes points out of the face.
+         int u = (axis + (sign > 0 ? 1 : 2)) % 3;
+         int v = (axis + (sign > 0 ? 2 : 1)) % 3;
+         GLuint first = mesh.vertices.size() / 3;
+         for(int c = 0; c < 4; ++c)
+         {
+            GLfloat position[3], normal[3] = { 0, 0, 0 };
+            position[axis] = 0.5 * sign;
+            position[u] = 0.5 * corner[c][0];
+            position[v] = 0.5 * corner[c][1];
+            normal[axis] = sign;
+            add_vertex(mesh, position, normal);
+         }
+         add_triangle(mesh, first, first + 1, first + 2);
+         add_triangle(mesh, first, first + 2, first + 3);
+         for(int c = 0; c < 4; ++c)
+            add_line(mesh, first + c, first + (c + 1) % 4);
+      }
+}
+
+/*!
+ * A hull of faces around the Y axis, with smooth normals, and two flat end
+ * caps with vertices of their own.
+ */
+static void build_cylinder(Mesh_Cache::Mesh &mesh, int faces)
+{
+   for(int i = 0; i < faces; ++i)
+   {
+      GLfloat angle = 2 * M_PI * i / faces;
+      GLfloat normal[3] = { cos(angle), 0, sin(angle) };
+      GLfloat bottom[3] = { 0.5f * normal[0], -0.5f, 0.5f * normal[2] };
+      GLfloat top[3] = { 0.5f * normal[0], 0.5f, 0.5f * normal[2] };
+      add_vertex(mesh, bottom, normal);
+      add_vertex(mesh, top, normal);
+   }
+   for(int i = 0; i < faces; ++i)
+   {
+      GLuint b = 2 * i, t = 2 * i + 1;
+      GLuint next_b = 2 * ((i + 1) % faces), next_t = next_b + 1;
+      add_triangle(mesh, b, t, next_b);
+      add_triangle(mesh, next_b, t, next_t);
+      add_line(mesh, b, t);
+      add_line(mesh, b, next_b);
+      add_line(mesh, t, next_t);
+   }
+
+   for(int sign = -1; sign <= 1; sign += 2)
+   {
+      GLfloat y = 0.5f * sign;
+      GLfloat normal[3] = { 0, 2 * y, 0 };
+      GLfloat centre[3] = { 0, y, 0 };
+      GLuint middle = add_vertex(mesh, centre, normal);
+      for(int i = 0; i < faces; ++i)
+      {
+         GLfloat angle = 2 * M_PI * i / faces;
+         GLfloat position[3] = { 0.5f * cos(angle), y, 0.5f * sin(angle) };
+         add_vertex(mesh, position, normal);
+      }
+      for(int i = 0; i < faces; ++i)
+      {
+         GLuint here = middle + 1 + i, next = middle + 1 + (i + 1) % faces;
+         if(sign > 0)
+            add_triangle(mesh, middle, next, here);
+         else
+            add_triangle(mesh, middle, here, next);
+      }
+   }
+}
+
+/*!
+ * Rings of vertices from the bottom pole to the top one, around the Y axis.
+ * The poles are rings of equal vertices, whose empty triangles are left out.
+ */
+static void build_sphere(Mesh_Cache::Mesh &mesh, int slices, int stacks)
+{
+   for(int k = 0; k <= stacks; ++k)
+   {
+      GLfloat latitude = M_PI * k / stacks - M_PI / 2;
+      for(int i = 0; i < slices; ++i)
+      {
+         GLfloat longitude = 2 * M_PI * i / slices;
+         GLfloat normal[3] = { cos(latitude) * cos(longitude), sin(latitude),
+                               cos(latitude) * sin(longitude) };
+         GLfloat position[3] = { 0.5f * normal[0], 0.5f * normal[1],
+                                 0.5f * normal[2] };
+         add_vertex(mesh, position, normal);
+      }
+   }
+   for(int k = 0; k < stacks; ++k)
+      for(int i = 0; i < slices; ++i)
+      {
+         GLuint b = k * slices + i, next_b = k * slices + (i + 1) % slices;
+         GLuint t = b + slices, next_t = next_b + slices;
+         if(k > 0)
+         {
+            add_triangle(mesh, b, t, next_b);
+            add_line(mesh, b, next_b);
+         }
+         if(k < stacks - 1)
+            add_triangle(mesh, next_b, t, next_t);
+         add_line(mesh, b, t);
+      }
+}
+
+/*!
+ * Vertices that the optimizer assumes fit in the post-transform cache.
+ * More than most cards have, which still suits their small FIFO caches,
+ * and also the larger vertex reuse of software renderers such as llvmpipe.
+ */
+static const unsigned int OPTIMIZER_CACHE = 96;
+
+/*!
+ * How much a vertex makes its triangles worth drawing next, from its
+ * position in the simulated cache, or -1 if it is not there, and the
+ * number of its triangles that are left to draw. From Tom Forsyth's
+ * "Linear-Speed Vertex Cache Optimisation".
+ */
+static float vertex_score(int position, unsigned int remaining)
+{
+   if(!remaining)
+      return -1;
+   float score = 0;
+   if(position >= 0 && position < 3)
+      score = 0.75; // The last triangle, which should not be used forever.
+   else if(position >= 3)
+      score = pow(1 - float(position - 3) / (OPTIMIZER_CACHE - 3), 1.5f);
+   // Vertices with few triangles left are finished first.
+   return score + 2 / sqrt(float(remaining));
+}
+
+/*!
+ * Reorders the triangles of mesh so that the post-transform vertex cache
+ * of the graphics card hits as often as it can, by always drawing the
+ * triangle with the best vertices next. The vertices are then numbered in
+ * the order the triangles use them, so that they are also read in order.
+ */
+static void optimize_for_cache(Mesh_Cache::Mesh &mesh)
+{
+   vector<GLuint> &triangles = mesh.triangles;
+   unsigned int num_vertices = mesh.vertices.size() / 3;
+   unsigned int num_triangles = triangles.size() / 3;
+
+   // The triangles of vertex v that are left to draw are the first
+   // remaining[v] of of[first[v]] onwards.
+   vector<unsigned int> first(num_vertices + 1, 0);
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+      ++first[triangles[i] + 1];
+   for(unsigned int v = 0; v < num_vertices; ++v)
+      first[v + 1] += first[v];
+   vector<unsigned int> of(triangles.size()), remaining(num_vertices, 0);
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+   {
+      GLuint v = triangles[i];
+      of[first[v] + remaining[v]++] = i / 3;
+   }
+
+   vector<int> position(num_vertices, -1);
+   vector<float> score(num_vertices);
+   vector<float> triangle_score(num_triangles, 0);
+   for(unsigned int v = 0; v < num_vertices; ++v)
+      score[v] = vertex_score(-1, remaining[v]);
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+      triangle_score[i / 3] += score[triangles[i]];
+
+   vector<bool> drawn(num_triangles, false);
+   vector<GLuint> order, cache, next;
+   order.reserve(triangles.size());
+   for(unsigned int done = 0; done < num_triangles; ++done)
+   {
+      // The best triangle of a vertex in the cache, or of all of them if
+      // none is left there.
+      int best = -1;
+      for(unsigned int c = 0; c < cache.size(); ++c)
+      {
+         GLuint v = cache[c];
+         for(unsigned int k = first[v]; k < first[v] + remaining[v]; ++k)
+            if(best < 0 || triangle_score[of[k]] > triangle_score[best])
+               best = of[k];
+      }
+      if(best < 0)
+         for(unsigned int t = 0; t < num_triangles; ++t)
+            if(!drawn[t] && (best < 0 || triangle_score[t] > triangle_score[best]))
+               best = t;
+
+      drawn[best] = true;
+      const GLuint *corner = &triangles[3 * best];
+      order.insert(order.end(), corner, corner + 3);
+      for(int c = 0; c < 3; ++c)
+      {
+         GLuint v = corner[c];
+         unsigned int k = first[v];
+         while(of[k] != GLuint(best))
+            ++k;
+         of[k] = of[first[v] + --remaining[v]];
+      }
+
+      // The corners go first in the cache, and push the rest back.
+      next.assign(corner, corner + 3);
+      for(unsigned int c = 0; c < cache.size(); ++c)
+         if(cache[c] != corner[0] && cache[c] != corner[1] &&
+            cache[c] != corner[2])
+            next.push_back(cache[c]);
+      cache.swap(next);
+      for(unsigned int c = 0; c < cache.size(); ++c)
+      {
+         GLuint v = cache[c];
+         position[v] = c < OPTIMIZER_CACHE ? c : -1;
+         float change = vertex_score(position[v], remaining[v]) - score[v];
+         score[v] += change;
+         for(unsigned int k = first[v]; k < first[v] + remaining[v]; ++k)
+            triangle_score[of[k]] += change;
+      }
+      if(cache.size() > OPTIMIZER_CACHE)
+         cache.resize(OPTIMIZER_CACHE);
+   }
+   triangles.swap(order);
+
+   // Number the vertices by first use. Any that no triangle uses go last.
+   const GLuint NONE = ~GLuint(0);
+   vector<GLuint> number(num_vertices, NONE);
+   GLuint count = 0;
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+      if(number[triangles[i]] == NONE)
+         number[triangles[i]] = count++;
+   for(unsigned int v = 0; v < num_vertices; ++v)
+      if(number[v] == NONE)
+         number[v] = count++;
+
+   vector<GLfloat> vertices(mesh.vertices.size()), normals(mesh.normals.size());
+   for(unsigned int v = 0; v < num_vertices; ++v)
+      for(int k = 0; k < 3; ++k)
+      {
+         vertices[3 * number[v] + k] = mesh.vertices[3 * v + k];
+         normals[3 * number[v] + k] = mesh.normals[3 * v + k];
+      }
+   mesh.vertices.swap(vertices);
+   mesh.normals.swap(normals);
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+      triangles[i] = number[triangles[i]];
+   for(unsigned int i = 0; i < mesh.lines.size(); ++i)
+      mesh.lines[i] = number[mesh.lines[i]];
+}
+
+double cache_miss_ratio(const vector<GLuint> &triangles,
+                        unsigned int cache_size)
+{
+   if(triangles.empty())
+      return 0;
+
+   // A FIFO cache holds a vertex until cache_size other vertices have
+   // been put in after it.
+   GLuint last = *max_element(triangles.begin(), triangles.end());
+   vector<long> put_in(last + 1, -1);
+   long misses = 0;
+   for(unsigned int i = 0; i < triangles.size(); ++i)
+   {
+      GLuint v = triangles[i];
+      if(put_in[v] < 0 || misses - put_in[v] > long(cache_size))
+         put_in[v] = misses++;
+   }
+   return double(misses) / (triangles.size() / 3);
+}
+
+Mesh_Cache::Mesh_Cache() :
+   _mode(BUFFERS), _buffers(-1), _instancing(-1), _instancing_enabled(true),
+   _program(0), _instance_buffer(0), _optimize(true), _drawn(0),
+   _triangles_drawn(0)
+{
+}
+
+const Mesh_Cache::Mesh &Mesh_Cache::get(Primitive_Store::Type type,
+                                        int precision)
+{
+   if(type == Primitive_Store::CUBE)
+      precision = 0;
+   else if(precision < 3)
+      precision = 3;
+
+   pair<int, int> key(type, precision);
+   map<pair<int, int>, Mesh>::iterator i = _meshes.find(key);
+   if(i != _meshes.end())
+      return i->second;
+
+   Mesh &mesh = _meshes[key];
+   mesh.vertex_buffer = mesh.index_buffer = 0;
+   switch(type)
+   {
+      case Primitive_Store::CUBE:
+         build_cube(mesh);
+         break;
+      case Primitive_Store::CYLINDER:
+         build_cylinder(mesh, precision);
+         break;
+      case Primitive_Store::SPHERE:
+         build_sphere(mesh, precision, precision);
+         break;
+   }
+   if(_optimize)
+      optimize_for_cache(mesh);
+
+   DBG(cout << "Mesh_Cache::get: built mesh " << type << "/" << precision
+            << " with " << mesh.vertices.size() / 3 << " vertices and "
+            << mesh.triangles.size() / 3 << " triangles" << endl);
+   return mesh;
+}
+
+/*!
+ * Puts mesh into buffer objects, unless it already is. Returns false if
+ * there are no buffer objects to put it in.
+ */
+bool Mesh_Cache::upload(Mesh &mesh)
+{
+#ifdef GL_VERSION_1_5
+   if(_buffers < 0)
+   {
+      int version = gl_version();
+      if(version < 0)
+         return false; // No context yet, so ask again next time.
+      _buffers = version >= 15 ? 1 : 0;
+      DBG(cout << "Mesh_Cache: " << (_buffers ? "using" : "without")
+               << " buffer objects" << endl);
+   }
+   if(!_buffers)
+      return false;
+   if(mesh.vertex_buffer)
+      return true;
+
+   GLuint buffers[2];
+   glGenBuffers(2, buffers);
+   mesh.vertex_buffer = buffers[0];
+   mesh.index_buffer = buffers[1];
+
+   GLsizeiptr vertex_size = mesh.vertices.size() * sizeof(GLfloat);
+   glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+   glBufferData(GL_ARRAY_BUFFER, 2 * vertex_size, NULL, GL_STATIC_DRAW);
+   glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_size, &mesh.vertices[0]);
+   glBufferSubData(GL_ARRAY_BUFFER, vertex_size, vertex_size, &mesh.normals[0]);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   GLsizeiptr triangle_size = mesh.triangles.size() * sizeof(GLuint);
+   GLsizeiptr line_size = mesh.lines.size() * sizeof(GLuint);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangle_size + line_size, NULL,
+                GL_STATIC_DRAW);
+   glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, triangle_size,
+                   &mesh.triangles[0]);
+   glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, triangle_size, line_size,
+                   &mesh.lines[0]);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   return true;
+#else
+   return false;
+#endif
+}
+
+void Mesh_Cache::draw(Primitive_Store::Type type, int precision, bool wire)
+{
+   Mesh &mesh = const_cast<Mesh &>(get(type, precision));
+   const vector<GLuint> &indices = wire ? mesh.lines : mesh.triangles;
+   GLenum primitive = wire ? GL_LINES : GL_TRIANGLES;
+   _drawn += mesh.vertices.size() / 3;
+   if(!wire)
+      _triangles_drawn += mesh.triangles.size() / 3;
+
+   if(_mode == IMMEDIATE)
+   {
+      glBegin(primitive);
+      for(unsigned int i = 0; i < indices.size(); ++i)
+      {
+         glNormal3fv(&mesh.normals[3 * indices[i]]);
+         glVertex3fv(&mesh.vertices[3 * indices[i]]);
+      }
+      glEnd();
+      return;
+   }
+
+   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_NORMAL_ARRAY);
+
+#ifdef GL_VERSION_1_5
+   if(_mode == BUFFERS && upload(mesh))
+   {
+      // The pointers are offsets into the bound buffers.
+      const char *start = NULL;
+      glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+      glVertexPointer(3, GL_FLOAT, 0, start);
+      glNormalPointer(GL_FLOAT, 0,
+                      start + mesh.vertices.size() * sizeof(GLfloat));
+      glDrawElements(primitive, indices.size(), GL_UNSIGNED_INT,
+                     start + (wire ? mesh.triangles.size() * sizeof(GLuint) : 0));
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      glPopClientAttrib();
+      return;
+   }
+#endif
+
+   glVertexPointer(3, GL_FLOAT, 0, &mesh.vertices[0]);
+   glNormalPointer(GL_FLOAT, 0, &mesh.normals[0]);
+   glDrawElements(primitive, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+   glPopClientAttrib();
+}
+
+/*!
+ * Compiles the instancing shader and makes the buffer for the
+ * transformations, unless that has already been tried. Returns false if
+ * instancing is not available.
+ */
+bool Mesh_Cache::prepare_instancing()
+{
+#ifdef GL_VERSION_3_3
+   if(_instancing >= 0)
+      return _instancing;
+   int version = gl_version();
+   if(version < 0)
+      return false; // No context yet, so ask again next time.
+   _instancing = 0;
+   if(version < 33)
+      return false;
+
+   GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+   glShaderSource(shader, 1, &INSTANCE_SHADER, NULL);
+   glCompileShader(shader);
+   GLint compiled;
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+   _program = glCreateProgram();
+   glAttachShader(_program, shader);
+   glBindAttribLocation(_program, TRANSFORM_LOCATION, "transform");
+   glLinkProgram(_program);
+   glDeleteShader(shader); // Goes when the program does.
+   GLint linked;
+   glGetProgramiv(_program, GL_LINK_STATUS, &linked);
+
+   if(!compiled || !linked)
+   {
+      DBG(cout << "Mesh_Cache: the instancing shader does not "
+               << (compiled ? "link" : "compile") << endl);
+      glDeleteProgram(_program);
+      _program = 0;
+      return false;
+   }
+
+   glGenBuffers(1, &_instance_buffer);
+   _instancing = 1;
+   DBG(cout << "Mesh_Cache: using instancing" << endl);
+   return true;
+#else
+   return false;
+#endif
+}
+
+bool Mesh_Cache::instancing()
+{
+   return _mode == BUFFERS && _instancing_enabled && prepare_instancing();
+}
+
+void Mesh_Cache::set_instancing(bool enabled)
+{
+   _instancing_enabled = enabled;
+}
+
+bool Mesh_Cache::draw_instanced(Primitive_Store::Type type, int precision,
+                                const GLfloat *transforms, unsigned int count)
+{
+   if(!instancing())
+      return false;
+#ifdef GL_VERSION_3_3
+   Mesh &mesh = const_cast<Mesh &>(get(type, precision));
+   if(!upload(mesh))
+      return false;
+   _drawn += count * (mesh.vertices.size() / 3);
+   _triangles_drawn += count * (mesh.triangles.size() / 3);
+
+   // Multiply the matrices together here, in the order that
+   // glMultMatrixf() and the fixed pipeline use, so that every copy gets
+   // the same depth as draw() gives it. The depth passes compare these
+   // depths with those of primitives drawn with draw(), and the vertices
+   // decide which pixels along the edges are covered.
+   Matrix modelview, projection;
+   glGetFloatv(GL_MODELVIEW_MATRIX, modelview.data);
+   glGetFloatv(GL_PROJECTION_MATRIX, projection.data);
+   static vector<GLfloat> clip;
+   clip.resize(16 * count);
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      Matrix m = projection * (modelview * Matrix(transforms + 16 * i));
+      copy(m.data, m.data + 16, clip.begin() + 16 * i);
+   }
+
+   // The pointers are offsets into the bound buffers.
+   const char *start = NULL;
+   const GLsizei stride = 16 * sizeof(GLfloat);
+   glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+   glBufferData(GL_ARRAY_BUFFER, count * stride, &clip[0], GL_STREAM_DRAW);
+   for(GLuint column = 0; column < 4; ++column)
+   {
+      GLuint location = TRANSFORM_LOCATION + column;
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                            start + column * 4 * sizeof(GLfloat));
+      glVertexAttribDivisor(location, 1);
+   }
+
+   glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3, GL_FLOAT, 0, start);
+
+   glUseProgram(_program);
+   glDrawElementsInstanced(GL_TRIANGLES, mesh.triangles.size(),
+                           GL_UNSIGNED_INT, start, count);
+   glUseProgram(0);
+
+   glDisableClientState(GL_VERTEX_ARRAY);
+   for(GLuint column = 0; column < 4; ++column)
+   {
+      glVertexAttribDivisor(TRANSFORM_LOCATION + column, 0);
+      glDisableVertexAttribArray(TRANSFORM_LOCATION + column);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   return true;
+#else
+   return false;
+#endif
+}
+
+void Mesh_Cache::set_mode(Mode mode)
+{
+   _mode = mode;
+}
+
+Mesh_Cache::Mode Mesh_Cache::get_mode() const
+{
+   return _mode;
+}
+
+void Mesh_Cache::set_optimize(bool optimize)
+{
+   _optimize = optimize;
+}
+
+bool Mesh_Cache::get_optimize() const
+{
+   return _optimize;
+}
+
+void Mesh_Cache::clear()
+{
+#ifdef GL_VERSION_1_5
+   map<pair<int, int>, Mesh>::iterator i;
+   for(i = _meshes.begin(); i != _meshes.end(); ++i)
+      if(i->second.vertex_buffer)
+      {
+         GLuint buffers[2] = { i->second.vertex_buffer, i->second.index_buffer };
+         glDeleteBuffers(2, buffers);
+      }
+#endif
+   _meshes.clear();
+}
+
+unsigned int Mesh_Cache::size() const
+{
+   return _meshes.size();
+}
+
+unsigned long Mesh_Cache::drawn() const
+{
+   return _drawn;
+}
+
+unsigned long Mesh_Cache::triangles_drawn() const
+{
+   return _triangles_drawn;
+}
+
+void Mesh_Cache::reset_drawn()
+{
+   _drawn = _triangles_drawn = 0;
+}
+
+Mesh_Cache &mesh_cache()
+{
+   static Mesh_Cache *cache = new Mesh_Cache;
+   return *cache;
+}
@@ -0,0 +1,174 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file mesh_cache.h
+ * One shared triangle mesh per primitive type and precision.
+ */
+
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <GL/gl.h>
+#include "primitive_store.h"
+
+/*!
+ * The unit shapes of the primitives as indexed triangle meshes, built once
+ * per type and precision and shared by every object that is drawn with
+ * them. The transformation of the object is applied by the caller, with
+ * glMultMatrixf(), before draw().
+ *
+ * The triangles of every mesh are ordered for the post-transform vertex
+ * cache of the graphics card, so that most vertices are only transformed
+ * once even though every triangle lists its own.
+ *
+ * Where OpenGL 1.5 is available, every mesh is uploaded into buffer
+ * objects the first time it is drawn, so drawing it again only sends the
+ * draw call. Otherwise the meshes are drawn from vertex arrays in client
+ * memory.
+ *
+ * Where OpenGL 3.3 is available, draw_instanced() also draws many copies
+ * of a mesh with one call, with their transformations in a buffer object
+ * and applied by a small vertex shader.
+ */
+class Mesh_Cache
+{
+public:
+   //! How the meshes are sent to OpenGL.
+   enum Mode
+   {
+      BUFFERS,  //!< From buffer objects, falling back to ARRAYS without them.
+      ARRAYS,   //!< From vertex arrays in client memory.
+      IMMEDIATE //!< One vertex at a time, like the GLUT shapes. For comparison.
+   };
+
+   //! A unit shape, with the vertices of every face in their own places.
+   struct Mesh
+   {
+      std::vector<GLfloat> vertices; //!< x, y and z of every vertex.
+      std::vector<GLfloat> normals;  //!< Unit normal of every vertex.
+      //! Three vertices per triangle, counterclockwise seen from outside.
+      std::vector<GLuint> triangles;
+      std::vector<GLuint> lines;     //!< Two vertices per wireframe line.
+      GLuint vertex_buffer; //!< Vertices and then normals, or 0 if not uploaded.
+      GLuint index_buffer;  //!< Triangles and then lines, or 0 if not uploaded.
+   };
+
+   Mesh_Cache();
+
+   /*!
+    * The mesh of a type at a precision, built if it is not in the cache.
+    * Does not need OpenGL. The precision of a cube makes no difference.
+    */
+   const Mesh &get(Primitive_Store::Type type, int precision);
+
+   //! Draws a mesh, as triangles or as a wireframe, in the current color.
+   void draw(Primitive_Store::Type type, int precision, bool wire = false);
+
+   /*!
+    * Draws count copies of a mesh as triangles with one call. Copy i is
+    * transformed by the column-major matrix at transforms + 16 * i, and
+    * then by the current modelview and projection matrices, to the same
+    * depth as glMultMatrixf() and draw() would give it. The shader
+    * does no lighting, so this is meant for passes that only write depth
+    * and stencil.
+    *
+    * \return false, without drawing anything, if instancing() is false.
+    */
+   bool draw_instanced(Primitive_Store::Type type, int precision,
+                       const GLfloat *transforms, unsigned int count);
+
+   /*!
+    * True if draw_instanced() can draw: the mode is BUFFERS, instancing
+    * has not been turned off, and OpenGL 3.3 is available. Needs a context.
+    */
+   bool instancing();
+
+   //! Turns draw_instanced() off, or on again where it is available.
+   void set_instancing(bool enabled);
+
+   void set_mode(Mode mode);
+   Mode get_mode() const;
+
+   /*!
+    * Whether meshes built from now on are ordered for the vertex cache, as
+    * they are by default, or left in the order they are built in. Call
+    * clear() to build the meshes again.
+    */
+   void set_optimize(bool optimize);
+   bool get_optimize() const;
+
+   //! Forgets all meshes, and deletes their buffer objects.
+   void clear();
+
+   //! Number of meshes in the cache.
+   unsigned int size() const;
+
+   //! Mesh vertices drawn since the last reset_drawn(), once per copy.
+   unsigned long drawn() const;
+   //! Triangles drawn since the last reset_drawn(), once per copy.
+   unsigned long triangles_drawn() const;
+   void reset_drawn();
+
+private:
+   Mesh_Cache(const Mesh_Cache &);
+   void operator=(const Mesh_Cache &);
+
+   bool upload(Mesh &mesh);
+   bool prepare_instancing();
+
+   std::map<std::pair<int, int>, Mesh> _meshes;
+   Mode _mode;
+   int _buffers;    //!< 1 if buffer objects work, 0 if not, -1 if not checked yet.
+   int _instancing; //!< 1 if the instancing shader works, 0 if not, -1 if not checked yet.
+   bool _instancing_enabled;
+   GLuint _program;         //!< The instancing shader.
+   GLuint _instance_buffer; //!< The transformations for draw_instanced().
+   bool _optimize;
+   unsigned long _drawn;
+   unsigned long _triangles_drawn;
+};
+
+//! The cache that all objects draw themselves from.
+Mesh_Cache &mesh_cache();
+
+/*!
+ * The average cache miss ratio of a list of triangles: the vertices per
+ * triangle that a FIFO post-transform cache of cache_size vertices does
+ * not have, and has to transform.
+ */
+double cache_miss_ratio(const std::vector<GLuint> &triangles,
+                        unsigned int cache_size);
+
+/*!
+ * The OpenGL version of the current context as major * 10 + minor, or -1
+ * if there is no context.
+ */
+int gl_version();
+
+#endif
@@ -29,6 +29,7 @@
  */
 
 #include <list>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
@@ -38,6 +39,7 @@
 #include <GL/glut.h>
 
 #include "csg_tree.h"
+#include "csg_visitor.h"
 #include "csg_object.h"
 #include "renderer_interface.h"
 #include "debug.h"
@@ -46,11 +48,20 @@
 #include "camera.h"
 #include "persistence.h"
 #include "normalize.h"
+#include "product_stream.h"
+#include "components.h"
+#include "csg_history.h"
+#include "primitive_registry.h"
+#include "overlap_graph.h"
+#include "mesh_cache.h"
+#include "level_of_detail.h"
+#include "impostor.h"
 
 using namespace std;
 using std::list;
 
 int render_partial = -1;
+RenderType render_type = RENDER_CSG;
 
 /*!
  * Holds the state of the mouse (pointer coords and button states).
@@ -94,47 +105,65 @@ CSG_Node::CSG_Type operation_type = CSG_Node::UNION;
 bool negative_visibility=true;
 bool affect_camera=true;  //!< Do we want to rotate the camera or the object.
 
-list<CSG_Object *> objects;   //!< All objects in the scene.
+//! All objects in the scene, and the deleted ones that undo can bring back.
+Primitive_Registry objects;
 CSG_Node *root = NULL;        //!< The root of our all-encompassing CSG tree.
-CSG_Node *normal_root = NULL; //!< The root of the normalized CSG tree.
+Incremental_Normalizer normalizer(true); //!< Remembers the normalized form of root.
+Normal_Cache normal_cache; //!< Normalized trees from earlier sessions, too.
+Component_Set components(normalizer); //!< root, in separately pruned parts.
+CSG_History history; //!< Earlier and later versions of root.
+Overlap_Graph overlap_graph; //!< Which objects in root overlap which.
+
+//! Normalized trees with more products than this are never built.
+//! The renderer gets a stream of products from the unnormalized tree instead.
+const double MAX_NORMAL_PRODUCTS = 100000;
+bool stream_products = false; //!< True if root is too large to normalize.
+
+int benchmark_frame = -1; //!< Frames drawn with --benchmark, or -1 without it.
+int benchmark_start;      //!< GLUT time when the first timed frame began.
 
 void translate_along_screen(CSG_Object *o, int mouse_x, int mouse_y, int center_x, int center_y);
 void put_along_screen(CSG_Object *o, int mouse_x, int mouse_y, int center_x, int center_y);
 
+void benchmark_step();
+
 void rebuild_normal_tree()
 {
    DBG(cout << "rebuild_normal_tree" << endl);
-   delete normal_root;
-   normal_root = normalize(root);
-   DBG(cout << "rebuild_normal_tree done" << endl);
-}
-
-CSG_Node *find_primitive(CSG_Node *tree, CSG_Object *object)
-{
-   if (tree->get_type() == CSG_Node::PRIMITIVE)
-   {
-      if (tree->get_object() == object)
-         return tree;
-      else
-         return NULL;
-   }
+   components.clear();
+
+   vector<CSG_Object *> placed;
+   for (Primitive_Registry::Handle h = 0; h < objects.size(); ++h)
+      if (objects.get_node(h))
+         placed.push_back(objects.get_object(h));
+   overlap_graph.assign(placed);
+
+   Product_Stream stream(root);
+   stream_products = stream.estimate() > MAX_NORMAL_PRODUCTS;
+   if(stream_products)
+      cout << "The normalized tree would have " << stream.estimate()
+           << " products, streaming them instead" << endl;
    else
-   {
-      CSG_Node *n = find_primitive(tree->get_left(), object);
-      if (n) return n;
-      return find_primitive(tree->get_right(), object);
-   }
+      components.assign(root);
+   DBG(cout << "rebuild_normal_tree done" << endl);
 }
 
 CSG_Node *delete_primitive(CSG_Node *tree, CSG_Object *object)
 {
    DBG(cout << "delete_primitive" << endl);
    assert(!tree->get_parent());
-   CSG_Node *p = find_primitive(tree, object);
-   assert(p);
+   Primitive_Registry::Handle handle;
+   if (!objects.find(object, handle) || !objects.get_node(handle))
+   {
+      assert(!"The object is not in the tree");
+      return tree;
+   }
+   CSG_Node *p = objects.get_node(handle);
 
-   objects.remove(object);
-   delete object;
+   normalizer.invalidate(p);
+   history.invalidate(p);
+   // The object stays in objects, since undo can bring it back.
+   objects.set_node(handle, NULL);
 
    if (!p->get_parent())
    {
@@ -164,6 +193,21 @@ CSG_Node *delete_primitive(CSG_Node *tree, CSG_Object *object)
    }
 }
 
+/*!
+ * Replaces root with another version of it from the history.
+ */
+void replace_root(CSG_Node *tree)
+{
+   normalizer.forget(root);
+   delete root;
+   root = tree;
+   objects.assign(root);
+   mouse.last_node = mouse.selected_node = mouse.current_node = NULL;
+
+   rebuild_normal_tree();
+   glutPostRedisplay();
+}
+
 /*!
  * GLUT display callback.
  */
@@ -183,14 +227,37 @@ void display()
    glMultMatrixf(camera.rotation_matrix.data);
 
    glTranslatef(-camera.center_x, -camera.center_y, -camera.center_z);
+
+   if(level_of_detail().enabled())
+   {
+      vector<CSG_Object *> placed;
+      for(Primitive_Registry::Handle h = 0; h < objects.size(); ++h)
+         if(objects.get_node(h))
+            placed.push_back(objects.get_object(h));
+      GLfloat view[16], projection[16];
+      glGetFloatv(GL_MODELVIEW_MATRIX, view);
+      glGetFloatv(GL_PROJECTION_MATRIX, projection);
+      level_of_detail().update(placed, Matrix(view),
+                               projection[5] * y_resolution / 2);
+   }
    
    mouse.current_node=NULL;
 
-   if(normal_root)
+   if(root)
    {
-      mouse.current_node = const_cast<CSG_Node *>
-         (prerender(normal_root, mouse.x, mouse.y, negative_visibility)); 
-      render(normal_root);
+      const CSG_Node *picked;
+      if(stream_products)
+      {
+         Product_Stream stream(root);
+         picked = prerender(root, stream, mouse.x, mouse.y, negative_visibility);
+      }
+      else
+         // The components are pruned again when something in them moves.
+         picked = prerender(root, components.get_products(), mouse.x, mouse.y,
+                            negative_visibility);
+      if (picked)
+         mouse.current_node = objects.find_node(picked->get_object());
+      render(root);
       if (mouse.selected_node)
          mouse.selected_node->get_object()->render_highlight(1, 0, 0);
       if (mouse.current_node && !mouse.selected_node)
@@ -202,6 +269,9 @@ void display()
    }
 
    glutSwapBuffers();
+
+   if(benchmark_frame >= 0)
+      benchmark_step();
 }
 
 /*!
@@ -240,18 +310,11 @@ void cleanup()
 
    DBG(cout << "   Destructing the tree recursively from the root" << endl);
    delete root;
-   DBG(cout << "   Destructing the normal tree recursively from the root" << endl);
-   delete normal_root;
+   DBG(cout << "   Destructing the normalized components" << endl);
+   components.clear();
+   overlap_graph.clear();
    DBG(cout << "   Desctructing primitives" << endl);
-
-   CSG_Object *ob;
-   while(!objects.empty())
-   {
-      ob = objects.front();
-      objects.pop_front();
-      DBG(cout << "Deleting " << ob->get_name() << endl);
-      delete ob;
-   }
+   objects.clear();
 
    DBG(cout << endl);
    DBG(cout << "All done, bye bye" << endl);
@@ -312,9 +375,8 @@ void add_object(CSG_Node* attach_to, CSG_Node::CSG_Type operation_type,
    }
    
    put_along_screen(object, mouse_x, mouse_y, x_resolution/2, y_resolution/2);
-   objects.push_front(object);
-
    CSG_Node *node = new CSG_Node(object);
+   objects.add(object, node);
 
    if(!attach_to)
    {
@@ -324,6 +386,7 @@ void add_object(CSG_Node* attach_to, CSG_Node::CSG_Type operation_type,
    {
       root = CSG_Node::create_and_insert(operation_type, attach_to, node);
    }
+   history.record(root);
 
    rebuild_normal_tree();
 
@@ -348,6 +411,8 @@ void translate_along_screen(CSG_Object *object, int mouse_x, int mouse_y, int ce
    Matrix pose  = cam.transpose();
    Matrix late  = translate(dx, dy, 0);
    object->set_transform(pose * late * cam * form);
+   components.moved(object);
+   overlap_graph.moved(object);
 }
 
 /*!
@@ -387,6 +452,76 @@ void scale_object(GLfloat s)
   else return;
     
   object->set_transform(object->get_transform() * scale(s, s, s));
+  components.moved(object);
+  overlap_graph.moved(object);
+}
+
+/*!
+ * Replaces the scene with the one in a file, and its normalization cache.
+ * Leaves an empty scene if the file can not be loaded.
+ */
+void load_scene(const string &filename)
+{
+   normalizer.reset();
+   delete root;
+   overlap_graph.clear();
+   objects.clear();
+
+   list<CSG_Object *> loaded;
+   root = load(filename, loaded, camera);
+   if(!root)
+      cout << "Load failed!" << endl;
+   objects.assign(root);
+   history.clear(root);
+
+   normal_cache.clear();
+   normal_cache.load(filename + ".cache");
+   rebuild_normal_tree();
+   cout << "Normalization cache: " << normal_cache.hits() << " hits, "
+        << normal_cache.misses() << " misses, saved "
+        << normal_cache.saved_ms() - normal_cache.lookup_ms()
+        << " ms" << endl;
+}
+
+/*!
+ * Called after every frame with --benchmark. Turns the camera a little and
+ * asks for the next frame, until BENCHMARK_FRAMES frames have been timed
+ * after the first BENCHMARK_WARMUP ones. Then prints the time per frame and
+ * exits.
+ */
+void benchmark_step()
+{
+   if(benchmark_frame == BENCHMARK_WARMUP)
+   {
+      glFinish();
+      benchmark_start = glutGet(GLUT_ELAPSED_TIME);
+      mesh_cache().reset_drawn();
+   }
+   else if(benchmark_frame == BENCHMARK_WARMUP + BENCHMARK_FRAMES)
+   {
+      glFinish();
+      int ms = glutGet(GLUT_ELAPSED_TIME) - benchmark_start;
+      static const char *mode[] = { "buffer objects", "vertex arrays",
+                                    "immediate mode" };
+      cout << BENCHMARK_FRAMES << " frames in " << ms << " ms, "
+           << double(ms) / BENCHMARK_FRAMES << " ms per frame, meshes from "
+           << mode[mesh_cache().get_mode()]
+           << (impostors().available() ? ", spheres and cylinders ray-cast" :
+               mesh_cache().instancing() ? ", instanced" : "") << endl;
+      cout << mesh_cache().drawn() / BENCHMARK_FRAMES << " mesh vertices and "
+           << mesh_cache().triangles_drawn() / BENCHMARK_FRAMES
+           << " triangles drawn per frame, level of detail "
+           << (level_of_detail().enabled() ? "on" : "off") << endl;
+      cout << mesh_cache().triangles_drawn() / (ms * 1000.0)
+           << " million triangles per second, "
+           << (mesh_cache().get_optimize() ? "ordered" : "not ordered")
+           << " for the vertex cache" << endl;
+      exit(0);
+   }
+
+   ++benchmark_frame;
+   camera.rotation_matrix = rotate_y(BENCHMARK_TURN) * camera.rotation_matrix;
+   glutPostRedisplay();
 }
 
 /*!
@@ -397,23 +532,23 @@ void keypress(unsigned char key, int mouse_x, int mouse_y)
    switch(key)
    {
       case '1':
-         set_render_type(RENDER_CSG);
+         set_render_type(render_type = RENDER_CSG);
          glutPostRedisplay();
          break;
       case '2':
-         set_render_type(RENDER_CSG_Z);
+         set_render_type(render_type = RENDER_CSG_Z);
          glutPostRedisplay();
          break;
       case '3':
-         set_render_type(RENDER_NO_CSG);
+         set_render_type(render_type = RENDER_NO_CSG);
          glutPostRedisplay();
          break;
       case '4':
-         set_render_type(RENDER_NO_CSG_Z);
+         set_render_type(render_type = RENDER_NO_CSG_Z);
          glutPostRedisplay();
          break;
       case '5':
-         set_render_type(RENDER_CSG_SPLIT_SCREEN);
+         set_render_type(render_type = RENDER_CSG_SPLIT_SCREEN);
          glutPostRedisplay();
          break;
       case SAVE_KEY:
@@ -422,27 +557,15 @@ void keypress(unsigned char key, int mouse_x, int mouse_y)
          cout << "Filename: ";
          getline(cin, filename);
          save(filename, root, camera);
+         normal_cache.save(filename + ".cache");
          break;
       }
       case LOAD_KEY:
       {
-         delete root;
-         CSG_Object *ob;
-         while(!objects.empty())
-         {
-            ob = objects.front();
-            objects.pop_front();
-            DBG(cout << "Deleting " << ob->get_name() << endl);
-            delete ob;
-         }
-
          string filename;
          cout << "Filename: ";
          getline(cin, filename);
-         root = load(filename, objects, camera);
-         if(!root)
-            cout << "Load failed!" << endl;
-         rebuild_normal_tree();
+         load_scene(filename);
          break;
       }
       case '/':
@@ -503,10 +626,25 @@ void keypress(unsigned char key, int mouse_x, int mouse_y)
 	 if(mouse.current_node)
          {
             root = delete_primitive(root, mouse.current_node->get_object());
+            history.record(root);
             rebuild_normal_tree();
             glutPostRedisplay();
 	 }
 	 break;
+      case UNDO_KEY:
+      {
+         CSG_Node *tree;
+         if(history.undo(tree))
+            replace_root(tree);
+         break;
+      }
+      case REDO_KEY:
+      {
+         CSG_Node *tree;
+         if(history.redo(tree))
+            replace_root(tree);
+         break;
+      }
       case CENTER_KEY:
          if (mouse.current_node)
          {
@@ -522,6 +660,17 @@ void keypress(unsigned char key, int mouse_x, int mouse_y)
      affect_camera = !affect_camera;
      //no need to redisplay
      break;
+   case TOGGLE_LEVEL_OF_DETAIL:
+     level_of_detail().set_enabled(!level_of_detail().enabled());
+     cout << "Level of detail " << (level_of_detail().enabled() ? "on" : "off")
+          << endl;
+     glutPostRedisplay();
+     break;
+   case TOGGLE_IMPOSTORS:
+     impostors().set_enabled(!impostors().enabled());
+     cout << "Impostors " << (impostors().available() ? "on" : "off") << endl;
+     glutPostRedisplay();
+     break;
    default:
          break;
    }
@@ -597,6 +746,8 @@ void poll_mouse_button(int )
 	  update_matrix(m);
 	  m = translate(v.data[0], v.data[1], v.data[2]) * m;
 	  mouse.last_node->get_object()->set_transform(m);
+	  components.moved(mouse.last_node->get_object());
+	  overlap_graph.moved(mouse.last_node->get_object());
 	  glutPostRedisplay(); 
 	}
     }	
@@ -608,15 +759,60 @@ void poll_mouse_button(int )
 int main(int argc, char **argv)
 {
    atexit(cleanup);
+   normalizer.set_cache(&normal_cache);
+   set_overlap_graph(&overlap_graph);
 
    glutInit(&argc, argv);
+
+   bool fullscreen = false;
+   string benchmark_file;
+   for(int i = 1; i < argc; ++i)
+   {
+      string arg = argv[i];
+      if(arg == "--fullscreen" || arg == "-f")
+         fullscreen = true;
+      else if(arg.compare(0, 12, "--benchmark=") == 0)
+         benchmark_file = arg.substr(12);
+      else if(arg == "--arrays")
+         mesh_cache().set_mode(Mesh_Cache::ARRAYS);
+      else if(arg == "--immediate")
+         mesh_cache().set_mode(Mesh_Cache::IMMEDIATE);
+      else if(arg == "--no-instancing")
+         mesh_cache().set_instancing(false);
+      else if(arg == "--lod")
+         level_of_detail().set_enabled(true);
+      else if(arg.compare(0, 16, "--lod-tolerance=") == 0 &&
+              atof(arg.c_str() + 16) > 0)
+      {
+         level_of_detail().set_tolerance(atof(arg.c_str() + 16));
+         level_of_detail().set_enabled(true);
+      }
+      else if(arg.compare(0, 16, "--vertex-budget=") == 0)
+      {
+         level_of_detail().set_vertex_budget(atol(arg.c_str() + 16));
+         level_of_detail().set_enabled(true);
+      }
+      else if(arg == "--impostors")
+         impostors().set_enabled(true);
+      else if(arg == "--unoptimized")
+         mesh_cache().set_optimize(false);
+      else
+      {
+         cout << "Usage: " << argv[0] << " [--fullscreen] "
+              << "[--benchmark=FILE] [--arrays | --immediate] "
+              << "[--no-instancing] [--lod] [--lod-tolerance=PX] "
+              << "[--vertex-budget=N] [--impostors] [--unoptimized]"
+              << endl;
+         return 1;
+      }
+   }
+
    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | GLUT_STENCIL);
    glutInitWindowSize(x_resolution, y_resolution);
    glutInitWindowPosition(0, 0);
    glutCreateWindow("Solid Cheese - Modeler");
 
-   if(argc > 1 && (string(argv[1]) == "--fullscreen" ||
-                   string(argv[1]) == "-f"))
+   if(fullscreen)
       glutFullScreen();
 
    glutDisplayFunc(display);
@@ -666,6 +862,14 @@ int main(int argc, char **argv)
    //glEnable(GL_POLYGON_OFFSET_LINE);
    //glPolygonOffset(10, 10);
 
+   if(!benchmark_file.empty())
+   {
+      load_scene(benchmark_file);
+      if(!root)
+         return 1;
+      benchmark_frame = 0;
+   }
+
    glutMainLoop();
 
    //Just to make GCC happy. We'll never get here, since glutMainLoop()
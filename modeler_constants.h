@@ -47,12 +47,20 @@ const char DELETE_OBJECT_KEY          = 'z';
 const char CENTER_KEY                 = ' ';
 const char TOGGLE_NEGATIVE_VISIBILITY = 'n';
 const char TOGGLE_CAMERA_OR_OBJECT    = 'h';
+const char UNDO_KEY                   = 'a';
+const char REDO_KEY                   = 'g';
+const char TOGGLE_LEVEL_OF_DETAIL     = 'd';
+const char TOGGLE_IMPOSTORS           = 'y';
 
 const unsigned int CHECKMOUSE_INTERVAL = 50;
 const GLfloat TURNSPEED                = 0.001314;
 const GLfloat SPEED                    = 0.5;
 const GLfloat DEFAULT_RADIUS           = 4;
 
+const int BENCHMARK_WARMUP             = 10;  //!< Frames not timed by --benchmark.
+const int BENCHMARK_FRAMES             = 100; //!< Frames timed by --benchmark.
+const GLfloat BENCHMARK_TURN           = 0.02; //!< Radians per frame.
+
 extern int x_resolution;
 extern int y_resolution;
 
@@ -0,0 +1,282 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file normal_cache.cpp
+ * Implementation of the normalization cache.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+#include "debug.h"
+#include "csg_visitor.h"
+#include "normal_cache.h"
+
+using namespace std;
+
+static const char *HEADER = "Solid Cheese normalization cache";
+static const int VERSION = 2;
+
+//! Returns the number of milliseconds of CPU time used since start.
+static double ms_since(clock_t start)
+{
+   return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+//! Lists the primitives of a tree from left to right.
+struct Leaf_Finder : public CSG_Visitor<const CSG_Node>
+{
+   void leave(const CSG_Node *tree)
+   {
+      if(tree->get_type() == CSG_Node::PRIMITIVE)
+         leaves.push_back(tree->get_object());
+   }
+
+   vector<CSG_Object *> leaves;
+};
+
+static void find_leaves(const CSG_Node *tree, vector<CSG_Object *> &leaves)
+{
+   Leaf_Finder finder;
+   visit_tree(tree, finder);
+   leaves.swap(finder.leaves);
+}
+
+//! Writes a node in RPN, with every primitive replaced by its leaf number.
+struct Normal_Writer : public CSG_Visitor<const CSG_Dag_Node>
+{
+   Normal_Writer(const map<CSG_Object *, unsigned int> &leaf,
+                 ostringstream &out) :
+      leaf(leaf), out(out)
+   {
+   }
+
+   void leave(const CSG_Dag_Node *node)
+   {
+      switch(node->get_type())
+      {
+         case CSG_Node::PRIMITIVE:
+            out << leaf.find(node->get_object())->second << " ";
+            break;
+         case CSG_Node::UNION:
+            out << "+ ";
+            break;
+         case CSG_Node::INTERSECTION:
+            out << "* ";
+            break;
+         case CSG_Node::DIFFERENCE:
+            out << "- ";
+            break;
+      }
+   }
+
+   const map<CSG_Object *, unsigned int> &leaf;
+   ostringstream &out;
+};
+
+static void write_normal(const CSG_Dag_Node *node,
+                         const map<CSG_Object *, unsigned int> &leaf,
+                         ostringstream &out)
+{
+   Normal_Writer writer(leaf, out);
+   visit_tree(node, writer);
+}
+
+Normal_Cache::Normal_Cache() :
+   _hits(0), _misses(0), _saved_ms(0), _lookup_ms(0)
+{
+}
+
+const CSG_Dag_Node *Normal_Cache::find(CSG_Dag &dag, const CSG_Node *tree,
+                                       unsigned long hash, unsigned long check)
+{
+   clock_t start = clock();
+
+   map<unsigned long, Entry>::iterator i = _entries.find(hash);
+   if(i != _entries.end() && i->second.check != check)
+   {
+      DBG(cout << "Normal_Cache::find: hash " << hash << " collides" << endl);
+      i = _entries.end();
+   }
+   vector<CSG_Object *> leaves;
+   if(i != _entries.end())
+      find_leaves(tree, leaves);
+
+   vector<const CSG_Dag_Node *> stack;
+   if(i != _entries.end() && i->second.leaves == leaves.size())
+   {
+      istringstream in(i->second.normal);
+      string token;
+      while(in >> token)
+      {
+         CSG_Node::CSG_Type type;
+         if(token == "+")
+            type = CSG_Node::UNION;
+         else if(token == "*")
+            type = CSG_Node::INTERSECTION;
+         else if(token == "-")
+            type = CSG_Node::DIFFERENCE;
+         else
+         {
+            unsigned int leaf = atoi(token.c_str());
+            if(leaf >= leaves.size())
+               break;
+            stack.push_back(dag.primitive(leaves[leaf]));
+            continue;
+         }
+
+         if(stack.size() < 2)
+            break;
+         const CSG_Dag_Node *right = stack.back();
+         stack.pop_back();
+         stack.back() = dag.operation(type, stack.back(), right);
+      }
+      if(in) // Stopped at a bad token.
+         stack.clear();
+   }
+
+   const CSG_Dag_Node *result = NULL;
+   if(stack.size() == 1)
+   {
+      result = stack.back();
+      _hits++;
+      _saved_ms += i->second.ms;
+      i->second.used = true;
+   }
+   else
+      _misses++;
+
+   _lookup_ms += ms_since(start);
+   return result;
+}
+
+void Normal_Cache::insert(unsigned long hash, unsigned long check,
+                          const CSG_Node *tree, const CSG_Dag_Node *normal,
+                          double ms)
+{
+   clock_t start = clock();
+
+   vector<CSG_Object *> leaves;
+   find_leaves(tree, leaves);
+   map<CSG_Object *, unsigned int> leaf;
+   for(unsigned int i = leaves.size(); i-- > 0;)
+      leaf[leaves[i]] = i;
+
+   Entry &entry = _entries[hash];
+   entry.check = check;
+   entry.leaves = leaves.size();
+   entry.ms = ms;
+   entry.used = true;
+
+   ostringstream out;
+   write_normal(normal, leaf, out);
+   entry.normal = out.str();
+
+   _lookup_ms += ms_since(start);
+}
+
+bool Normal_Cache::load(const string &filename)
+{
+   ifstream file(filename.c_str(), ios::in);
+   if(!file)
+      return true;
+
+   string s;
+   int version;
+   getline(file, s);
+   if(s != HEADER || !(file >> s >> version) || s != "Version" ||
+      version != VERSION)
+   {
+      cout << "\"" << filename << "\" is not a normalization cache that we "
+           << "can read" << endl;
+      return false;
+   }
+
+   unsigned long hash;
+   Entry entry;
+   entry.used = false;
+   while(file >> hash >> entry.check >> entry.leaves >> entry.ms &&
+         getline(file, entry.normal))
+      _entries[hash] = entry;
+
+   DBG(cout << "Normal_Cache::load: " << _entries.size() << " entries" << endl);
+   return true;
+}
+
+bool Normal_Cache::save(const string &filename)
+{
+   ofstream file(filename.c_str(), ios::out | ios::trunc);
+   if(!file)
+   {
+      cout << "Unable to open \"" << filename << "\" for writing" << endl;
+      return false;
+   }
+
+   file << HEADER << endl << "Version " << VERSION << endl;
+   map<unsigned long, Entry>::const_iterator i;
+   for(i = _entries.begin(); i != _entries.end(); ++i)
+      if(i->second.used)
+         file << i->first << " " << i->second.check << " "
+              << i->second.leaves << " " << i->second.ms
+              << " " << i->second.normal << endl;
+
+   return file.good();
+}
+
+void Normal_Cache::clear()
+{
+   _entries.clear();
+   _hits = _misses = 0;
+   _saved_ms = _lookup_ms = 0;
+}
+
+unsigned long Normal_Cache::size() const
+{
+   return _entries.size();
+}
+
+unsigned long Normal_Cache::hits() const
+{
+   return _hits;
+}
+
+unsigned long Normal_Cache::misses() const
+{
+   return _misses;
+}
+
+double Normal_Cache::saved_ms() const
+{
+   return _saved_ms;
+}
+
+double Normal_Cache::lookup_ms() const
+{
+   return _lookup_ms;
+}
@@ -0,0 +1,130 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file normal_cache.h
+ * Remembers normalized trees between edits and between sessions.
+ */
+
+#ifndef __NORMAL_CACHE_H__
+#define __NORMAL_CACHE_H__
+
+#include <string>
+#include <map>
+#include "csg_tree.h"
+#include "csg_dag.h"
+
+/*!
+ * A table from CSG_Node::structural_hash() to normalized form.
+ *
+ * The normalized forms are stored in RPN, with every primitive replaced by
+ * the number of the leaf it first appears in, counted from the left in the
+ * unnormalized tree. A tree with the same hash can therefore use the entry,
+ * even when its primitives are different objects, such as after the scene
+ * has been loaded again. The table can be saved to and loaded from a file.
+ *
+ * Every entry also keeps a second, independent hash of the tree, and both
+ * must match for the entry to be used. A tree whose hash collides with
+ * another one then misses the cache instead of getting the wrong form.
+ * The same holds for a cache file left next to a scene that has changed.
+ *
+ * The keys are the whole trees that Incremental_Normalizer::normalize() is
+ * given, which are the components of the scene, not their subtrees.
+ */
+class Normal_Cache
+{
+public:
+   Normal_Cache();
+
+   /*!
+    * Builds the normalized form of tree in dag from the table.
+    *
+    * \param hash  The structural hash of tree, possibly mixed with
+    *              anything else the normalized form depends on.
+    * \param check The second hash from CSG_Node::structural_hash().
+    * \return The normalized form, or NULL if it is not in the table.
+    */
+   const CSG_Dag_Node *find(CSG_Dag &dag, const CSG_Node *tree,
+                            unsigned long hash, unsigned long check);
+
+   /*!
+    * Remembers that normal is the normalized form of tree.
+    *
+    * \param ms How many milliseconds it took to normalize tree. A later
+    *           find() of the same tree is counted as saving that much time.
+    */
+   void insert(unsigned long hash, unsigned long check, const CSG_Node *tree,
+               const CSG_Dag_Node *normal, double ms);
+
+   /*!
+    * Adds the entries in a file to the table.
+    *
+    * \return false if the file could not be read. A file that does not
+    *         exist is not an error.
+    */
+   bool load(const std::string &filename);
+
+   /*!
+    * Writes the entries that have been inserted or found since the cache
+    * was created, cleared or loaded to a file, overwriting it.
+    *
+    * \return false if the file could not be written.
+    */
+   bool save(const std::string &filename);
+
+   //! Forgets all entries and statistics.
+   void clear();
+
+   //! Number of entries in the table.
+   unsigned long size() const;
+
+   unsigned long hits() const;
+   unsigned long misses() const;
+   //! Sum of the normalization times of all entries that were found.
+   double saved_ms() const;
+   //! Time spent in find() and insert().
+   double lookup_ms() const;
+
+private:
+   Normal_Cache(const Normal_Cache &);
+   void operator=(const Normal_Cache &);
+
+   struct Entry
+   {
+      unsigned long check; //!< The second hash of the unnormalized tree.
+      unsigned int leaves; //!< Leaves in the unnormalized tree.
+      double ms;           //!< Time it took to normalize.
+      std::string normal;
+      bool used;           //!< Found or inserted since the last load().
+   };
+
+   std::map<unsigned long, Entry> _entries;
+   unsigned long _hits;
+   unsigned long _misses;
+   double _saved_ms;
+   double _lookup_ms;
+};
+
+#endif
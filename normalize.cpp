@@ -29,11 +29,17 @@
  */
 
 #include "csg_tree.h"
+#include "csg_visitor.h"
 #include "normalize.h"
+#include "restructure.h"
+#include "thread_pool.h"
 
 #include <cassert>
+#include <ctime>
 #include <string>
 #include <stack>
+#include <vector>
+#include <map>
 #include "debug.h"
 #ifdef DEBUG
 #  include <iostream>
@@ -42,12 +48,14 @@
 using namespace std;
 
 int normalize_counter = 0;
+unsigned long normalize_rule_counter[8];
 
 CSG_Node *get_tree(string str)
 {
    stack<CSG_Node*> treeStack;
+   map<char, CSG_Object *> objects; // The same letter is the same object.
    CSG_Node *op1, *op2;
-   CSG_Object_Sphere *ob;
+   CSG_Object *ob;
 
    for(int i = 0; i < (int)str.size(); i++)
    {
@@ -75,8 +83,12 @@ CSG_Node *get_tree(string str)
             treeStack.push(CSG_Node::create_and_insert(CSG_Node::INTERSECTION, op1, op2));
             break;
          default:
-            ob = new CSG_Object_Sphere();
-            ob->set_name(str.substr(i,1));
+            ob = objects[str[i]];
+            if(!ob)
+            {
+               ob = objects[str[i]] = new CSG_Object_Sphere();
+               ob->set_name(str.substr(i,1));
+            }
             treeStack.push(new CSG_Node(ob));
             break;
       }
@@ -85,37 +97,52 @@ CSG_Node *get_tree(string str)
    return treeStack.top();
 }
 
-string get_desc(const CSG_Node *tree)
+//! Builds the string for get_desc().
+struct Desc_Writer : public CSG_Visitor<const CSG_Node>
 {
-   switch(tree->get_type())
-   {
-      case CSG_Node::UNION:
-         return get_desc(tree->get_left())+get_desc(tree->get_right())+"+";
-         break;
-      case CSG_Node::DIFFERENCE:
-         return get_desc(tree->get_left())+get_desc(tree->get_right())+"-";
-         break;
-      case CSG_Node::INTERSECTION:
-         return get_desc(tree->get_left())+get_desc(tree->get_right())+"*";
-         break;
-      case CSG_Node::PRIMITIVE:
-         return tree->get_object()->get_name();
-         break;
-      default:
-         return "The compiler settings are a little too pedantic!";
-         break;
+   void leave(const CSG_Node *tree)
+   {
+      switch(tree->get_type())
+      {
+         case CSG_Node::UNION:
+            desc += "+";
+            break;
+         case CSG_Node::DIFFERENCE:
+            desc += "-";
+            break;
+         case CSG_Node::INTERSECTION:
+            desc += "*";
+            break;
+         case CSG_Node::PRIMITIVE:
+            desc += tree->get_object()->get_name();
+            break;
+         default:
+            desc += "The compiler settings are a little too pedantic!";
+            break;
+      }
    }
+
+   string desc;
+};
+
+string get_desc(const CSG_Node *tree)
+{
+   Desc_Writer writer;
+   visit_tree(tree, writer);
+   return writer.desc;
 }
 
-static void do_stuff(CSG_Node *tree, bool is_left)
+static void do_stuff(CSG_Node *tree, bool is_left, unsigned long *rule_counter)
 {
    DBG(cout << "do_stuff" << endl);
 
+   CSG_Arena *arena = tree->get_arena(); // The copies go where tree is.
+
    // How to write unmaintainable code
    CSG_Node *child = is_left ? tree->get_left() : tree->get_right();
    CSG_Node *other_child = is_left ?
-      new CSG_Node(*tree->get_right())
-      : new CSG_Node(*tree->get_left());
+      new (arena) CSG_Node(*tree->get_right())
+      : new (arena) CSG_Node(*tree->get_left());
 
    CSG_Node::CSG_Type root_type = tree->get_type(),
       child_type = child->get_type();
@@ -127,13 +154,14 @@ static void do_stuff(CSG_Node *tree, bool is_left)
       return;
    }
 
-   CSG_Node *childs_left = new CSG_Node(*child->get_left()),
-      *childs_right = new CSG_Node(*child->get_right());
+   CSG_Node *childs_left = new (arena) CSG_Node(*child->get_left()),
+      *childs_right = new (arena) CSG_Node(*child->get_right());
    
    // A-(B+C) => (A-B)-C
    if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::UNION && !is_left)
    {
       DBG(cout << "Operation 2" << endl);
+      rule_counter[2]++;
 
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
                                                                 other_child,
@@ -144,6 +172,7 @@ static void do_stuff(CSG_Node *tree, bool is_left)
    else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::DIFFERENCE)
    {
       DBG(cout << "Operation 3" << endl);
+      rule_counter[3]++;
 
       tree->set_type(CSG_Node::DIFFERENCE);
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
@@ -155,6 +184,7 @@ static void do_stuff(CSG_Node *tree, bool is_left)
    else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::INTERSECTION && !is_left)
    {
       DBG(cout << "Operation 7" << endl);
+      rule_counter[7]++;
 
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
                                                                 other_child,
@@ -165,6 +195,7 @@ static void do_stuff(CSG_Node *tree, bool is_left)
    else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::UNION)
    {
       DBG(cout << "Operation 1" << endl);
+      rule_counter[1]++;
 
       tree->set_type(CSG_Node::UNION);
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
@@ -172,12 +203,13 @@ static void do_stuff(CSG_Node *tree, bool is_left)
                                                                 other_child));
       tree->delete_and_replace_right(CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
                                                                  childs_right,
-                                                                 new CSG_Node(*other_child)));
+                                                                 new (arena) CSG_Node(*other_child)));
    }
    // (A+B)-C => (A-C)+(B-C)
    else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::UNION && is_left)
    {
       DBG(cout << "Operation 4" << endl);
+      rule_counter[4]++;
 
       tree->set_type(CSG_Node::UNION);
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
@@ -185,32 +217,34 @@ static void do_stuff(CSG_Node *tree, bool is_left)
                                                                 other_child));
       tree->delete_and_replace_right(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
                                                                  childs_right,
-                                                                 new CSG_Node(*other_child)));
+                                                                 new (arena) CSG_Node(*other_child)));
    }
    // A-(B-C) => (A-B)+(A*C)
    else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::DIFFERENCE && !is_left)
    {
       DBG(cout << "Operation 5" << endl);
+      rule_counter[5]++;
 
       tree->set_type(CSG_Node::UNION);
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
                                                                 other_child,
                                                                 childs_left));
       tree->delete_and_replace_right(CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
-                                                                 new CSG_Node(*other_child),
+                                                                 new (arena) CSG_Node(*other_child),
                                                                  childs_right));
    }
    // A-(B*C) => (A-B)+(A-C)
    else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::INTERSECTION && !is_left)
    {
       DBG(cout << "Operation 6" << endl);
+      rule_counter[6]++;
 
       tree->set_type(CSG_Node::UNION);
       tree->delete_and_replace_left(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
                                                                 other_child,
                                                                 childs_left));
       tree->delete_and_replace_right(CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
-                                                                 new CSG_Node(*other_child),
+                                                                 new (arena) CSG_Node(*other_child),
                                                                  childs_right));
    }
    else
@@ -253,38 +287,685 @@ static int get_fixable(const CSG_Node::CSG_Type root_type,
    return 0;
 }
 
+//! How far the normalization of a subtree has come.
+enum Normalize_State
+{
+   NORMALIZE_ENTER,      //!< Not started.
+   NORMALIZE_REWRITE,    //!< The left operand made the node fixable again.
+   NORMALIZE_LEFT_DONE,  //!< The left operand has been normalized.
+   NORMALIZE_RIGHT_DONE  //!< Both operands have been normalized.
+};
+
+static int get_fixable(const CSG_Node *tree)
+{
+   return get_fixable(tree->get_type(), tree->get_left()->get_type(),
+                      tree->get_right()->get_type());
+}
+
+/*
+ * What one thread needs to normalize a subtree. Every thread counts in its
+ * own context, and the counts are added up when it is done, so that the
+ * threads never write to the same counter.
+ */
+struct Normalize_Context
+{
+   int counter;                   //!< Like normalize_counter.
+   unsigned long rule_counter[8]; //!< Like normalize_rule_counter.
+   Thread_Pool *pool;             //!< NULL when normalizing serially.
+   unsigned long cutoff;          //!< Smallest subtree given to another thread.
+   int depth;                     //!< Number of tasks this one is nested in.
+
+   Normalize_Context(Thread_Pool *pool, unsigned long cutoff, int depth) :
+      counter(0), pool(pool), cutoff(cutoff), depth(depth)
+   {
+      for(int i = 0; i < 8; ++i)
+         rule_counter[i] = 0;
+   }
+
+   void add(const Normalize_Context &other)
+   {
+      counter += other.counter;
+      for(int i = 0; i < 8; ++i)
+         rule_counter[i] += other.rule_counter[i];
+   }
+};
+
+/*
+ * A thread that waits for a task may run it itself, inside normalize(), so
+ * nesting tasks without limit could overflow the real stack after all.
+ */
+static const int MAX_TASK_DEPTH = 16;
+
+static void normalize_in_place(CSG_Node *tree, Normalize_Context &context);
+
+//! Normalizes one operand of a union on another thread.
+class Normalize_Task : public Thread_Task
+{
+public:
+   Normalize_Task(CSG_Node *tree, const Normalize_Context &parent) :
+      tree(tree), context(parent.pool, parent.cutoff, parent.depth + 1)
+   {
+   }
+
+   void run()
+   {
+      normalize_in_place(tree, context);
+   }
+
+   CSG_Node *tree;
+   Normalize_Context context;
+};
+
+//! True if the subtree rooted in tree has at least n nodes. Stops counting there.
+static bool has_nodes(const CSG_Node *tree, unsigned long n)
+{
+   vector<const CSG_Node *> stack(1, tree);
+   unsigned long seen = 0;
+   while(!stack.empty())
+   {
+      if(++seen >= n)
+         return true;
+      const CSG_Node *node = stack.back();
+      stack.pop_back();
+      if(node->get_type() != CSG_Node::PRIMITIVE)
+      {
+         stack.push_back(node->get_right());
+         stack.push_back(node->get_left());
+      }
+   }
+   return false;
+}
+
+/*
+ * Starts normalizing the left operand of node on another thread, if node is
+ * a union, there is a pool and both operands are large enough to be worth
+ * it. Nothing else can change the operands of a union, so the threads never
+ * touch the same nodes, and the result is the same as without threads.
+ */
+static Normalize_Task *spawn_left(CSG_Node *node, Normalize_Context &context)
+{
+   if(!context.pool || context.depth >= MAX_TASK_DEPTH ||
+      node->get_type() != CSG_Node::UNION ||
+      !has_nodes(node->get_left(), context.cutoff) ||
+      !has_nodes(node->get_right(), context.cutoff))
+      return NULL;
+
+   Normalize_Task *task = new Normalize_Task(node->get_left(), context);
+   context.pool->submit(task);
+   return task;
+}
+
+//! A subtree being normalized by normalize_in_place().
+struct Normalize_Tree_Frame
+{
+   CSG_Node *node;
+   int state;
+   Normalize_Task *task; //!< Normalizes the left operand, or NULL.
+
+   Normalize_Tree_Frame(CSG_Node *node) :
+      node(node), state(NORMALIZE_ENTER), task(NULL)
+   {
+   }
+};
+
+/*
+ * Normalizes tree in place. The stack holds the subtrees that are being
+ * normalized, from the root down, so that a deep tree can not overflow the
+ * real stack. For every subtree: apply the rules at its root until none
+ * fits, normalize its left operand, start over if that made a rule fit,
+ * and finally normalize its right operand.
+ */
+static void normalize_in_place(CSG_Node *tree, Normalize_Context &context)
+{
+   vector<Normalize_Tree_Frame> stack(1, Normalize_Tree_Frame(tree));
+
+   while(!stack.empty())
+   {
+      Normalize_Tree_Frame &frame = stack.back();
+      CSG_Node *node = frame.node;
+      int side = 0;
+
+      switch(frame.state)
+      {
+         case NORMALIZE_ENTER:
+            context.counter++;
+            DBG(cout << "normalize" << endl);
+            if(node->get_type() == CSG_Node::PRIMITIVE)
+            {
+               stack.pop_back();
+               break;
+            }
+            // Fall through
+         case NORMALIZE_REWRITE:
+            while((side = get_fixable(node)))
+               do_stuff(node, (side == -1), context.rule_counter);
+            frame.state = NORMALIZE_LEFT_DONE;
+            frame.task = spawn_left(node, context);
+            if(!frame.task)
+               stack.push_back(Normalize_Tree_Frame(node->get_left()));
+            break;
+         case NORMALIZE_LEFT_DONE:
+            // Another thread may be changing the left operand, but then
+            // node is a union, which no rule fits anyway.
+            if(!frame.task && get_fixable(node) != 0)
+            {
+               frame.state = NORMALIZE_REWRITE;
+               break;
+            }
+            frame.state = NORMALIZE_RIGHT_DONE;
+            stack.push_back(Normalize_Tree_Frame(node->get_right()));
+            break;
+         default:
+            if(frame.task)
+            {
+               context.pool->wait(frame.task);
+               context.add(frame.task->context);
+               delete frame.task;
+            }
+            DBG(cout << "normalize done" << endl);
+            stack.pop_back();
+            break;
+      }
+   }
+}
+
+//! Adds the counts of a normalization to the global counters.
+static void add_counters(const Normalize_Context &context)
+{
+   normalize_counter += context.counter;
+   for(int i = 0; i < 8; ++i)
+      normalize_rule_counter[i] += context.rule_counter[i];
+}
+
 CSG_Node *normalize(const CSG_Node *tree)
 {
    if(!tree)
       return NULL;
 
-   normalize_counter++;
+   CSG_Node *result_tree = new CSG_Node(*tree);
+   Normalize_Context context(NULL, 0, 0);
+   normalize_in_place(result_tree, context);
+   add_counters(context);
+   return result_tree;
+}
 
-   DBG(cout << "normalize" << endl);
+CSG_Node *normalize_parallel(const CSG_Node *tree, Thread_Pool &pool,
+                             unsigned long cutoff)
+{
+   if(!tree)
+      return NULL;
 
    CSG_Node *result_tree = new CSG_Node(*tree);
+   Normalize_Context context(&pool, cutoff, 0);
+   normalize_in_place(result_tree, context);
+   add_counters(context);
+   return result_tree;
+}
 
-   if(result_tree->get_type() == CSG_Node::PRIMITIVE)
-      return result_tree;
+/*
+ * The DAG normalizer below works on anything that holds expressions which
+ * never change once they are made, through an Expressions class with a
+ * type Node that refers to an expression, and
+ *
+ *    CSG_Node::CSG_Type type(Node node);
+ *    Node left(Node node);
+ *    Node right(Node node);
+ *    Node operation(CSG_Node::CSG_Type type, Node left, Node right);
+ *    bool find_normal(Node node, Node &normal);
+ *    void set_normal(Node node, Node normal);
+ */
 
-   int side = 0;
+//! Expressions in a CSG_Dag.
+struct Dag_Expressions
+{
+   typedef const CSG_Dag_Node *Node;
+
+   explicit Dag_Expressions(CSG_Dag &dag) : dag(dag) {}
+
+   CSG_Node::CSG_Type type(Node node) { return node->get_type(); }
+   Node left(Node node) { return node->get_left(); }
+   Node right(Node node) { return node->get_right(); }
+
+   Node operation(CSG_Node::CSG_Type type, Node left, Node right)
+   {
+      return dag.operation(type, left, right);
+   }
+
+   bool find_normal(Node node, Node &normal)
+   {
+      normal = node->get_normal();
+      return normal != NULL;
+   }
+
+   void set_normal(Node node, Node normal)
+   {
+      dag.set_normal(node, normal);
+   }
+
+   CSG_Dag &dag;
+};
+
+static const unsigned int NO_NORMAL = ~0u;
+
+/*
+ * Expressions in a CSG_Flat_Tree. There is no hash consing, so equal
+ * expressions are only shared when a rule duplicates an operand, but that
+ * is where it matters.
+ */
+struct Flat_Expressions
+{
+   typedef unsigned int Node;
 
-   do
+   explicit Flat_Expressions(CSG_Flat_Tree &flat) :
+      flat(flat), normal(flat.size(), NO_NORMAL)
    {
-      while(result_tree->get_type() != CSG_Node::PRIMITIVE &&
-            (side = get_fixable(result_tree->get_type(), result_tree->get_left()->get_type(),
-                                result_tree->get_right()->get_type())))
+   }
+
+   CSG_Node::CSG_Type type(Node node)
+   {
+      return (CSG_Node::CSG_Type)flat.types[node];
+   }
+   Node left(Node node) { return flat.lefts[node]; }
+   Node right(Node node) { return flat.rights[node]; }
+
+   Node operation(CSG_Node::CSG_Type type, Node left, Node right)
+   {
+      return flat.add_operation(type, left, right);
+   }
+
+   bool find_normal(Node node, Node &result)
+   {
+      if(node >= normal.size() || normal[node] == NO_NORMAL)
+         return false;
+      result = normal[node];
+      return true;
+   }
+
+   void set_normal(Node node, Node result)
+   {
+      if(node >= normal.size())
+         normal.resize(flat.size(), NO_NORMAL);
+      normal[node] = result;
+   }
+
+   CSG_Flat_Tree &flat;
+   vector<Node> normal; //!< The normalized form of every node, or NO_NORMAL.
+};
+
+template <class Expressions>
+static typename Expressions::Node
+shared_rewrite(Expressions &e, typename Expressions::Node tree, bool is_left)
+{
+   typedef typename Expressions::Node Node;
+
+   // Same rules as do_stuff(), but nothing is ever copied. The operand
+   // that the distributive rules duplicate is simply referenced twice.
+   Node child = is_left ? e.left(tree) : e.right(tree);
+   Node other_child = is_left ? e.right(tree) : e.left(tree);
+
+   CSG_Node::CSG_Type root_type = e.type(tree),
+      child_type = e.type(child);
+
+   assert(root_type != CSG_Node::PRIMITIVE);
+   assert(child_type != CSG_Node::PRIMITIVE);
+
+   Node childs_left = e.left(child),
+      childs_right = e.right(child);
+
+   // A-(B+C) => (A-B)-C
+   if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::UNION && !is_left)
+   {
+      normalize_rule_counter[2]++;
+      return e.operation(CSG_Node::DIFFERENCE,
+                         e.operation(CSG_Node::DIFFERENCE, other_child, childs_left),
+                         childs_right);
+   }
+   // (A-B)*C => (A*C)-B
+   else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::DIFFERENCE)
+   {
+      normalize_rule_counter[3]++;
+      return e.operation(CSG_Node::DIFFERENCE,
+                         e.operation(CSG_Node::INTERSECTION, childs_left, other_child),
+                         childs_right);
+   }
+   // A*(B*C) => (A*B)*C
+   else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::INTERSECTION && !is_left)
+   {
+      normalize_rule_counter[7]++;
+      return e.operation(CSG_Node::INTERSECTION,
+                         e.operation(CSG_Node::INTERSECTION, other_child, childs_left),
+                         childs_right);
+   }
+   // (A+B)*C => (A*C)+(B*C)
+   else if(root_type==CSG_Node::INTERSECTION && child_type==CSG_Node::UNION)
+   {
+      normalize_rule_counter[1]++;
+      return e.operation(CSG_Node::UNION,
+                         e.operation(CSG_Node::INTERSECTION, childs_left, other_child),
+                         e.operation(CSG_Node::INTERSECTION, childs_right, other_child));
+   }
+   // (A+B)-C => (A-C)+(B-C)
+   else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::UNION && is_left)
+   {
+      normalize_rule_counter[4]++;
+      return e.operation(CSG_Node::UNION,
+                         e.operation(CSG_Node::DIFFERENCE, childs_left, other_child),
+                         e.operation(CSG_Node::DIFFERENCE, childs_right, other_child));
+   }
+   // A-(B-C) => (A-B)+(A*C)
+   else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::DIFFERENCE && !is_left)
+   {
+      normalize_rule_counter[5]++;
+      return e.operation(CSG_Node::UNION,
+                         e.operation(CSG_Node::DIFFERENCE, other_child, childs_left),
+                         e.operation(CSG_Node::INTERSECTION, other_child, childs_right));
+   }
+   // A-(B*C) => (A-B)+(A-C)
+   else if(root_type==CSG_Node::DIFFERENCE && child_type==CSG_Node::INTERSECTION && !is_left)
+   {
+      normalize_rule_counter[6]++;
+      return e.operation(CSG_Node::UNION,
+                         e.operation(CSG_Node::DIFFERENCE, other_child, childs_left),
+                         e.operation(CSG_Node::DIFFERENCE, other_child, childs_right));
+   }
+   assert(!"get_fixable() and shared_rewrite() disagree");
+   return tree;
+}
+
+template <class Expressions>
+static int get_fixable(Expressions &e, typename Expressions::Node tree)
+{
+   return get_fixable(e.type(tree), e.type(e.left(tree)),
+                      e.type(e.right(tree)));
+}
+
+//! An expression that is being normalized by shared_normalize().
+template <class Node>
+struct Normalize_Frame
+{
+   Node tree;   //!< The expression.
+   Node result; //!< What it has been rewritten to so far.
+   int state;   //!< A Normalize_State.
+
+   explicit Normalize_Frame(Node tree) :
+      tree(tree), result(tree), state(NORMALIZE_ENTER)
+   {
+   }
+};
+
+template <class Expressions>
+static typename Expressions::Node
+shared_normalize(Expressions &e, typename Expressions::Node tree)
+{
+   typedef typename Expressions::Node Node;
+
+   // Mirrors normalize(const CSG_Node *) step by step, so that the
+   // result has exactly the same shape. Every frame is what would have
+   // been a recursive call, and returned is what the last one returned.
+   vector<Normalize_Frame<Node> > stack(1, Normalize_Frame<Node>(tree));
+   Node returned = tree;
+
+   while(!stack.empty())
+   {
+      Normalize_Frame<Node> &frame = stack.back();
+      int side = 0;
+
+      switch(frame.state)
       {
-         do_stuff(result_tree, (side == -1));
+         case NORMALIZE_ENTER:
+            if(e.find_normal(frame.tree, returned))
+            {
+               stack.pop_back();
+               break;
+            }
+            normalize_counter++;
+            if(e.type(frame.tree) == CSG_Node::PRIMITIVE)
+            {
+               e.set_normal(frame.tree, frame.tree);
+               returned = frame.tree;
+               stack.pop_back();
+               break;
+            }
+            frame.result = frame.tree;
+            // Fall through
+         case NORMALIZE_REWRITE:
+            while((side = get_fixable(e, frame.result)))
+               frame.result = shared_rewrite(e, frame.result, (side == -1));
+            frame.state = NORMALIZE_LEFT_DONE;
+            stack.push_back(Normalize_Frame<Node>(e.left(frame.result)));
+            break;
+         case NORMALIZE_LEFT_DONE:
+            frame.result = e.operation(e.type(frame.result), returned,
+                                       e.right(frame.result));
+            if(get_fixable(e, frame.result) != 0)
+            {
+               frame.state = NORMALIZE_REWRITE;
+               break;
+            }
+            frame.state = NORMALIZE_RIGHT_DONE;
+            stack.push_back(Normalize_Frame<Node>(e.right(frame.result)));
+            break;
+         default:
+            frame.result = e.operation(e.type(frame.result),
+                                       e.left(frame.result), returned);
+
+            // A normalized expression is its own normalized form.
+            // Remembering that saves walking through it again when it
+            // turns up inside a later rewrite.
+            e.set_normal(frame.tree, frame.result);
+            e.set_normal(frame.result, frame.result);
+            returned = frame.result;
+            stack.pop_back();
+            break;
       }
-      result_tree->delete_and_replace_left(normalize(result_tree->get_left()));
    }
-   while(get_fixable(result_tree->get_type(), result_tree->get_left()->get_type(),
-                     result_tree->get_right()->get_type()) != 0);
 
-   result_tree->delete_and_replace_right(normalize(result_tree->get_right()));
+   return returned;
+}
 
-   DBG(cout << "normalize done" << endl);
-   
-   return result_tree;
+const CSG_Dag_Node *normalize(CSG_Dag &dag, const CSG_Dag_Node *tree)
+{
+   Dag_Expressions expressions(dag);
+   return shared_normalize(expressions, tree);
+}
+
+void normalize(const CSG_Flat_Tree &tree, CSG_Flat_Tree &result)
+{
+   if(tree.empty())
+   {
+      result.clear();
+      return;
+   }
+
+   // The rules add their expressions after the ones of tree, and the
+   // result is a DAG in the same arrays until it is extracted.
+   CSG_Flat_Tree expressions = tree;
+   Flat_Expressions flat(expressions);
+   Flat_Expressions::Node normal = shared_normalize(flat, tree.root());
+   expressions.extract(normal, result);
+}
+
+//! Counts the nodes in a tree.
+struct Node_Counter : public CSG_Folder<const CSG_Node, unsigned long>
+{
+   unsigned long primitive(const CSG_Node *)
+   {
+      return 1;
+   }
+
+   unsigned long operation(const CSG_Node *, unsigned long left,
+                           unsigned long right)
+   {
+      return 1 + left + right;
+   }
+};
+
+static unsigned long count_nodes(const CSG_Node *tree)
+{
+   Node_Counter counter;
+   return fold_tree<unsigned long>(tree, counter);
+}
+
+CSG_Node *normalize_shared(const CSG_Node *tree, Normalize_Stats *stats)
+{
+   if(!tree)
+   {
+      if(stats)
+         stats->allocations = stats->peak_nodes = stats->shared = 0;
+      return NULL;
+   }
+
+   DBG(cout << "normalize_shared" << endl);
+
+   CSG_Dag dag;
+   CSG_Node *result = dag.expand(normalize(dag, dag.import(tree)));
+
+   if(stats)
+   {
+      // Nothing in the DAG is freed before the result has been expanded.
+      unsigned long result_nodes = count_nodes(result);
+      stats->allocations = dag.allocations() + result_nodes;
+      stats->peak_nodes = dag.size() + result_nodes;
+      stats->shared = dag.shared();
+   }
+
+   DBG(cout << "normalize_shared done" << endl);
+
+   return result;
+}
+
+//! Don't bother collecting garbage in DAGs smaller than this.
+static const unsigned long MIN_COLLECT_LIMIT = 4096;
+
+Incremental_Normalizer::Incremental_Normalizer(bool restructure) :
+   _collect_limit(MIN_COLLECT_LIMIT), _restructure(restructure), _cache(NULL)
+{
+}
+
+void Incremental_Normalizer::invalidate(const CSG_Node *node)
+{
+   for(; node; node = node->get_parent())
+      _imported.erase(node);
+}
+
+//! Erases every node of a tree from a map.
+struct Import_Eraser : public CSG_Visitor<const CSG_Node>
+{
+   explicit Import_Eraser(map<const CSG_Node *, const CSG_Dag_Node *> &imported) :
+      imported(imported)
+   {
+   }
+
+   void leave(const CSG_Node *tree)
+   {
+      imported.erase(tree);
+   }
+
+   map<const CSG_Node *, const CSG_Dag_Node *> &imported;
+};
+
+void Incremental_Normalizer::forget(const CSG_Node *tree)
+{
+   if(!tree)
+      return;
+   invalidate(tree);
+   Import_Eraser eraser(_imported);
+   visit_tree(tree, eraser);
+}
+
+void Incremental_Normalizer::reset()
+{
+   _imported.clear();
+   _dag.clear();
+   _collect_limit = MIN_COLLECT_LIMIT;
+}
+
+const CSG_Dag_Node *Incremental_Normalizer::import(const CSG_Node *tree)
+{
+   return _dag.import(tree, _imported);
+}
+
+void Incremental_Normalizer::collect(const CSG_Dag_Node *current)
+{
+   vector<const CSG_Dag_Node *> roots;
+   roots.reserve(_imported.size() + 1);
+   roots.push_back(current);
+
+   map<const CSG_Node *, const CSG_Dag_Node *>::const_iterator i;
+   for(i = _imported.begin(); i != _imported.end(); ++i)
+      roots.push_back(i->second);
+
+   _dag.collect(roots);
+
+   _collect_limit = 2 * _dag.size();
+   if(_collect_limit < MIN_COLLECT_LIMIT)
+      _collect_limit = MIN_COLLECT_LIMIT;
+}
+
+const CSG_Dag_Node *Incremental_Normalizer::normalize(const CSG_Node *tree)
+{
+   if(!tree)
+      return NULL;
+
+   // The restructured expression is rebuilt from the memoized parts on
+   // every call, but hash-consing hands back the same nodes as last time
+   // for everything that did not change, normalized forms included.
+   const CSG_Dag_Node *expression = import(tree);
+   if(_restructure)
+      expression = ::restructure(_dag, expression);
+   if(!expression)
+      return NULL;
+   const CSG_Dag_Node *result = expression->get_normal();
+   if(!result)
+      result = _cache ? normalize_cached(tree, expression)
+                      : ::normalize(_dag, expression);
+
+   // Keeping the expression keeps its normalized form too.
+   if(_dag.size() > _collect_limit)
+      collect(expression);
+
+   return result;
+}
+
+/*
+ * Normalizes expression, which is tree imported and maybe restructured,
+ * through the cache. Restructuring changes the normalized form, so it is
+ * part of the key.
+ */
+const CSG_Dag_Node *Incremental_Normalizer::normalize_cached(const CSG_Node *tree,
+                                                             const CSG_Dag_Node *expression)
+{
+   unsigned long check;
+   unsigned long hash = tree->structural_hash(&check) * 2 +
+      (_restructure ? 1 : 0);
+   const CSG_Dag_Node *result = _cache->find(_dag, tree, hash, check);
+   if(result)
+   {
+      _dag.set_normal(expression, result);
+      _dag.set_normal(result, result);
+      return result;
+   }
+
+   clock_t start = clock();
+   result = ::normalize(_dag, expression);
+   _cache->insert(hash, check, tree, result,
+                  (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+   return result;
+}
+
+void Incremental_Normalizer::set_cache(Normal_Cache *cache)
+{
+   _cache = cache;
+}
+
+CSG_Node *Incremental_Normalizer::normalize_tree(const CSG_Node *tree,
+                                                 CSG_Arena *arena)
+{
+   const CSG_Dag_Node *result = normalize(tree);
+   return result ? _dag.expand(result, arena) : NULL;
+}
+
+CSG_Dag &Incremental_Normalizer::get_dag()
+{
+   return _dag;
 }
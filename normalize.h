@@ -31,11 +31,145 @@
 #ifndef __NORMALIZE_H__
 #define __NORMALIZE_H__
 
+#include <map>
 #include "csg_tree.h"
+#include "csg_dag.h"
+#include "csg_flat.h"
+#include "normal_cache.h"
+#include "thread_pool.h"
+
+//! Counts the calls to both normalize() functions.
+extern int normalize_counter;
+
+/*!
+ * normalize_rule_counter[i] counts how many times rewrite rule i has been
+ * applied by either normalize() function, with the rules numbered 1 to 7
+ * as in the debug output of normalize.cpp. Element 0 is not used. Nothing
+ * resets the counters but the caller.
+ */
+extern unsigned long normalize_rule_counter[8];
+
+/*!
+ * Statistics from one run of normalize_shared().
+ */
+struct Normalize_Stats
+{
+   unsigned long allocations; //!< Nodes allocated, in the DAG and in the result.
+   unsigned long peak_nodes;  //!< Largest number of nodes alive at the same time.
+   unsigned long shared;      //!< Nodes that were reused instead of allocated.
+};
 
 /*!
  * Returns a normalized copy of the tree argument.
  */
 CSG_Node *normalize(const CSG_Node *tree);
 
+/*!
+ * Returns a normalized copy of the tree argument, identical to the one from
+ * normalize(tree). When a rewrite leaves a union, its operands are
+ * normalized at the same time on the threads of pool.
+ *
+ * \param cutoff Operands with fewer nodes than this are not worth another
+ *               thread, and are normalized by the thread that found them.
+ */
+CSG_Node *normalize_parallel(const CSG_Node *tree, Thread_Pool &pool,
+                             unsigned long cutoff = 64);
+
+/*!
+ * Normalizes an expression in a DAG. The rewrite rules are the same as in
+ * normalize(), but the distributive rules reference the duplicated operand
+ * instead of copying it. The result is remembered in the DAG, so normalizing
+ * the same (sub)expression again costs nothing.
+ */
+const CSG_Dag_Node *normalize(CSG_Dag &dag, const CSG_Dag_Node *node);
+
+/*!
+ * Normalizes a flat tree into result, with the same rewrite rules and the
+ * same result as normalize(const CSG_Dag_Node *). The rules append their
+ * expressions to a copy of tree, so nothing is allocated per node.
+ */
+void normalize(const CSG_Flat_Tree &tree, CSG_Flat_Tree &result);
+
+/*!
+ * Returns a normalized copy of the tree argument, built from a temporary DAG.
+ * The result is identical to the one from normalize(tree).
+ *
+ * \param stats If not NULL, receives allocation statistics for the run.
+ */
+CSG_Node *normalize_shared(const CSG_Node *tree, Normalize_Stats *stats = NULL);
+
+/*!
+ * Keeps track of the normalized form of a CSG tree that is edited in place.
+ *
+ * The tree is imported into a CSG_Dag that lives as long as the normalizer,
+ * and every node remembers its DAG expression. After an edit, only the nodes
+ * on the path from the change to the root are imported again, and the DAG
+ * normalizer finds the normalized form of all untouched subtrees in its memo.
+ *
+ * The normalizer does not notice edits by itself. Call invalidate() on every
+ * node whose subtree is about to change, and on every node that is about to
+ * be deleted, before doing it. Newly created nodes need no special treatment.
+ */
+class Incremental_Normalizer
+{
+public:
+   /*!
+    * \param restructure If true, the tree is passed through restructure()
+    *                    before it is normalized.
+    */
+   explicit Incremental_Normalizer(bool restructure = false);
+
+   /*!
+    * Forgets node and all of its ancestors. Must be called before the
+    * subtree rooted in node is changed or deleted.
+    */
+   void invalidate(const CSG_Node *node);
+
+   /*!
+    * Forgets every node in tree, and all of its ancestors. Must be called
+    * before the whole tree is deleted, if it is to be replaced by another
+    * one that shares expressions with it. Unlike reset(), the normalized
+    * forms of those expressions are kept.
+    */
+   void forget(const CSG_Node *tree);
+
+   //! Forgets everything, e.g. when a new scene is loaded.
+   void reset();
+
+   /*!
+    * Makes the normalizer look for trees that it has not normalized before
+    * in cache, and put them there after normalizing them. The cache must
+    * live as long as the normalizer uses it. NULL turns the cache off.
+    */
+   void set_cache(Normal_Cache *cache);
+
+   //! Returns the normalized form of tree, or NULL if tree is NULL or empty.
+   const CSG_Dag_Node *normalize(const CSG_Node *tree);
+
+   /*!
+    * Returns a normalized copy of tree, like normalize(const CSG_Node *).
+    * The caller owns the result.
+    *
+    * \param arena Where to allocate the copy. NULL means the heap.
+    */
+   CSG_Node *normalize_tree(const CSG_Node *tree, CSG_Arena *arena = NULL);
+
+   CSG_Dag &get_dag();
+
+private:
+   Incremental_Normalizer(const Incremental_Normalizer &);
+   void operator=(const Incremental_Normalizer &);
+
+   const CSG_Dag_Node *import(const CSG_Node *tree);
+   void collect(const CSG_Dag_Node *current);
+   const CSG_Dag_Node *normalize_cached(const CSG_Node *tree,
+                                        const CSG_Dag_Node *expression);
+
+   CSG_Dag _dag;
+   std::map<const CSG_Node *, const CSG_Dag_Node *> _imported;
+   unsigned long _collect_limit; //!< DAG size that triggers garbage collection.
+   bool _restructure;
+   Normal_Cache *_cache;
+};
+
 #endif
@@ -0,0 +1,726 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file normalize_bench.cpp
+ * Measures how long the modeler has to wait for the normalizer after an edit,
+ * and how normalization scales on synthetic trees.
+ * Build with "make release", or the debug output will dominate the numbers.
+ *
+ * Usage: normalize_bench [--csv | --json] [--sizes=N,N,...]
+ *                        [--max-products=N] [--seed=N] [--threads=N]
+ *
+ * Without --csv or --json, all measurements are printed as tables. With
+ * one of them, only the synthetic trees are measured, and printed in that
+ * format. --threads is the most threads to normalize on in parallel, by
+ * default the number of processors.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <cassert>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "csg_tree.h"
+#include "csg_object.h"
+#include "normalize.h"
+#include "product_stream.h"
+#include "normal_cache.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+//! Edits done at every scene size. Every edit deletes one primitive and adds one.
+const int EDITS = 10;
+
+//! Scene sizes to measure at.
+const int SIZES[] = { 25, 50, 100, 200, 400 };
+const int NUM_SIZES = sizeof(SIZES) / sizeof(SIZES[0]);
+
+//! normalize() takes seconds per edit above this size, so don't bother.
+const int MAX_CLASSIC_SIZE = 100;
+
+//! Returns the number of milliseconds of CPU time used since start.
+double ms_since(clock_t start)
+{
+   return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*!
+ * Picks an operation the way a user building a cheese would: mostly
+ * unions and differences, now and then an intersection.
+ */
+CSG_Node::CSG_Type random_operation()
+{
+   int r = rand() % 10;
+   if (r < 5) return CSG_Node::UNION;
+   if (r < 9) return CSG_Node::DIFFERENCE;
+   return CSG_Node::INTERSECTION;
+}
+
+//! Adds a primitive the way add_object() does, and returns the new root.
+CSG_Node *add_primitive(CSG_Node *root, vector<CSG_Object *> &objects)
+{
+   CSG_Object *object = new CSG_Object_Sphere();
+   objects.push_back(object);
+   CSG_Node *node = new CSG_Node(object);
+   if (!root)
+      return node;
+   return CSG_Node::create_and_insert(random_operation(), root, node);
+}
+
+void find_leaves(CSG_Node *tree, vector<CSG_Node *> &leaves)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      leaves.push_back(tree);
+   else
+   {
+      find_leaves(tree->get_left(), leaves);
+      find_leaves(tree->get_right(), leaves);
+   }
+}
+
+/*!
+ * Deletes a random primitive node the way delete_primitive() does, and
+ * returns the new root. Calls invalidate() on normalizer first, if given.
+ */
+CSG_Node *delete_primitive(CSG_Node *root, Incremental_Normalizer *normalizer)
+{
+   vector<CSG_Node *> leaves;
+   find_leaves(root, leaves);
+   assert(leaves.size() > 1);
+   CSG_Node *p = leaves[rand() % leaves.size()];
+
+   if (normalizer)
+      normalizer->invalidate(p);
+
+   CSG_Node *pp = p->get_parent();
+   bool delete_left = pp->get_left() == p;
+   if (pp->get_parent())
+   {
+      delete (delete_left ? pp->detach_left() : pp->detach_right());
+      return root;
+   }
+   return delete_left ? pp->delete_left_detach_right() : pp->delete_right_detach_left();
+}
+
+/*!
+ * INCREMENTAL_DAG stops at the normalized DAG expression, without expanding
+ * it into a CSG_Node tree, to show how much of the time is spent copying the
+ * result out.
+ */
+enum Method { CLASSIC, SHARED, INCREMENTAL, INCREMENTAL_DAG };
+
+//! Normalizes root with the given method and throws the result away.
+void renormalize(Method method, const CSG_Node *root,
+                 Incremental_Normalizer &normalizer)
+{
+   switch (method)
+   {
+   case CLASSIC:
+      delete normalize(root);
+      break;
+   case SHARED:
+      delete normalize_shared(root);
+      break;
+   case INCREMENTAL:
+      delete normalizer.normalize_tree(root);
+      break;
+   case INCREMENTAL_DAG:
+      normalizer.normalize(root);
+      break;
+   }
+}
+
+/*!
+ * Builds a scene of the given size, then measures the time per edit,
+ * separately for deletes and adds. Every method sees exactly the same
+ * sequence of scenes.
+ */
+void measure(Method method, int size, unsigned int seed,
+             double &delete_ms, double &add_ms)
+{
+   srand(seed);
+
+   vector<CSG_Object *> objects;
+   Incremental_Normalizer normalizer;
+   CSG_Node *root = NULL;
+
+   for (int i = 0; i < size; ++i)
+      root = add_primitive(root, objects);
+
+   // Let the incremental normalizer see the scene once before we start,
+   // just like the modeler has seen it before the user's next keypress.
+   if (method == INCREMENTAL || method == INCREMENTAL_DAG)
+      normalizer.normalize(root);
+
+   delete_ms = add_ms = 0;
+   for (int edit = 0; edit < EDITS; ++edit)
+   {
+      clock_t start = clock();
+      root = delete_primitive(root, method == CLASSIC || method == SHARED
+                              ? NULL : &normalizer);
+      renormalize(method, root, normalizer);
+      delete_ms += ms_since(start);
+
+      start = clock();
+      root = add_primitive(root, objects);
+      renormalize(method, root, normalizer);
+      add_ms += ms_since(start);
+   }
+   delete_ms /= EDITS;
+   add_ms /= EDITS;
+
+   delete root;
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      delete objects[i];
+}
+
+/*!
+ * Builds (a1+b1)*(a2+b2)*...*(an+bn), whose normalized form has 2^n
+ * products, and measures how long it takes to stream all of them. The
+ * normalized tree is only built for the smaller ones.
+ */
+void measure_stream()
+{
+   cout << endl << "Streaming the products of (a1+b1)*(a2+b2)*...*(an+bn)." << endl
+        << endl;
+   cout << setw(10) << "n" << setw(12) << "estimate" << setw(12) << "streamed"
+        << setw(14) << "stream ms" << setw(22) << "normalize_shared() ms" << endl;
+
+   for (int n = 4; n <= 20; n += 4)
+   {
+      vector<CSG_Object *> objects;
+      CSG_Node *root = NULL;
+      for (int i = 0; i < n; ++i)
+      {
+         CSG_Object *a = new CSG_Object_Sphere(), *b = new CSG_Object_Sphere();
+         objects.push_back(a);
+         objects.push_back(b);
+         CSG_Node *sum = CSG_Node::create_and_insert(CSG_Node::UNION,
+                                                     new CSG_Node(a),
+                                                     new CSG_Node(b));
+         root = root ? CSG_Node::create_and_insert(CSG_Node::INTERSECTION, root, sum)
+                     : sum;
+      }
+
+      clock_t start = clock();
+      Product_Stream stream(root);
+      Product_List product;
+      while (stream.next(product))
+         ;
+      double stream_ms = ms_since(start);
+
+      cout << setw(10) << n << setw(12) << setprecision(0) << stream.estimate()
+           << setprecision(3) << setw(12) << stream.count() << setw(14) << stream_ms;
+      if (n <= 12)
+      {
+         start = clock();
+         delete normalize_shared(root);
+         cout << setw(22) << ms_since(start);
+      }
+      else
+         cout << setw(22) << "-";
+      cout << endl;
+
+      delete root;
+      for (unsigned int i = 0; i < objects.size(); ++i)
+         delete objects[i];
+   }
+}
+
+/*!
+ * Normalizes scenes like the ones from measure() through a Normal_Cache,
+ * and again through a copy of the cache read back from a file, like after
+ * reloading the scene. Reports how long both take and how much time the
+ * cache says it saved.
+ */
+void measure_cache()
+{
+   const char *cache_file = "normalize_bench.cache";
+
+   cout << endl << "Normalizing through a cache, and again after reloading it."
+        << endl << endl;
+   cout << setw(10) << "primitives" << setw(12) << "miss ms" << setw(12)
+        << "hit ms" << setw(12) << "saved ms" << setw(12) << "lookup ms"
+        << endl;
+
+   for (int i = 0; i < NUM_SIZES; ++i)
+   {
+      srand(4711 + i);
+      vector<CSG_Object *> objects;
+      CSG_Node *root = NULL;
+      for (int j = 0; j < SIZES[i]; ++j)
+         root = add_primitive(root, objects);
+
+      Normal_Cache cache;
+      Incremental_Normalizer normalizer;
+      normalizer.set_cache(&cache);
+      clock_t start = clock();
+      normalizer.normalize(root);
+      double miss_ms = ms_since(start);
+      cache.save(cache_file);
+
+      Normal_Cache reloaded;
+      reloaded.load(cache_file);
+      Incremental_Normalizer reloaded_normalizer;
+      reloaded_normalizer.set_cache(&reloaded);
+      start = clock();
+      reloaded_normalizer.normalize(root);
+      double hit_ms = ms_since(start);
+      assert(reloaded.hits() == 1);
+
+      cout << setw(10) << SIZES[i] << setw(12) << miss_ms << setw(12) << hit_ms
+           << setw(12) << reloaded.saved_ms() << setw(12) << reloaded.lookup_ms()
+           << endl;
+
+      delete root;
+      for (unsigned int j = 0; j < objects.size(); ++j)
+         delete objects[j];
+   }
+   remove(cache_file);
+}
+
+//! Creates a new primitive node with a new object.
+CSG_Node *new_leaf(vector<CSG_Object *> &objects)
+{
+   CSG_Object *object = new CSG_Object_Sphere();
+   objects.push_back(object);
+   return new CSG_Node(object);
+}
+
+//! Builds a tree with operations like the ones a user would pick.
+CSG_Node *generate_random(int size, vector<CSG_Object *> &objects)
+{
+   CSG_Node *root = NULL;
+   for (int i = 0; i < size; ++i)
+      root = add_primitive(root, objects);
+   return root;
+}
+
+//! Like generate_random(), but balanced instead of left-deep.
+CSG_Node *generate_random_balanced(int size, vector<CSG_Object *> &objects)
+{
+   if (size == 1)
+      return new_leaf(objects);
+   CSG_Node *left = generate_random_balanced(size / 2, objects);
+   return CSG_Node::create_and_insert(random_operation(), left,
+                                      generate_random_balanced(size - size / 2,
+                                                               objects));
+}
+
+//! Builds a1-(a2-(a3-...)), which rule 5 turns into a union.
+CSG_Node *generate_deep_difference(int size, vector<CSG_Object *> &objects)
+{
+   CSG_Node *root = new_leaf(objects);
+   for (int i = 1; i < size; ++i)
+      root = CSG_Node::create_and_insert(CSG_Node::DIFFERENCE, new_leaf(objects),
+                                         root);
+   return root;
+}
+
+//! Builds a union of two primitives, or a primitive if size is 1.
+CSG_Node *new_sum(int size, vector<CSG_Object *> &objects)
+{
+   CSG_Node *sum = new_leaf(objects);
+   if (size > 1)
+      sum = CSG_Node::create_and_insert(CSG_Node::UNION, sum, new_leaf(objects));
+   return sum;
+}
+
+//! Builds (a1+b1)*(a2+b2)*..., which has 2^(size/2) products.
+CSG_Node *generate_intersected_unions(int size, vector<CSG_Object *> &objects)
+{
+   CSG_Node *root = new_sum(size, objects);
+   for (int i = 2; i < size; i += 2)
+      root = CSG_Node::create_and_insert(CSG_Node::INTERSECTION, root,
+                                         new_sum(size - i, objects));
+   return root;
+}
+
+//! Like generate_intersected_unions(), but balanced instead of left-deep.
+CSG_Node *generate_intersected_unions_balanced(int size,
+                                               vector<CSG_Object *> &objects)
+{
+   if (size <= 2)
+      return new_sum(size, objects);
+   int left_size = size / 4 * 2;
+   CSG_Node *left = generate_intersected_unions_balanced(left_size, objects);
+   return CSG_Node::create_and_insert(CSG_Node::INTERSECTION, left,
+                                      generate_intersected_unions_balanced(size - left_size,
+                                                                           objects));
+}
+
+struct Generator
+{
+   const char *name;
+   CSG_Node *(*generate)(int size, vector<CSG_Object *> &objects);
+};
+
+const Generator GENERATORS[] =
+{
+   { "random", generate_random },
+   { "random-balanced", generate_random_balanced },
+   { "deep-difference", generate_deep_difference },
+   { "intersected-unions", generate_intersected_unions },
+   { "intersected-unions-balanced", generate_intersected_unions_balanced }
+};
+const int NUM_GENERATORS = sizeof(GENERATORS) / sizeof(GENERATORS[0]);
+
+//! What normalizing one synthetic tree cost.
+struct Sweep_Result
+{
+   const char *generator;
+   int size;
+   double products;      //!< Products in the normalized tree.
+   bool classic;         //!< False if normalize() was skipped.
+   double classic_ms;
+   unsigned long rules[8];   //!< Rule firings in normalize().
+   bool shared;          //!< False if normalize_shared() was skipped.
+   double shared_ms;
+   unsigned long peak_nodes; //!< Most nodes alive in normalize_shared().
+   unsigned long rewrites;   //!< Rule firings in normalize_shared().
+};
+
+/*!
+ * Normalizes a tree from a generator with normalize() and
+ * normalize_shared(). Either is skipped if the result would have more
+ * products than it can handle in reasonable time.
+ */
+Sweep_Result sweep(const Generator &generator, int size, double max_products)
+{
+   vector<CSG_Object *> objects;
+   CSG_Node *root = generator.generate(size, objects);
+
+   Sweep_Result result;
+   result.generator = generator.name;
+   result.size = size;
+   result.products = Product_Stream(root).estimate();
+
+   // normalize() copies much more than normalize_shared() does.
+   result.classic = result.products <= max_products / 10 &&
+                    size <= MAX_CLASSIC_SIZE;
+   if (result.classic)
+   {
+      for (int i = 0; i < 8; ++i)
+         normalize_rule_counter[i] = 0;
+      clock_t start = clock();
+      delete normalize(root);
+      result.classic_ms = ms_since(start);
+      for (int i = 0; i < 8; ++i)
+         result.rules[i] = normalize_rule_counter[i];
+   }
+
+   result.shared = result.products <= max_products;
+   if (result.shared)
+   {
+      for (int i = 0; i < 8; ++i)
+         normalize_rule_counter[i] = 0;
+      Normalize_Stats stats;
+      clock_t start = clock();
+      delete normalize_shared(root, &stats);
+      result.shared_ms = ms_since(start);
+      result.peak_nodes = stats.peak_nodes;
+      result.rewrites = 0;
+      for (int i = 1; i < 8; ++i)
+         result.rewrites += normalize_rule_counter[i];
+   }
+
+   delete root;
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      delete objects[i];
+   return result;
+}
+
+//! Returns the number of milliseconds of real time since start.
+double wall_ms_since(const timeval &start)
+{
+   timeval now;
+   gettimeofday(&now, NULL);
+   return (now.tv_sec - start.tv_sec) * 1000.0 +
+      (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+/*!
+ * Normalizes large synthetic trees with normalize_parallel() on 1 to
+ * max_threads threads, counting the calling thread, and reports the real
+ * time and the speedup over normalize(). Every result is checked against
+ * the one from normalize().
+ */
+void measure_scaling(int max_threads)
+{
+   struct Scaling_Tree
+   {
+      int generator;
+      int size;
+   };
+   const Scaling_Tree trees[] = { { 4, 24 }, { 4, 28 }, { 3, 24 }, { 0, 100 } };
+   const int num_trees = sizeof(trees) / sizeof(trees[0]);
+
+   cout << endl << "Milliseconds of real time for normalize_parallel(), and "
+        << "speedup over normalize()." << endl << endl;
+   cout << setw(28) << "generator" << setw(6) << "size" << setw(10)
+        << "products" << setw(12) << "serial ms";
+   for (int threads = 1; threads <= max_threads; ++threads)
+   {
+      ostringstream title;
+      title << threads << (threads == 1 ? " thread" : " threads");
+      cout << setw(22) << title.str();
+   }
+   cout << endl;
+
+   for (int t = 0; t < num_trees; ++t)
+   {
+      const Generator &generator = GENERATORS[trees[t].generator];
+      vector<CSG_Object *> objects;
+      srand(4711);
+      CSG_Node *root = generator.generate(trees[t].size, objects);
+
+      timeval start;
+      gettimeofday(&start, NULL);
+      CSG_Node *serial = normalize(root);
+      double serial_ms = wall_ms_since(start);
+      string expected = serial->stringify();
+
+      cout << setw(28) << generator.name << setw(6) << trees[t].size
+           << setw(10) << setprecision(0) << Product_Stream(root).estimate()
+           << setprecision(3) << setw(12) << serial_ms;
+      delete serial;
+
+      for (int threads = 1; threads <= max_threads; ++threads)
+      {
+         Thread_Pool pool(threads - 1);
+         gettimeofday(&start, NULL);
+         CSG_Node *result = normalize_parallel(root, pool);
+         double ms = wall_ms_since(start);
+
+         ostringstream cell;
+         cell << fixed << setprecision(3) << ms << " (" << setprecision(2)
+              << serial_ms / ms << "x)";
+         if (result->stringify() != expected)
+            cell << " differs!";
+         cout << setw(22) << cell.str();
+         delete result;
+      }
+      cout << endl;
+
+      delete root;
+      for (unsigned int i = 0; i < objects.size(); ++i)
+         delete objects[i];
+   }
+}
+
+enum Format { TABLE, CSV, JSON };
+
+//! Prints one field of a sweep result, or nothing if it was not measured.
+template <class T>
+void print_field(ostream &out, Format format, bool measured, T value, int width)
+{
+   if (format == TABLE)
+      out << setw(width);
+   if (measured)
+      out << value;
+   else
+      out << (format == JSON ? "null" : format == TABLE ? "-" : "");
+}
+
+void print_sweep(const vector<Sweep_Result> &results, Format format)
+{
+   const char *rule_names[] = { NULL, "op1", "op2", "op3", "op4", "op5",
+                                "op6", "op7" };
+
+   if (format == TABLE)
+   {
+      cout << endl << "Normalizing synthetic trees. op1-op7 are rule firings "
+           << "in normalize()." << endl << endl
+           << setw(28) << "generator" << setw(6) << "size" << setw(10)
+           << "products" << setw(12) << "classic ms";
+      for (int i = 1; i < 8; ++i)
+         cout << setw(8) << rule_names[i];
+      cout << setw(11) << "shared ms" << setw(10) << "peak" << setw(10)
+           << "rewrites" << endl;
+   }
+   else if (format == CSV)
+   {
+      cout << "generator,size,products,classic_ms";
+      for (int i = 1; i < 8; ++i)
+         cout << "," << rule_names[i];
+      cout << ",shared_ms,peak_nodes,shared_rewrites" << endl;
+   }
+   else
+      cout << "[" << endl;
+
+   const char *separator = format == CSV ? "," : "";
+   for (unsigned int r = 0; r < results.size(); ++r)
+   {
+      const Sweep_Result &result = results[r];
+      if (format == JSON)
+      {
+         cout << "  { \"generator\": \"" << result.generator << "\", \"size\": "
+              << result.size << ", \"products\": " << setprecision(0)
+              << result.products << setprecision(3) << ", \"classic_ms\": ";
+         print_field(cout, format, result.classic, result.classic_ms, 0);
+         for (int i = 1; i < 8; ++i)
+         {
+            cout << ", \"" << rule_names[i] << "\": ";
+            print_field(cout, format, result.classic, result.rules[i], 0);
+         }
+         cout << ", \"shared_ms\": ";
+         print_field(cout, format, result.shared, result.shared_ms, 0);
+         cout << ", \"peak_nodes\": ";
+         print_field(cout, format, result.shared, result.peak_nodes, 0);
+         cout << ", \"shared_rewrites\": ";
+         print_field(cout, format, result.shared, result.rewrites, 0);
+         cout << " }" << (r + 1 < results.size() ? "," : "") << endl;
+         continue;
+      }
+
+      if (format == TABLE)
+         cout << setw(28) << result.generator << setw(6) << result.size
+              << setw(10) << setprecision(0) << result.products;
+      else
+         cout << result.generator << "," << result.size << ","
+              << setprecision(0) << result.products;
+      cout << setprecision(3);
+      cout << separator;
+      print_field(cout, format, result.classic, result.classic_ms, 12);
+      for (int i = 1; i < 8; ++i)
+      {
+         cout << separator;
+         print_field(cout, format, result.classic, result.rules[i], 8);
+      }
+      cout << separator;
+      print_field(cout, format, result.shared, result.shared_ms, 11);
+      cout << separator;
+      print_field(cout, format, result.shared, result.peak_nodes, 10);
+      cout << separator;
+      print_field(cout, format, result.shared, result.rewrites, 10);
+      cout << endl;
+   }
+
+   if (format == JSON)
+      cout << "]" << endl;
+}
+
+int main(int argc, char **argv)
+{
+   Format format = TABLE;
+   vector<int> sizes;
+   double max_products = 100000;
+   unsigned int seed = 4711;
+   int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+   for (int i = 1; i < argc; ++i)
+   {
+      string arg = argv[i];
+      if (arg == "--csv")
+         format = CSV;
+      else if (arg == "--json")
+         format = JSON;
+      else if (arg.compare(0, 8, "--sizes=") == 0)
+      {
+         istringstream in(arg.substr(8));
+         int size;
+         while (in >> size)
+         {
+            if (size > 0)
+               sizes.push_back(size);
+            in.ignore(1);
+         }
+      }
+      else if (arg.compare(0, 15, "--max-products=") == 0)
+         max_products = atof(arg.c_str() + 15);
+      else if (arg.compare(0, 7, "--seed=") == 0)
+         seed = atoi(arg.c_str() + 7);
+      else if (arg.compare(0, 10, "--threads=") == 0)
+         max_threads = atoi(arg.c_str() + 10);
+      else
+      {
+         cout << "Usage: " << argv[0] << " [--csv | --json] [--sizes=N,N,...] "
+              << "[--max-products=N] [--seed=N] [--threads=N]" << endl;
+         return 1;
+      }
+   }
+   if (sizes.empty())
+      for (int size = 8; size <= 256; size *= 2)
+         sizes.push_back(size);
+
+   cout << fixed << setprecision(3);
+
+   vector<Sweep_Result> results;
+   for (int g = 0; g < NUM_GENERATORS; ++g)
+      for (unsigned int s = 0; s < sizes.size(); ++s)
+      {
+         srand(seed + s);
+         results.push_back(sweep(GENERATORS[g], sizes[s], max_products));
+      }
+
+   if (format != TABLE)
+   {
+      print_sweep(results, format);
+      return 0;
+   }
+
+   const char *names[] = { "normalize()", "normalize_shared()",
+                           "incremental", "(without expand)" };
+
+   cout << "Milliseconds per edit, delete / add a primitive and normalize."
+        << endl << endl;
+   cout << setw(10) << "primitives";
+   for (int method = CLASSIC; method <= INCREMENTAL_DAG; ++method)
+      cout << setw(22) << names[method];
+   cout << endl;
+
+   for (int i = 0; i < NUM_SIZES; ++i)
+   {
+      cout << setw(10) << SIZES[i];
+      for (int method = CLASSIC; method <= INCREMENTAL_DAG; ++method)
+      {
+         if (method == CLASSIC && SIZES[i] > MAX_CLASSIC_SIZE)
+         {
+            cout << setw(22) << "-";
+            continue;
+         }
+         double delete_ms, add_ms;
+         measure((Method)method, SIZES[i], 4711 + i, delete_ms, add_ms);
+         cout << setw(11) << delete_ms << " /" << setw(9) << add_ms;
+      }
+      cout << endl;
+   }
+
+   measure_stream();
+   measure_cache();
+   measure_scaling(max_threads < 1 ? 1 : max_threads);
+   print_sweep(results, format);
+
+   return 0;
+}
@@ -25,10 +25,37 @@
 
 #include <iostream>
 #include <string>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <cstdio>
+#include <cmath>
 #include <assert.h>
 
 #include "csg_tree.h"
 #include "csg_object.h"
+#include "camera.h"
+#include "persistence.h"
+#include "normalize.h"
+#include "prune.h"
+#include "product_list.h"
+#include "product_stream.h"
+#include "restructure.h"
+#include "components.h"
+#include "normal_cache.h"
+#include "csg_arena.h"
+#include "csg_history.h"
+#include "csg_visitor.h"
+#include "scene_query.h"
+#include "primitive_registry.h"
+#include "spatial_index.h"
+#include "overlap_graph.h"
+#include "convex.h"
+#include "mesh_cache.h"
+#include "level_of_detail.h"
+#include "impostor.h"
+#include "matrix.h"
 
 using namespace std;
 
@@ -117,8 +144,1379 @@ bool is_simon_normal(const CSG_Node *tree)
    }
 }
 
-int main()
+int count_products(const CSG_Node *tree)
 {
+   if (!tree)
+      return 0;
+   if (tree->get_type() == CSG_Node::UNION)
+      return count_products(tree->get_left()) + count_products(tree->get_right());
+   return 1;
+}
+
+/*!
+ * Prunes a normalized tree afterwards, and normalizes the original with
+ * pruning. Pruning during normalization must not leave more products than
+ * pruning afterwards, and must still give a normalized tree.
+ */
+bool test_prune(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   Prune_Stats after, during;
+   CSG_Node *ptree = prune(ntree, &after);
+   CSG_Node *pntree = normalize_pruned(tree, &during);
+
+   cout << "Beskuren: " << count_products(ptree) << " av "
+        << count_products(ntree) << " produkter kvar. Efter normalisering: "
+        << after.products << " produkter och " << after.subtrahends
+        << " subtrahender borttagna, under normalisering: " << during.products
+        << " och " << during.subtrahends << "." << endl;
+
+   bool fewer = count_products(pntree) <= count_products(ptree);
+   bool normal = !pntree || is_simon_normal(pntree);
+   if (!fewer)
+      cout << "FEL: fler produkter kvar efter beskrning under normalisering." << endl;
+   if (!normal)
+      cout << "FEL: beskuret trd r inte normalt." << endl;
+
+   delete ptree;
+   delete pntree;
+   return fewer && normal;
+}
+
+//! Checks that a normalized tree flattens into the right number of products.
+bool test_product_list(const CSG_Node *ntree)
+{
+   Product_List list;
+   bool ok = list.assign(ntree) &&
+      (int)list.products.size() == count_products(ntree) &&
+      (int)list.primitives.size() == count_leaves(ntree);
+   if (!ok)
+      cout << "FEL: produktlistan stmmer inte med trdet." << endl;
+   return ok;
+}
+
+//! Builds a sum of products from everything a Product_Stream yields.
+CSG_Node *stream_tree(const CSG_Node *tree)
+{
+   Product_Stream stream(tree);
+   Product_List list;
+   CSG_Node *result = NULL;
+   while (stream.next(list))
+   {
+      const Product_List::Product &p = list.products[0];
+      CSG_Node *product = new CSG_Node(list.primitives[p.intersect_begin]);
+      for (unsigned int i = p.intersect_begin + 1; i < p.subtract_begin; ++i)
+         product = CSG_Node::create_and_insert(CSG_Node::INTERSECTION, product,
+                                               new CSG_Node(list.primitives[i]));
+      for (unsigned int i = p.subtract_begin; i < p.subtract_end; ++i)
+         product = CSG_Node::create_and_insert(CSG_Node::DIFFERENCE, product,
+                                               new CSG_Node(list.primitives[i]));
+      result = result ? CSG_Node::create_and_insert(CSG_Node::UNION, result, product)
+                      : product;
+   }
+   return result;
+}
+
+/*!
+ * Checks that a Product_Stream yields as many products and primitives as
+ * there are in the normalized tree, and as many as it estimated.
+ */
+bool test_stream(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   Product_Stream stream(tree);
+   Product_List list;
+   int products = 0, primitives = 0;
+   while (stream.next(list))
+   {
+      ++products;
+      primitives += list.primitives.size();
+   }
+
+   Product_Stream limited(tree, 1);
+   bool truncated = limited.next(list) && !limited.next(list) &&
+      limited.truncated() == (products > 1);
+
+   bool ok = products == count_products(ntree) &&
+      primitives == count_leaves(ntree) &&
+      stream.estimate() == products && truncated;
+   if (!ok)
+      cout << "FEL: strmmen gav " << products << " produkter med "
+           << primitives << " primitiver, uppskattade " << stream.estimate()
+           << "." << endl;
+   return ok;
+}
+
+//! Prints the estimated cost of tree before and after restructuring.
+bool test_restructure(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   Tree_Cost before = estimate_cost(tree);
+   CSG_Node *rtree = restructure(tree);
+   Tree_Cost after = estimate_cost(rtree);
+
+   cout << "Kostnad: " << before.products << " produkter och "
+        << before.subtractions << " subtraktionssteg fre omstrukturering, "
+        << after.products << " och " << after.subtractions << " efter." << endl;
+
+   bool ok = before.products == count_products(ntree) &&
+      after.total() <= before.total();
+   if (!ok)
+      cout << "FEL: kostnadsmodellen stmmer inte." << endl;
+
+   delete rtree;
+   return ok;
+}
+
+//! True if two component sets group the objects in the same way.
+bool same_components(const Component_Set &a, const Component_Set &b,
+                     const list<CSG_Object *> &objects)
+{
+   list<CSG_Object *>::const_iterator i, j;
+   for (i = objects.begin(); i != objects.end(); ++i)
+      for (j = i; j != objects.end(); ++j)
+         if ((a.component_of(*i) == a.component_of(*j)) !=
+             (b.component_of(*i) == b.component_of(*j)))
+            return false;
+   return a.size() == b.size();
+}
+
+//! Lists the objects in tree. load() does not fill in its object list.
+void find_objects(const CSG_Node *tree, list<CSG_Object *> &objects)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      objects.push_back(tree->get_object());
+   else
+   {
+      find_objects(tree->get_left(), objects);
+      find_objects(tree->get_right(), objects);
+   }
+}
+
+/*!
+ * Splits tree into components, and checks that they have the products of
+ * the pruned normalized tree. Then moves every object away and back again,
+ * and checks that the components are updated as if they were made anew.
+ */
+bool test_components(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   list<CSG_Object *> objects;
+   find_objects(tree, objects);
+
+   Incremental_Normalizer normalizer;
+   Component_Set components(normalizer);
+   components.assign(tree);
+
+   CSG_Node *ptree = prune(ntree);
+   bool ok = (int)components.get_products().products.size() ==
+      count_products(ptree);
+   delete ptree;
+
+   cout << "Komponenter: " << components.size() << endl;
+
+   list<CSG_Object *>::const_iterator i;
+   for (i = objects.begin(); ok && i != objects.end(); ++i)
+   {
+      for (int step = 0; ok && step < 2; ++step)
+      {
+         GLfloat dx = step ? -100 : 100;
+         (*i)->set_transform(translate(dx, 0, 0) * (*i)->get_transform());
+         components.moved(*i);
+
+         Component_Set fresh(normalizer);
+         fresh.assign(tree);
+         ok = same_components(components, fresh, objects) &&
+            components.get_products().products.size() ==
+            fresh.get_products().products.size();
+      }
+   }
+
+   cout << components.prunings() << " beskrningar efter "
+        << 2 * objects.size() << " flyttningar." << endl;
+   if (!ok)
+      cout << "FEL: komponenterna stmmer inte." << endl;
+   return ok;
+}
+
+/*!
+ * Normalizes tree through a cache and saves it, loads the scene again, and
+ * checks that the second normalization comes from the cache and gives the
+ * same tree. An entry with the same hash but another second hash, as from
+ * a colliding tree, must not be used.
+ */
+bool test_cache(const CSG_Node *tree, const string &filename)
+{
+   const string cache_file = "normalize_test.cache";
+
+   Normal_Cache cache;
+   Incremental_Normalizer normalizer(true);
+   normalizer.set_cache(&cache);
+   CSG_Node *ntree = normalizer.normalize_tree(tree);
+   cache.save(cache_file);
+
+   list<CSG_Object *> objects;
+   Camera camera;
+   CSG_Node *reloaded = load(filename, objects, camera);
+   Normal_Cache reloaded_cache;
+   reloaded_cache.load(cache_file);
+   remove(cache_file.c_str());
+   Incremental_Normalizer reloaded_normalizer(true);
+   reloaded_normalizer.set_cache(&reloaded_cache);
+   CSG_Node *nreloaded = reloaded_normalizer.normalize_tree(reloaded);
+
+   cout << "Cache: " << reloaded_cache.hits() << " trffar och "
+        << reloaded_cache.misses() << " missar efter omladdning, "
+        << reloaded_cache.saved_ms() << " ms sparade, "
+        << reloaded_cache.lookup_ms() << " ms att sl upp." << endl;
+
+   bool ok = tree->structural_hash() == reloaded->structural_hash() &&
+      reloaded_cache.hits() == 1 && reloaded_cache.misses() == 0 &&
+      ntree->stringify() == nreloaded->stringify();
+   if (!ok)
+      cout << "FEL: cachen gav inte samma trd." << endl;
+
+   unsigned long check;
+   unsigned long hash = tree->structural_hash(&check);
+   CSG_Dag dag;
+   const CSG_Dag_Node *normal = normalize(dag, dag.import(tree));
+   Normal_Cache collided;
+   collided.insert(hash, check + 1, tree, normal, 0);
+   if (collided.find(dag, tree, hash, check) ||
+       !collided.find(dag, tree, hash, check + 1))
+   {
+      cout << "FEL: cachen anvnde en post med fel kontrollsumma." << endl;
+      ok = false;
+   }
+
+   delete ntree;
+   delete nreloaded;
+   objects.clear();
+   find_objects(reloaded, objects);
+   delete reloaded;
+   while (!objects.empty())
+   {
+      delete objects.front();
+      objects.pop_front();
+   }
+   return ok;
+}
+
+/*!
+ * Normalizes tree into an arena, and checks that copies stay in it, that
+ * deleted nodes are reused, and that the arena can be dropped at once.
+ */
+bool test_arena(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   CSG_Arena arena;
+   Incremental_Normalizer normalizer;
+   CSG_Node *atree = normalizer.normalize_tree(tree, &arena);
+   unsigned long nodes = 2 * count_leaves(ntree) - 1;
+
+   bool ok = atree->get_arena() == &arena &&
+      atree->stringify() == ntree->stringify() && arena.size() == nodes;
+
+   unsigned long capacity = arena.capacity();
+   CSG_Node *copy = new (atree->get_arena()) CSG_Node(*atree);
+   ok = (copy->get_type() == CSG_Node::PRIMITIVE ||
+         copy->get_left()->get_arena() == &arena) &&
+      arena.size() == 2 * nodes && ok;
+   delete copy;
+   ok = arena.size() == nodes && ok;
+   // The copy takes the nodes that were deleted, and nothing more.
+   copy = new (&arena) CSG_Node(*atree);
+   ok = arena.capacity() == capacity && ok;
+
+   cout << "Arena: " << arena.size() << " noder i " << arena.capacity()
+        << " byte." << endl;
+   arena.clear();
+   ok = arena.size() == 0 && arena.capacity() == 0 && ok;
+
+   if (!ok)
+      cout << "FEL: arenan stmmer inte." << endl;
+   return ok;
+}
+
+/*!
+ * Checks that a tree survives the trip to a CSG_Flat_Tree and back, and
+ * that the flat tree normalizes and flattens into the same products as
+ * the normalized tree.
+ */
+bool test_flat(const CSG_Node *tree, const CSG_Node *ntree)
+{
+   CSG_Flat_Tree flat(tree);
+   CSG_Node *copy = flat.to_tree();
+   bool ok = flat.stringify() == tree->stringify() &&
+      copy->stringify() == tree->stringify();
+   delete copy;
+
+   CSG_Flat_Tree normal;
+   normalize(flat, normal);
+   ok = normal.stringify() == ntree->stringify() &&
+      normal.size() == CSG_Flat_Tree(ntree).size() && ok;
+
+   Product_List list, flat_list;
+   ok = list.assign(ntree) && flat_list.assign(normal) &&
+      list.primitives == flat_list.primitives &&
+      list.products.size() == flat_list.products.size() && ok;
+   for (unsigned int i = 0; ok && i < list.products.size(); ++i)
+      ok = list.products[i].subtract_begin ==
+         flat_list.products[i].subtract_begin &&
+         list.products[i].subtract_end == flat_list.products[i].subtract_end;
+
+   // Only a tree that is already normalized is a sum of products.
+   ok = flat_list.assign(flat) == is_simon_normal(tree) && ok;
+
+   if (!ok)
+      cout << "FEL: det platta trdet stmmer inte." << endl;
+   return ok;
+}
+
+//! Finds the deepest primitive whose parent is not the root.
+struct Deep_Finder : public CSG_Visitor<CSG_Node>
+{
+   Deep_Finder() : depth(0), deepest(NULL), deepest_depth(0) {}
+
+   bool enter(CSG_Node *tree)
+   {
+      depth++;
+      if(tree->get_type() == CSG_Node::PRIMITIVE && depth > 2 &&
+         depth > deepest_depth)
+      {
+         deepest = tree;
+         deepest_depth = depth;
+      }
+      return true;
+   }
+
+   void leave(CSG_Node *)
+   {
+      depth--;
+   }
+
+   int depth;
+   CSG_Node *deepest;
+   int deepest_depth;
+};
+
+/*!
+ * Edits a copy of tree like the modeler does, and checks that every
+ * version costs no more DAG nodes than the path to the change is long,
+ * and that undo and redo bring back the same trees.
+ */
+bool test_history(const CSG_Node *tree)
+{
+   if(tree->get_type() == CSG_Node::PRIMITIVE)
+      return true;
+
+   CSG_History history;
+   CSG_Node *copy = new CSG_Node(*tree);
+   history.clear(copy);
+   string versions[3];
+   versions[0] = copy->stringify();
+   unsigned long nodes = history.get_dag().size();
+   bool ok = true;
+
+   // Add a primitive at the top, which only costs the new union.
+   CSG_Node *leaf = copy;
+   while(leaf->get_type() != CSG_Node::PRIMITIVE)
+      leaf = leaf->get_left();
+   copy = CSG_Node::create_and_insert(CSG_Node::UNION, copy,
+                                      new CSG_Node(leaf->get_object()));
+   history.record(copy);
+   versions[1] = copy->stringify();
+   ok = history.get_dag().size() <= nodes + 1 && ok;
+   nodes = history.get_dag().size();
+
+   // Delete the deepest primitive, which costs the path above it.
+   Deep_Finder finder;
+   visit_tree(copy, finder);
+   history.invalidate(finder.deepest);
+   CSG_Node *parent = finder.deepest->get_parent();
+   if(parent->get_left() == finder.deepest)
+      delete parent->detach_left();
+   else
+      delete parent->detach_right();
+   history.record(copy);
+   versions[2] = copy->stringify();
+   ok = history.get_dag().size() <= nodes + finder.deepest_depth && ok;
+
+   for(int v = 1; v >= 0; --v)
+   {
+      CSG_Node *old = copy;
+      ok = history.undo(copy) && copy->stringify() == versions[v] && ok;
+      delete old;
+   }
+   ok = !history.can_undo() && ok;
+   for(int v = 1; v <= 2; ++v)
+   {
+      CSG_Node *old = copy;
+      ok = history.redo(copy) && copy->stringify() == versions[v] && ok;
+      delete old;
+   }
+   ok = !history.can_redo() && history.size() == 3 && ok;
+
+   cout << "Historik: " << history.size() << " versioner i "
+        << history.get_dag().size() << " noder." << endl;
+   delete copy;
+
+   if(!ok)
+      cout << "FEL: historiken stmmer inte." << endl;
+   return ok;
+}
+
+//! Computes the box of a tree from the objects, without any caching.
+Bounding_Box fresh_bounds(const CSG_Node *tree)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      return tree->get_object()->get_bounds();
+
+   Bounding_Box box = fresh_bounds(tree->get_left());
+   Bounding_Box right = fresh_bounds(tree->get_right());
+   if (tree->get_type() == CSG_Node::UNION)
+   {
+      if (box.is_empty())
+         box = right;
+      else if (!right.is_empty())
+         box.unite(right);
+   }
+   else if (tree->get_type() == CSG_Node::INTERSECTION)
+      box.intersect(right);
+   return box;
+}
+
+//! Lists the objects that a query should find, the slow way.
+template <class Test>
+void slow_query(const CSG_Node *tree, const Test &test,
+                vector<CSG_Object *> &found)
+{
+   if (!test(fresh_bounds(tree)))
+      return;
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      found.push_back(tree->get_object());
+   else
+   {
+      slow_query(tree->get_left(), test, found);
+      slow_query(tree->get_right(), test, found);
+   }
+}
+
+struct Box_Overlap
+{
+   bool operator()(const Bounding_Box &b) const { return box.overlaps(b); }
+   Bounding_Box box;
+};
+
+struct Ray_Hit
+{
+   bool operator()(const Bounding_Box &b) const
+   {
+      return b.hit_by_ray(origin, direction);
+   }
+   GLfloat origin[3], direction[3];
+};
+
+struct Frustum_Overlap
+{
+   Frustum_Overlap() : frustum(Matrix()) {}
+   bool operator()(const Bounding_Box &b) const { return frustum.overlaps(b); }
+   Frustum frustum;
+};
+
+//! True if a query found the same primitives as slow_query().
+bool same_objects(const vector<const CSG_Node *> &nodes,
+                  const vector<CSG_Object *> &objects)
+{
+   if (nodes.size() != objects.size())
+      return false;
+   for (unsigned int i = 0; i < nodes.size(); ++i)
+      if (nodes[i]->get_object() != objects[i])
+         return false;
+   return true;
+}
+
+//! Lists the objects of a tree, each once.
+struct Object_Lister : public CSG_Visitor<const CSG_Node>
+{
+   void leave(const CSG_Node *tree)
+   {
+      if (tree->get_type() == CSG_Node::PRIMITIVE)
+         objects.insert(tree->get_object());
+   }
+
+   set<CSG_Object *> objects;
+};
+
+/*!
+ * Checks that the store has the inverse transformation of every object in
+ * tree, and that it finds the same objects of tree in box as their own
+ * boxes say.
+ */
+bool test_store(const CSG_Node *tree, const Bounding_Box &box)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   bool ok = true;
+
+   set<CSG_Object *> expected;
+   set<CSG_Object *>::const_iterator i;
+   for (i = lister.objects.begin(); i != lister.objects.end(); ++i)
+   {
+      Matrix product = (*i)->get_inverse() * (*i)->get_transform();
+      for (int j = 0; j < 16; ++j)
+         ok = fabs(product.data[j] - identity_matrix[j]) < 1e-3 && ok;
+      if ((*i)->get_bounds().overlaps(box))
+         expected.insert(*i);
+   }
+
+   vector<CSG_Object *> found;
+   primitive_store().find_in_box(box, found);
+   set<CSG_Object *> found_in_tree;
+   for (unsigned int j = 0; j < found.size(); ++j)
+      if (lister.objects.count(found[j]))
+         found_in_tree.insert(found[j]);
+   ok = found_in_tree == expected && ok;
+
+   if (!ok)
+      cout << "FEL: primitivlagret stmmer inte." << endl;
+   return ok;
+}
+
+/*!
+ * Checks that the cached boxes of the nodes follow an object that moves,
+ * and that the queries find what they should.
+ */
+bool test_bounds(const CSG_Node *tree)
+{
+   Bounding_Box box = tree->get_bounds();
+   bool ok = box.stringify() == fresh_bounds(tree).stringify();
+
+   CSG_Node *leaf = const_cast<CSG_Node *>(tree);
+   while (leaf->get_type() != CSG_Node::PRIMITIVE)
+      leaf = leaf->get_right();
+   CSG_Object *object = leaf->get_object();
+   Matrix transform = object->get_transform();
+   object->set_transform(translate(100, 0, 0) * transform);
+   ok = tree->get_bounds().stringify() == fresh_bounds(tree).stringify() && ok;
+   object->set_transform(transform);
+   ok = tree->get_bounds().stringify() == box.stringify() && ok;
+
+   vector<const CSG_Node *> found;
+   vector<CSG_Object *> expected;
+   unsigned int counts[3];
+
+   // A box around the middle of the scene.
+   Box_Overlap overlap;
+   for (int i = 0; i < 3; ++i)
+   {
+      GLfloat middle = (box.min[i] + box.max[i]) / 2;
+      overlap.box.min[i] = middle - 0.5;
+      overlap.box.max[i] = middle + 0.5;
+   }
+   find_in_box(tree, overlap.box, found);
+   slow_query(tree, overlap, expected);
+   ok = same_objects(found, expected) && ok;
+   counts[0] = found.size();
+   ok = test_store(tree, overlap.box) && ok;
+
+   // A ray through the middle of the scene, along the Z axis.
+   Ray_Hit ray;
+   for (int i = 0; i < 3; ++i)
+   {
+      ray.origin[i] = (box.min[i] + box.max[i]) / 2;
+      ray.direction[i] = 0;
+   }
+   ray.origin[2] = box.max[2] + 10;
+   ray.direction[2] = -1;
+   find_on_ray(tree, ray.origin, ray.direction, found);
+   expected.clear();
+   slow_query(tree, ray, expected);
+   ok = same_objects(found, expected) && ok;
+   counts[1] = found.size();
+
+   // The frustum of the identity matrix is the cube from -1 to 1.
+   Frustum_Overlap frustum;
+   find_in_frustum(tree, frustum.frustum, found);
+   expected.clear();
+   slow_query(tree, frustum, expected);
+   ok = same_objects(found, expected) && ok;
+   counts[2] = found.size();
+
+   cout << "Grnser: " << counts[0] << " i ldan, " << counts[1]
+        << " p strlen, " << counts[2] << " i synfltet." << endl;
+   if (!ok)
+      cout << "FEL: grnserna stmmer inte." << endl;
+   return ok;
+}
+
+//! The objects whose own boxes pass test, the slow way.
+template <class Test>
+set<CSG_Object *> slow_objects(const set<CSG_Object *> &objects,
+                               const Test &test)
+{
+   set<CSG_Object *> found;
+   set<CSG_Object *>::const_iterator i;
+   for (i = objects.begin(); i != objects.end(); ++i)
+      if (test((*i)->get_bounds()))
+         found.insert(*i);
+   return found;
+}
+
+//! True if a query of index found the objects in expected, each once.
+bool same_set(const vector<CSG_Object *> &found,
+              const set<CSG_Object *> &expected)
+{
+   set<CSG_Object *> found_set(found.begin(), found.end());
+   return found.size() == found_set.size() && found_set == expected;
+}
+
+/*!
+ * Builds a Spatial_Index over the objects of tree, both at once and one at
+ * a time, and checks its queries against the boxes of all objects, also
+ * after an object has moved away and back.
+ */
+bool test_index(const CSG_Node *tree)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   vector<CSG_Object *> objects(lister.objects.begin(), lister.objects.end());
+   Spatial_Index built, inserted;
+   built.build(objects);
+   for (unsigned int i = objects.size(); i-- > 0;)
+      inserted.insert(objects[i]);
+   bool ok = built.size() == objects.size() &&
+      inserted.size() == objects.size();
+
+   Bounding_Box box = tree->get_bounds();
+   Box_Overlap overlap;
+   Ray_Hit ray;
+   for (int i = 0; i < 3; ++i)
+   {
+      GLfloat middle = (box.min[i] + box.max[i]) / 2;
+      overlap.box.min[i] = middle - 0.5;
+      overlap.box.max[i] = middle + 0.5;
+      ray.origin[i] = middle;
+      ray.direction[i] = i + 1;
+   }
+   Frustum_Overlap frustum;
+
+   CSG_Object *object = objects.front();
+   Matrix transform = object->get_transform();
+   vector<CSG_Object *> found;
+   for (int step = 0; step < 3; ++step)
+   {
+      // Away from the rest of the scene, and back again.
+      if (step == 1)
+         object->set_transform(translate(box.max[0] - box.min[0] + 10, 0, 0) *
+                               transform);
+      else if (step == 2)
+         object->set_transform(transform);
+      built.moved(object);
+      inserted.moved(object);
+
+      for (int i = 0; i < 2; ++i)
+      {
+         const Spatial_Index &index = i ? inserted : built;
+         index.find_in_box(overlap.box, found);
+         ok = same_set(found, slow_objects(lister.objects, overlap)) && ok;
+         index.find_on_ray(ray.origin, ray.direction, found);
+         ok = same_set(found, slow_objects(lister.objects, ray)) && ok;
+         index.find_in_frustum(frustum.frustum, found);
+         ok = same_set(found, slow_objects(lister.objects, frustum)) && ok;
+         index.find_in_box(object->get_bounds(), found);
+         ok = find(found.begin(), found.end(), object) != found.end() && ok;
+      }
+   }
+
+   vector<pair<CSG_Object *, CSG_Object *> > pairs;
+   built.find_overlaps(pairs);
+   unsigned int expected = 0;
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      for (unsigned int j = i + 1; j < objects.size(); ++j)
+         expected += objects[i]->get_bounds().overlaps(objects[j]->get_bounds());
+   ok = pairs.size() == expected && ok;
+
+   built.remove(object);
+   built.find_in_box(object->get_bounds(), found);
+   ok = find(found.begin(), found.end(), object) == found.end() && ok;
+   ok = !built.contains(object) && built.size() == objects.size() - 1 && ok;
+
+   cout << "Index: hjd " << built.height() << ", " << pairs.size()
+        << " verlappande par." << endl;
+   if (!ok)
+      cout << "FEL: indexet stmmer inte." << endl;
+   return ok;
+}
+
+//! True if the graph has exactly the edges that the boxes of objects say.
+bool graph_matches(const Overlap_Graph &graph,
+                   const vector<CSG_Object *> &objects)
+{
+   unsigned long edges = 0;
+   bool ok = graph.size() == objects.size();
+   for (unsigned int i = 0; i < objects.size(); ++i)
+   {
+      set<CSG_Object *> expected;
+      for (unsigned int j = 0; j < objects.size(); ++j)
+         if (j != i &&
+             objects[i]->get_bounds().overlaps(objects[j]->get_bounds()))
+            expected.insert(objects[j]);
+      ok = same_set(graph.neighbours(objects[i]), expected) && ok;
+      edges += expected.size();
+   }
+   return graph.edges() * 2 == edges && ok;
+}
+
+/*!
+ * Builds an Overlap_Graph over the objects of tree, and checks its edges
+ * against the boxes of the objects, also after one of them has moved away
+ * and back, and after one has been removed and inserted again.
+ */
+bool test_overlap_graph(const CSG_Node *tree)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   vector<CSG_Object *> objects(lister.objects.begin(), lister.objects.end());
+   Overlap_Graph graph;
+   graph.assign(objects);
+   bool ok = graph_matches(graph, objects);
+   unsigned long edges = graph.edges();
+
+   CSG_Object *object = objects.back();
+   Matrix transform = object->get_transform();
+   Bounding_Box box = tree->get_bounds();
+   object->set_transform(translate(box.max[0] - box.min[0] + 10, 0, 0) *
+                         transform);
+   graph.moved(object);
+   ok = graph_matches(graph, objects) && graph.neighbours(object).empty() &&
+      ok;
+   object->set_transform(transform);
+   graph.moved(object);
+   ok = graph_matches(graph, objects) && graph.edges() == edges && ok;
+
+   CSG_Object *other = objects.front();
+   const vector<CSG_Object *> &near = graph.neighbours(other);
+   for (unsigned int i = 0; i < near.size(); ++i)
+      ok = graph.overlaps(other, near[i]) && graph.overlaps(near[i], other) &&
+         ok;
+   graph.remove(other);
+   ok = !graph.contains(other) && graph.neighbours(other).empty() && ok;
+   graph.insert(other);
+   ok = graph_matches(graph, objects) && ok;
+
+   cout << "verlappsgrafen: " << graph.size() << " objekt, "
+        << graph.edges() << " kanter." << endl;
+   if (!ok)
+      cout << "FEL: verlappsgrafen stmmer inte." << endl;
+   return ok;
+}
+
+/*!
+ * Checks the meshes of the objects in tree: the vertices must be on the
+ * surface of the unit shape with unit normals, the triangles must face
+ * outwards, the volume must be that of a polyhedron inside the shape, and
+ * objects of the same type and precision must share one mesh.
+ */
+bool test_meshes(const CSG_Node *tree)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   bool ok = true;
+
+   set<CSG_Object *>::const_iterator i;
+   for (i = lister.objects.begin(); i != lister.objects.end(); ++i)
+   {
+      Primitive_Store::Type type = (*i)->get_type();
+      int precision = (*i)->get_precision();
+      const Mesh_Cache::Mesh &mesh = mesh_cache().get(type, precision);
+      ok = &mesh == &mesh_cache().get(type, precision) && ok;
+
+      const GLfloat *v = &mesh.vertices[0];
+      for (unsigned int k = 0; k < mesh.vertices.size(); k += 3)
+      {
+         const GLfloat *p = v + k, *n = &mesh.normals[k];
+         GLfloat radial = sqrt(p[0] * p[0] + p[2] * p[2]);
+         GLfloat surface = 0;
+         if (type == Primitive_Store::CUBE)
+            surface = max(fabs(p[0]), max(fabs(p[1]), fabs(p[2])));
+         else if (type == Primitive_Store::SPHERE)
+            surface = sqrt(radial * radial + p[1] * p[1]);
+         else
+            surface = max(radial, GLfloat(fabs(p[1])));
+         ok = fabs(surface - 0.5) < 1e-5 &&
+            fabs(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] - 1) < 1e-5 && ok;
+      }
+
+      double volume = 0;
+      for (unsigned int k = 0; k < mesh.triangles.size(); k += 3)
+      {
+         const GLfloat *a = v + 3 * mesh.triangles[k];
+         const GLfloat *b = v + 3 * mesh.triangles[k + 1];
+         const GLfloat *c = v + 3 * mesh.triangles[k + 2];
+         double cross[3] = {
+            (b[1] - a[1]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[1] - a[1]),
+            (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]),
+            (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) };
+         double out = cross[0] * (a[0] + b[0] + c[0]) +
+            cross[1] * (a[1] + b[1] + c[1]) + cross[2] * (a[2] + b[2] + c[2]);
+         ok = out > 0 && ok;
+         volume += (a[0] * (b[1] * c[2] - b[2] * c[1]) +
+                    a[1] * (b[2] * c[0] - b[0] * c[2]) +
+                    a[2] * (b[0] * c[1] - b[1] * c[0])) / 6;
+      }
+      double exact = type == Primitive_Store::CUBE ? 1 :
+         type == Primitive_Store::SPHERE ? M_PI / 6 : M_PI / 4;
+      ok = volume > 0 && volume <= exact + 1e-5 && ok;
+
+      for (unsigned int k = 0; k < mesh.lines.size(); ++k)
+         ok = mesh.lines[k] < mesh.vertices.size() / 3 && ok;
+   }
+
+   cout << mesh_cache().size() << " nt i cachen." << endl;
+   if (!ok)
+      cout << "FEL: nten stmmer inte." << endl;
+   return ok;
+}
+
+//! True if the distance between a and b is expected, to within a little.
+static bool distance_is(const CSG_Object *a, const CSG_Object *b,
+                        GLfloat expected)
+{
+   GLfloat d = primitive_distance(a, b);
+   return fabs(d - expected) < 1e-4 &&
+      primitives_overlap(a, b) == (expected == 0);
+}
+
+/*!
+ * Checks the exact tests of convex.h on every pair of objects in tree: the
+ * overlap test must agree with the distance and with the boxes, and a
+ * point that is inside both objects must make them overlap. Then checks a
+ * few distances that are known, and that prune() removes an intersection
+ * and a difference of shapes whose boxes overlap but which do not.
+ */
+bool test_convex(const CSG_Node *tree)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   vector<CSG_Object *> objects(lister.objects.begin(), lister.objects.end());
+   bool ok = true;
+   unsigned long boxes = 0, apart = 0;
+
+   for (unsigned int i = 0; i < objects.size(); ++i)
+   {
+      const Matrix &m = objects[i]->get_transform();
+      const GLfloat centre[3] = { m.data[12], m.data[13], m.data[14] };
+      if (objects[i]->get_inverse().data[15] != 0)
+         ok = primitive_contains(objects[i], centre) && ok;
+
+      for (unsigned int j = i + 1; j < objects.size(); ++j)
+      {
+         bool overlap = primitives_overlap(objects[i], objects[j]);
+         ok = overlap == (primitive_distance(objects[i], objects[j]) == 0) &&
+            ok;
+         Bounding_Box box = objects[i]->get_bounds();
+         if (!box.overlaps(objects[j]->get_bounds()))
+         {
+            ok = !overlap && ok;
+            continue;
+         }
+         boxes++;
+         apart += !overlap;
+
+         box.intersect(objects[j]->get_bounds());
+         GLfloat point[3];
+         for (int x = 0; x < 4; ++x)
+            for (int y = 0; y < 4; ++y)
+               for (int z = 0; z < 4; ++z)
+               {
+                  const int step[3] = { x, y, z };
+                  for (int k = 0; k < 3; ++k)
+                     point[k] = box.min[k] +
+                        (box.max[k] - box.min[k]) * step[k] / 3;
+                  if (primitive_contains(objects[i], point) &&
+                      primitive_contains(objects[j], point))
+                     ok = overlap && ok;
+               }
+      }
+   }
+
+   CSG_Object_Cube cube, turned;
+   CSG_Object_Sphere sphere, far_sphere;
+   CSG_Object_Cylinder cylinder;
+   far_sphere.set_transform(translate(2, 0, 0));
+   ok = distance_is(&sphere, &far_sphere, 1) && ok;
+   turned.set_transform(translate(1.25, 0, 0) * rotate_z(M_PI / 4));
+   ok = distance_is(&cube, &turned, 1.25 - 0.5 - sqrt(0.5)) && ok;
+   turned.set_transform(translate(1.2, 0, 0) * rotate_z(M_PI / 4));
+   ok = distance_is(&cube, &turned, 0) && ok;
+   sphere.set_transform(translate(1.1, 0, 0));
+   ok = distance_is(&sphere, &cylinder, 0.1) && ok;
+   sphere.set_transform(translate(1, 1, 0));
+   ok = distance_is(&sphere, &cylinder, sqrt(0.5) - 0.5) && ok;
+
+   // The boxes overlap in a corner that the sphere does not reach.
+   sphere.set_transform(translate(0.9, 0.9, 0));
+   ok = cube.get_bounds().overlaps(sphere.get_bounds()) &&
+      !primitives_overlap(&cube, &sphere) && ok;
+   CSG_Node *product =
+      CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
+                                  new CSG_Node(&cube), new CSG_Node(&sphere));
+   CSG_Node *difference =
+      CSG_Node::create_and_insert(CSG_Node::DIFFERENCE,
+                                  new CSG_Node(&cube), new CSG_Node(&sphere));
+   CSG_Node *pruned = prune(product);
+   ok = !pruned && ok;
+   pruned = prune(difference);
+   ok = pruned && pruned->get_type() == CSG_Node::PRIMITIVE && ok;
+   delete pruned;
+   delete product;
+   delete difference;
+
+   cout << "Exakta test: " << boxes << " par med verlappande ldor, "
+        << apart << " av dem skilda." << endl;
+   if (!ok)
+      cout << "FEL: de exakta testen stmmer inte." << endl;
+   return ok;
+}
+
+//! Lists the primitive nodes of a tree from left to right.
+struct Primitive_Lister : public CSG_Visitor<CSG_Node>
+{
+   void leave(CSG_Node *tree)
+   {
+      if(tree->get_type() == CSG_Node::PRIMITIVE)
+         primitives.push_back(tree);
+   }
+
+   vector<CSG_Node *> primitives;
+};
+
+//! Checks that registry finds the leftmost node of every object in tree.
+static bool registry_matches(const Primitive_Registry &registry,
+                             CSG_Node *tree)
+{
+   Primitive_Lister lister;
+   visit_tree(tree, lister);
+   bool ok = true;
+   for(unsigned int i = lister.primitives.size(); i-- > 0;)
+   {
+      const CSG_Object *object = lister.primitives[i]->get_object();
+      bool leftmost = true;
+      for(unsigned int j = 0; j < i; ++j)
+         if(lister.primitives[j]->get_object() == object)
+            leftmost = false;
+      if(leftmost)
+         ok = registry.find_node(object) == lister.primitives[i] && ok;
+   }
+   return ok;
+}
+
+/*!
+ * Puts the objects of tree in registry, and checks that it finds their
+ * nodes, also after the tree has been replaced by a copy and back, and
+ * that the handles do not change on the way.
+ */
+bool test_registry(Primitive_Registry &registry, CSG_Node *tree)
+{
+   registry.assign(tree);
+   bool ok = registry_matches(registry, tree);
+
+   vector<Primitive_Registry::Handle> handles(registry.size());
+   for(unsigned int h = 0; h < handles.size(); ++h)
+      ok = registry.find(registry.get_object(h), handles[h]) &&
+         handles[h] == h && ok;
+
+   CSG_Node *copy = new CSG_Node(*tree);
+   registry.assign(copy);
+   ok = registry_matches(registry, copy) && ok;
+   registry.assign(tree);
+   delete copy;
+   ok = registry_matches(registry, tree) && ok;
+
+   for(unsigned int h = 0; h < handles.size(); ++h)
+   {
+      Primitive_Registry::Handle handle;
+      ok = registry.find(registry.get_object(h), handle) &&
+         handle == handles[h] && ok;
+   }
+   ok = registry.size() == handles.size() && ok;
+
+   cout << "Registret: " << registry.size() << " objekt." << endl;
+   if (!ok)
+      cout << "FEL: registret hittar fel noder." << endl;
+   return ok;
+}
+
+//! Normalizes a scene file with both normalizers and compares the results.
+//! The precisions lod picks for objects.
+static vector<int> lod_precisions(const Level_Of_Detail &lod,
+                                  const vector<CSG_Object *> &objects)
+{
+   vector<int> precisions;
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      precisions.push_back(lod.precision(objects[i]));
+   return precisions;
+}
+
+/*!
+ * Picks levels of detail for the objects of tree, seen through camera in
+ * a 640 by 480 window like the modeler's. No object may get a finer level
+ * than its own precision, and all must get coarser ones far away. A small
+ * step back must not make anything coarser than the levels further away,
+ * or finer than before the step, and a vertex budget must lower the count.
+ * A budget that cannot be met must not keep everything coarse once the
+ * objects fit in it again.
+ */
+bool test_lod(const CSG_Node *tree, const Camera &camera)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   vector<CSG_Object *> objects(lister.objects.begin(), lister.objects.end());
+
+   const GLfloat focal = 480 / 2 / 0.75;
+   Matrix look = camera.rotation_matrix *
+      translate(-camera.center_x, -camera.center_y, -camera.center_z);
+   Matrix near = translate(0, 0, -camera.radius) * look;
+   Matrix step = translate(0, 0, -1.05 * camera.radius) * look;
+
+   Level_Of_Detail lod, fresh;
+   lod.set_enabled(true);
+   fresh.set_enabled(true);
+   lod.update(objects, near, focal);
+   vector<int> first = lod_precisions(lod, objects);
+   unsigned long vertices = lod.vertices(), full = lod.full_vertices();
+
+   bool ok = vertices <= full;
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      ok = first[i] <= objects[i]->get_precision() &&
+         (objects[i]->get_type() != Primitive_Store::CUBE ||
+          first[i] == objects[i]->get_precision()) && ok;
+
+   lod.update(objects, step, focal);
+   fresh.update(objects, step, focal);
+   vector<int> stepped = lod_precisions(lod, objects);
+   vector<int> coarser = lod_precisions(fresh, objects);
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      ok = coarser[i] <= stepped[i] && stepped[i] <= first[i] && ok;
+
+   lod.update(objects, translate(0, 0, -1e4) * look, focal);
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      ok = (objects[i]->get_type() == Primitive_Store::CUBE ||
+            lod.precision(objects[i]) <= 3) && ok;
+   lod.update(objects, near, focal);
+   ok = lod_precisions(lod, objects) == first && ok;
+
+   lod.set_vertex_budget(vertices / 2);
+   for (int frame = 0; frame < 20; ++frame)
+      lod.update(objects, near, focal);
+   ok = lod.vertices() <= vertices && ok;
+
+   Level_Of_Detail tight;
+   tight.set_enabled(true);
+   tight.set_vertex_budget(1);
+   for (int frame = 0; frame < 1000; ++frame)
+      tight.update(objects, near, focal);
+   tight.set_vertex_budget(tight.vertices() - 1);
+   for (int frame = 0; frame < 1000; ++frame)
+      tight.update(objects, near, focal);
+   for (int frame = 0; frame < 100; ++frame)
+      tight.update(vector<CSG_Object *>(), near, focal);
+   tight.update(objects, near, focal);
+   ok = lod_precisions(tight, objects) == first && ok;
+   tight.set_tolerance(0.5);
+   tight.update(objects, near, focal);
+   ok = lod_precisions(tight, objects) == first && ok;
+
+   cout << "Detaljniv: " << vertices << " hrn i nten mot " << full
+        << " utan, " << lod.vertices() << " med hlften som budget." << endl;
+   if (!ok)
+      cout << "FEL: detaljniverna stmmer inte." << endl;
+   return ok;
+}
+
+/*!
+ * Checks when the spheres and cylinders of tree can be ray-cast instead of
+ * drawn as meshes: from the camera of the scene unless it is in the
+ * bounding cube, never from the centre of the shape, and always with an
+ * orthographic projection.
+ */
+bool test_impostors(const CSG_Node *tree, const Camera &camera)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+
+   Matrix view = translate(0, 0, -camera.radius) * camera.rotation_matrix *
+      translate(-camera.center_x, -camera.center_y, -camera.center_z);
+   Vector eye = affine_inverse(view) * Vector(0, 0, 0, 1);
+   Matrix perspective, orthographic;
+   perspective.data[11] = -1;
+   perspective.data[15] = 0;
+
+   // The identity puts the eye in the centre of the shape.
+   bool ok = !Impostors::covers(Matrix(), perspective);
+   int round = 0, covered = 0;
+   set<CSG_Object *>::const_iterator i;
+   for (i = lister.objects.begin(); i != lister.objects.end(); ++i)
+   {
+      if ((*i)->get_type() == Primitive_Store::CUBE)
+         continue;
+      Matrix modelview = view * (*i)->get_transform();
+      Vector local = (*i)->get_inverse() * eye;
+      bool outside = false;
+      for (int k = 0; k < 3; ++k)
+         outside = fabs(local.data[k]) > 0.6 || outside;
+      bool covers = Impostors::covers(modelview, perspective);
+      ok = (covers || !outside) &&
+         Impostors::covers(modelview, orthographic) && ok;
+      ++round;
+      covered += covers;
+   }
+
+   cout << covered << " av " << round << " klot och cylindrar kan "
+        << "strlfljas frn kameran." << endl;
+   if (!ok)
+      cout << "FEL: strlfljningen stmmer inte." << endl;
+   return ok;
+}
+
+//! The corners of a triangle, starting with the smallest, so that equal
+//! triangles compare equal whatever their vertices are numbered.
+static vector<GLfloat> triangle_corners(const Mesh_Cache::Mesh &mesh,
+                                        const GLuint *triangle)
+{
+   vector<GLfloat> corners[3];
+   for (int c = 0; c < 3; ++c)
+      for (int k = 0; k < 3; ++k)
+      {
+         corners[c].push_back(mesh.vertices[3 * triangle[c] + k]);
+         corners[c].push_back(mesh.normals[3 * triangle[c] + k]);
+      }
+   int start = min_element(corners, corners + 3) - corners;
+   vector<GLfloat> result;
+   for (int c = 0; c < 3; ++c)
+      result.insert(result.end(), corners[(start + c) % 3].begin(),
+                    corners[(start + c) % 3].end());
+   return result;
+}
+
+/*!
+ * Checks that the meshes of the objects in tree have the same triangles,
+ * facing the same way, when they are ordered for the vertex cache as when
+ * they are not, and that the order misses the cache less often.
+ */
+bool test_vertex_cache(const CSG_Node *tree)
+{
+   Object_Lister lister;
+   visit_tree(tree, lister);
+   Mesh_Cache unoptimized;
+   unoptimized.set_optimize(false);
+
+   const unsigned int CACHE = 16;
+   bool ok = true;
+   double before = 0, after = 0;
+   unsigned long triangles = 0;
+   set<pair<int, int> > seen;
+   set<CSG_Object *>::const_iterator i;
+   for (i = lister.objects.begin(); i != lister.objects.end(); ++i)
+   {
+      Primitive_Store::Type type = (*i)->get_type();
+      int precision = (*i)->get_precision();
+      if (!seen.insert(make_pair(type, precision)).second)
+         continue;
+      const Mesh_Cache::Mesh &a = unoptimized.get(type, precision);
+      const Mesh_Cache::Mesh &b = mesh_cache().get(type, precision);
+
+      vector<vector<GLfloat> > in_a, in_b;
+      for (unsigned int k = 0; k < a.triangles.size(); k += 3)
+         in_a.push_back(triangle_corners(a, &a.triangles[k]));
+      for (unsigned int k = 0; k < b.triangles.size(); k += 3)
+         in_b.push_back(triangle_corners(b, &b.triangles[k]));
+      sort(in_a.begin(), in_a.end());
+      sort(in_b.begin(), in_b.end());
+      ok = in_a == in_b && a.lines.size() == b.lines.size() && ok;
+
+      double miss_a = cache_miss_ratio(a.triangles, CACHE);
+      double miss_b = cache_miss_ratio(b.triangles, CACHE);
+      ok = miss_b <= miss_a && ok;
+      before += miss_a * a.triangles.size() / 3;
+      after += miss_b * b.triangles.size() / 3;
+      triangles += b.triangles.size() / 3;
+   }
+
+   if (triangles)
+      cout << "Omvandlade hrn per triangel med " << CACHE << " i cachen: "
+           << before / triangles << " fre, " << after / triangles
+           << " efter." << endl;
+   if (!ok)
+      cout << "FEL: nten fr hrncachen stmmer inte." << endl;
+   return ok;
+}
+
+bool test_scene(const string &filename)
+{
+   // Declared first, so that it deletes the objects after the trees.
+   Primitive_Registry registry;
+   list<CSG_Object *> objects;
+   Camera camera;
+   CSG_Node *tree = load(filename, objects, camera);
+   if (!tree)
+   {
+      cout << filename << ": kunde inte laddas!" << endl;
+      return false;
+   }
+
+   normalize_counter = 0;
+   CSG_Node *ntree = normalize(tree);
+   int tree_counter = normalize_counter;
+
+   // A cutoff of 1 hands every union operand to another thread.
+   Thread_Pool pool(3);
+   normalize_counter = 0;
+   CSG_Node *ptree = normalize_parallel(tree, pool, 1);
+   bool parallel = ptree->stringify() == ntree->stringify() &&
+      normalize_counter == tree_counter;
+   delete ptree;
+
+   Normalize_Stats stats;
+   normalize_counter = 0;
+   CSG_Node *stree = normalize_shared(tree, &stats);
+
+   bool same = ntree->stringify() == stree->stringify();
+   cout << filename << ": " << tree_counter << "/" << normalize_counter
+        << " normaliseringar, " << stats.allocations << " allokeringar, "
+        << stats.peak_nodes << " noder som mest, " << stats.shared
+        << " delade" << endl;
+   cout << (same ? "Samma" : "FEL: olika") << " summa av produkter." << endl;
+   if (!parallel)
+      cout << "FEL: parallell normalisering gav ett annat trd." << endl;
+   same = parallel && same;
+   same = test_prune(tree, ntree) && same;
+   same = test_product_list(ntree) && same;
+   same = test_stream(tree, ntree) && same;
+   same = test_restructure(tree, ntree) && same;
+   same = test_arena(tree, ntree) && same;
+   same = test_flat(tree, ntree) && same;
+   same = test_history(tree) && same;
+   same = test_registry(registry, tree) && same;
+   same = test_bounds(tree) && same;
+   same = test_index(tree) && same;
+   same = test_overlap_graph(tree) && same;
+   same = test_convex(tree) && same;
+   same = test_meshes(tree) && same;
+   same = test_vertex_cache(tree) && same;
+   same = test_lod(tree, camera) && same;
+   same = test_impostors(tree, camera) && same;
+   // test_components() moves the objects back and forth, which rounds
+   // their transformations, so the cache must be tested before.
+   same = test_cache(tree, filename) && same;
+   same = test_components(tree, ntree) && same;
+
+   delete tree;
+   delete ntree;
+   delete stree;
+   return same;
+}
+
+/*!
+ * Builds a left-deep tree of n spheres in a row along the X axis, with
+ * differences at the bottom and unions at the top, and checks that it can
+ * be copied, saved, loaded, normalized, streamed, pruned and grouped without
+ * running out of stack.
+ */
+bool test_deep(int n)
+{
+   list<CSG_Object *> objects;
+   CSG_Node *tree = NULL;
+   for (int i = 0; i < n; ++i)
+   {
+      CSG_Object *object = new CSG_Object_Sphere();
+      object->set_transform(translate(2 * i, 0, 0));
+      objects.push_back(object);
+      CSG_Node *leaf = new CSG_Node(object);
+      if (!tree)
+         tree = leaf;
+      else
+         tree = CSG_Node::create_and_insert(i <= n / 2 ? CSG_Node::DIFFERENCE :
+                                            CSG_Node::UNION, tree, leaf);
+   }
+   // The differences make one product, and every union operand another.
+   unsigned int products = n - n / 2;
+
+   CSG_Node *copy = new CSG_Node(*tree);
+   bool ok = copy->stringify() == tree->stringify();
+   delete copy;
+
+   const string filename = "normalize_test.scs";
+   list<CSG_Object *> loaded_objects;
+   Camera camera;
+   CSG_Node *loaded = NULL;
+   if (save(filename, tree, camera) == 0)
+      loaded = load(filename, loaded_objects, camera);
+   remove(filename.c_str());
+   ok = loaded && loaded->structural_hash() == tree->structural_hash() && ok;
+   delete loaded;
+   while (!loaded_objects.empty())
+   {
+      delete loaded_objects.front();
+      loaded_objects.pop_front();
+   }
+
+   // The tree is already normalized.
+   CSG_Node *stree = normalize_shared(tree);
+   ok = stree->stringify() == tree->stringify() && ok;
+   delete stree;
+
+   Product_List list;
+   ok = list.assign(tree) && list.products.size() == products && ok;
+
+   // Every product walks down the unions from the root, so stop early.
+   const unsigned int limit = 1000;
+   Product_Stream stream(tree, limit);
+   unsigned int streamed = 0;
+   while (stream.next(list))
+      ++streamed;
+   ok = stream.estimate() == products && streamed == limit &&
+      stream.truncated() && ok;
+
+   // No sphere touches another, so all subtrahends are pruned away.
+   Prune_Stats stats;
+   CSG_Node *ptree = prune(tree, &stats);
+   ok = ptree && list.assign(ptree) && list.products.size() == products &&
+      list.primitives.size() == products && ok;
+   delete ptree;
+
+   Incremental_Normalizer normalizer;
+   Component_Set components(normalizer);
+   components.assign(tree);
+   ok = components.size() == products &&
+      components.get_products().products.size() == products && ok;
+
+   cout << "Djupt trd med " << n << " primitiver: " << products
+        << " produkter, " << components.size() << " komponenter." << endl;
+   if (!ok)
+      cout << "FEL: det djupa trdet gick inte igenom." << endl;
+
+   components.clear();
+   delete tree;
+   while (!objects.empty())
+   {
+      delete objects.front();
+      objects.pop_front();
+   }
+   return ok;
+}
+
+int main(int argc, char **argv)
+{
+   if (argc > 1)
+   {
+      bool ok = true;
+      for (int i = 1; i < argc; ++i)
+      {
+         if (string(argv[i]) == "--deep")
+            ok = test_deep(100000) && ok;
+         else
+            ok = test_scene(argv[i]) && ok;
+      }
+      return ok ? 0 : 1;
+   }
+
    string before;
 
    cout << "Testa (omvnd polsk notation, avsluta med \".\")" << endl;
@@ -134,7 +1532,29 @@ int main()
       compare_trees(tree, ntree);
       cout << "Simon r " << (is_simon_normal(ntree)?"":"inte ") << "normal!" << endl;
 
+      CSG_Node *stree = normalize_shared(tree);
+      if (get_desc(stree) != get_desc(ntree))
+         cout << "Fel: delad normalisering gav " << get_desc(stree) << "!" << endl;
+
+      test_restructure(tree, ntree);
+      test_flat(tree, ntree);
+      CSG_Node *rtree = restructure(tree);
+      if (rtree)
+      {
+         cout << "Omstrukturerat: " << get_desc(rtree) << endl;
+         compare_trees(tree, rtree);
+         delete rtree;
+      }
+      else
+         cout << "Omstrukturerat: tomt" << endl;
+
+      CSG_Node *ptree = stream_tree(tree);
+      cout << "Strmmen gav " << count_products(ptree) << " produkter." << endl;
+      compare_trees(tree, ptree);
+      delete ptree;
+
       delete tree;
       delete ntree;
+      delete stree;
    }
 }
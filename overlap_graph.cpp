@@ -0,0 +1,177 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file overlap_graph.cpp
+ * Implementation of the overlap graph.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include "debug.h"
+#include "overlap_graph.h"
+
+using namespace std;
+
+//! The neighbours of objects that are not in the graph.
+static const vector<CSG_Object *> no_neighbours;
+
+//! Removes one occurrence of object from list, without keeping the order.
+static void drop(vector<CSG_Object *> &list, const CSG_Object *object)
+{
+   vector<CSG_Object *>::iterator i = find(list.begin(), list.end(), object);
+   if(i == list.end())
+      return;
+   *i = list.back();
+   list.pop_back();
+}
+
+Overlap_Graph::Overlap_Graph() :
+   _edges(0)
+{
+}
+
+void Overlap_Graph::assign(const vector<CSG_Object *> &objects)
+{
+   clear();
+   _index.build(objects);
+
+   for(unsigned int i = 0; i < objects.size(); ++i)
+   {
+      Primitive_Store::Slot slot = objects[i]->get_slot();
+      if(slot >= _neighbours.size())
+         _neighbours.resize(slot + 1);
+   }
+
+   vector<pair<CSG_Object *, CSG_Object *> > pairs;
+   _index.find_overlaps(pairs);
+   for(unsigned int i = 0; i < pairs.size(); ++i)
+   {
+      _neighbours[pairs[i].first->get_slot()].push_back(pairs[i].second);
+      _neighbours[pairs[i].second->get_slot()].push_back(pairs[i].first);
+   }
+   _edges = pairs.size();
+
+   DBG(cout << "Overlap_Graph::assign: " << size() << " objects, " << _edges
+            << " edges" << endl);
+}
+
+void Overlap_Graph::insert(CSG_Object *object)
+{
+   if(_index.contains(object))
+      return;
+   _index.insert(object);
+   Primitive_Store::Slot slot = object->get_slot();
+   if(slot >= _neighbours.size())
+      _neighbours.resize(slot + 1);
+   link(object);
+}
+
+void Overlap_Graph::remove(const CSG_Object *object)
+{
+   if(!_index.contains(object))
+      return;
+   unlink(object);
+   _index.remove(object);
+}
+
+void Overlap_Graph::moved(const CSG_Object *object)
+{
+   if(!_index.contains(object))
+      return;
+   unlink(object);
+   _index.moved(object);
+   link(const_cast<CSG_Object *>(object));
+}
+
+//! Adds the edges from object to everything its box overlaps.
+void Overlap_Graph::link(CSG_Object *object)
+{
+   vector<CSG_Object *> found;
+   _index.find_in_box(object->get_bounds(), found);
+   vector<CSG_Object *> &mine = _neighbours[object->get_slot()];
+   for(unsigned int i = 0; i < found.size(); ++i)
+      if(found[i] != object)
+      {
+         mine.push_back(found[i]);
+         _neighbours[found[i]->get_slot()].push_back(object);
+         _edges++;
+      }
+}
+
+//! Removes all edges of object.
+void Overlap_Graph::unlink(const CSG_Object *object)
+{
+   vector<CSG_Object *> &mine = _neighbours[object->get_slot()];
+   for(unsigned int i = 0; i < mine.size(); ++i)
+      drop(_neighbours[mine[i]->get_slot()], object);
+   _edges -= mine.size();
+   mine.clear();
+}
+
+void Overlap_Graph::clear()
+{
+   _index.clear();
+   _neighbours.clear();
+   _edges = 0;
+}
+
+bool Overlap_Graph::contains(const CSG_Object *object) const
+{
+   return _index.contains(object);
+}
+
+const vector<CSG_Object *> &
+Overlap_Graph::neighbours(const CSG_Object *object) const
+{
+   if(!_index.contains(object))
+      return no_neighbours;
+   return _neighbours[object->get_slot()];
+}
+
+bool Overlap_Graph::overlaps(const CSG_Object *a, const CSG_Object *b) const
+{
+   const vector<CSG_Object *> &na = neighbours(a);
+   const vector<CSG_Object *> &nb = neighbours(b);
+   // Look in the shorter list.
+   if(na.size() <= nb.size())
+      return find(na.begin(), na.end(), b) != na.end();
+   return find(nb.begin(), nb.end(), a) != nb.end();
+}
+
+unsigned int Overlap_Graph::size() const
+{
+   return _index.size();
+}
+
+unsigned long Overlap_Graph::edges() const
+{
+   return _edges;
+}
+
+const Spatial_Index &Overlap_Graph::get_index() const
+{
+   return _index;
+}
@@ -0,0 +1,103 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file overlap_graph.h
+ * Which primitives overlap which, kept up to date as they move.
+ */
+
+#ifndef __OVERLAP_GRAPH_H__
+#define __OVERLAP_GRAPH_H__
+
+#include <vector>
+#include "csg_object.h"
+#include "spatial_index.h"
+
+/*!
+ * A graph with an edge between every two objects whose world-space boxes
+ * overlap. The neighbours of an object are kept in a list indexed by its
+ * slot in primitive_store(), so asking for them costs nothing.
+ *
+ * When an object has moved, moved() only drops the edges of that object
+ * and finds its new neighbours in a Spatial_Index, so the cost depends on
+ * how many neighbours it had and has, not on the size of the scene.
+ * As with Spatial_Index, moved() must be called after every change of
+ * the transformation of an object in the graph, and an object must be
+ * removed before it is deleted.
+ */
+class Overlap_Graph
+{
+public:
+   Overlap_Graph();
+
+   //! Replaces the contents with objects and the edges between them.
+   void assign(const std::vector<CSG_Object *> &objects);
+
+   //! Adds an object and its edges. Adding an object twice does nothing.
+   void insert(CSG_Object *object);
+
+   //! Removes an object and its edges. Does nothing if it is not there.
+   void remove(const CSG_Object *object);
+
+   //! Updates the edges of object after it has been moved.
+   void moved(const CSG_Object *object);
+
+   void clear();
+
+   bool contains(const CSG_Object *object) const;
+
+   /*!
+    * The objects whose boxes overlap the box of object, in no particular
+    * order. Empty if object is not in the graph. The reference is good
+    * until the graph is changed.
+    */
+   const std::vector<CSG_Object *> &neighbours(const CSG_Object *object) const;
+
+   //! True if there is an edge between a and b.
+   bool overlaps(const CSG_Object *a, const CSG_Object *b) const;
+
+   //! Number of objects.
+   unsigned int size() const;
+
+   //! Number of edges.
+   unsigned long edges() const;
+
+   //! The index that finds the neighbours, for other spatial queries.
+   const Spatial_Index &get_index() const;
+
+private:
+   Overlap_Graph(const Overlap_Graph &);
+   void operator=(const Overlap_Graph &);
+
+   void link(CSG_Object *object);
+   void unlink(const CSG_Object *object);
+
+   Spatial_Index _index;
+   //! Neighbours of the object in each store slot.
+   std::vector<std::vector<CSG_Object *> > _neighbours;
+   unsigned long _edges;
+};
+
+#endif
@@ -0,0 +1,163 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file primitive_registry.cpp
+ * Implementation of the object registry.
+ */
+
+#include <cassert>
+#include "csg_visitor.h"
+#include "primitive_registry.h"
+
+using namespace std;
+
+static const unsigned int INITIAL_BUCKETS = 64;
+
+Primitive_Registry::Primitive_Registry() :
+   _buckets(INITIAL_BUCKETS, 0)
+{
+}
+
+Primitive_Registry::~Primitive_Registry()
+{
+   clear();
+}
+
+//! The bucket that object is in, or the empty one where it would be.
+unsigned int Primitive_Registry::bucket(const CSG_Object *object) const
+{
+   // The low bits of an address are the same for every object.
+   unsigned long hash = (unsigned long)object;
+   hash = (hash >> 4) * 2654435761UL;
+
+   unsigned int mask = _buckets.size() - 1;
+   unsigned int b = (hash ^ (hash >> 16)) & mask;
+   while(_buckets[b] && _entries[_buckets[b] - 1].object != object)
+      b = (b + 1) & mask;
+   return b;
+}
+
+void Primitive_Registry::grow()
+{
+   vector<Handle> old(2 * _buckets.size(), 0);
+   _buckets.swap(old);
+   for(Handle h = 0; h < _entries.size(); ++h)
+      _buckets[bucket(_entries[h].object)] = h + 1;
+}
+
+Primitive_Registry::Handle Primitive_Registry::add(CSG_Object *object,
+                                                   CSG_Node *node)
+{
+   unsigned int b = bucket(object);
+   if(_buckets[b])
+   {
+      _entries[_buckets[b] - 1].node = node;
+      return _buckets[b] - 1;
+   }
+
+   Entry entry = { object, node };
+   _entries.push_back(entry);
+   _buckets[b] = _entries.size();
+   if(2 * _entries.size() > _buckets.size())
+      grow();
+   return _entries.size() - 1;
+}
+
+bool Primitive_Registry::find(const CSG_Object *object, Handle &handle) const
+{
+   unsigned int b = bucket(object);
+   if(!_buckets[b])
+      return false;
+   handle = _buckets[b] - 1;
+   return true;
+}
+
+CSG_Node *Primitive_Registry::find_node(const CSG_Object *object) const
+{
+   Handle handle;
+   return find(object, handle) ? _entries[handle].node : NULL;
+}
+
+CSG_Object *Primitive_Registry::get_object(Handle handle) const
+{
+   assert(handle < _entries.size());
+   return _entries[handle].object;
+}
+
+CSG_Node *Primitive_Registry::get_node(Handle handle) const
+{
+   assert(handle < _entries.size());
+   return _entries[handle].node;
+}
+
+void Primitive_Registry::set_node(Handle handle, CSG_Node *node)
+{
+   assert(handle < _entries.size());
+   _entries[handle].node = node;
+}
+
+//! Registers the leftmost node of every object in a tree.
+struct Node_Registrar : public CSG_Visitor<CSG_Node>
+{
+   explicit Node_Registrar(Primitive_Registry &registry) : registry(registry) {}
+
+   void leave(CSG_Node *tree)
+   {
+      if(tree->get_type() != CSG_Node::PRIMITIVE)
+         return;
+      Primitive_Registry::Handle handle;
+      if(!registry.find(tree->get_object(), handle))
+         registry.add(tree->get_object(), tree);
+      else if(!registry.get_node(handle))
+         registry.set_node(handle, tree);
+   }
+
+   Primitive_Registry &registry;
+};
+
+void Primitive_Registry::assign(CSG_Node *tree)
+{
+   for(Handle h = 0; h < _entries.size(); ++h)
+      _entries[h].node = NULL;
+   if(!tree)
+      return;
+
+   Node_Registrar registrar(*this);
+   visit_tree(tree, registrar);
+}
+
+void Primitive_Registry::clear()
+{
+   for(Handle h = 0; h < _entries.size(); ++h)
+      delete _entries[h].object;
+   _entries.clear();
+   _buckets.assign(INITIAL_BUCKETS, 0);
+}
+
+unsigned int Primitive_Registry::size() const
+{
+   return _entries.size();
+}
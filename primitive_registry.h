@@ -0,0 +1,122 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file primitive_registry.h
+ * Constant time lookup from objects to the nodes that hold them.
+ */
+
+#ifndef __PRIMITIVE_REGISTRY_H__
+#define __PRIMITIVE_REGISTRY_H__
+
+#include <vector>
+#include "csg_tree.h"
+#include "csg_object.h"
+
+/*!
+ * Owns the objects of a scene, and knows the node that holds each of them
+ * in the scene tree.
+ *
+ * Every object gets a handle, which stays the same until clear(). The
+ * objects are found by address in a hash table, so finding the node of an
+ * object does not walk the tree. Moving nodes around with
+ * CSG_Node::create_and_insert() and the detach functions does not change
+ * which node holds an object, but whoever deletes a primitive node must
+ * tell the registry with set_node(), and whoever replaces the whole tree
+ * must call assign().
+ *
+ * An object can be in the registry without being in the tree, e.g. after
+ * it has been deleted from the tree but can still come back by undo. If an
+ * object is in the tree more than once, the leftmost node is the one that
+ * is remembered.
+ */
+class Primitive_Registry
+{
+public:
+   typedef unsigned int Handle;
+
+   Primitive_Registry();
+
+   //! Deletes all objects.
+   ~Primitive_Registry();
+
+   /*!
+    * Takes over object, which is held by node, or not in the tree if node
+    * is NULL. An object that is already known keeps its handle, and only
+    * gets its node changed.
+    */
+   Handle add(CSG_Object *object, CSG_Node *node = NULL);
+
+   /*!
+    * Finds the handle of an object.
+    *
+    * \return false if the object is not in the registry.
+    */
+   bool find(const CSG_Object *object, Handle &handle) const;
+
+   //! The node of an object, or NULL if it is not in the tree or unknown.
+   CSG_Node *find_node(const CSG_Object *object) const;
+
+   CSG_Object *get_object(Handle handle) const;
+   CSG_Node *get_node(Handle handle) const;
+
+   //! Changes the node of an object. NULL means that it is not in the tree.
+   void set_node(Handle handle, CSG_Node *node);
+
+   /*!
+    * Makes every object refer to its node in tree, which may be NULL.
+    * Objects in tree that are not known yet are added. Takes time in
+    * proportion to the size of the tree and the number of objects.
+    */
+   void assign(CSG_Node *tree);
+
+   //! Deletes all objects.
+   void clear();
+
+   //! Number of objects.
+   unsigned int size() const;
+
+private:
+   Primitive_Registry(const Primitive_Registry &);
+   void operator=(const Primitive_Registry &);
+
+   unsigned int bucket(const CSG_Object *object) const;
+   void grow();
+
+   struct Entry
+   {
+      CSG_Object *object;
+      CSG_Node *node;
+   };
+
+   std::vector<Entry> _entries;  //!< Indexed by handle.
+   /*!
+    * Open addressing table with linear probing, holding handle + 1 of every
+    * object, or 0 in empty buckets. The size is a power of two.
+    */
+   std::vector<Handle> _buckets;
+};
+
+#endif
@@ -0,0 +1,212 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file primitive_store.cpp
+ * Implementation of the primitive store.
+ */
+
+#include <cmath>
+#include <assert.h>
+#include "primitive_store.h"
+
+using namespace std;
+
+//! The box of the unit cube, from -0.5 to 0.5 along every axis.
+static Bounding_Box cube_bounds(const Matrix &m)
+{
+   Bounding_Box box;
+   for(int corner = 0; corner < 8; ++corner)
+   {
+      Vector v = m * Vector((corner & 1) ? 0.5 : -0.5,
+                            (corner & 2) ? 0.5 : -0.5,
+                            (corner & 4) ? 0.5 : -0.5, 1);
+      box.add_point(v.data[0], v.data[1], v.data[2]);
+   }
+   return box;
+}
+
+/*!
+ * The cylinder is the sum of its axis, which goes from (0, -0.5, 0) to
+ * (0, 0.5, 0), and a disc of radius 0.5 in the XZ plane. Along each world
+ * axis, the transformed disc reaches 0.5 times the length of the
+ * corresponding row of the transformation's X and Z columns.
+ */
+static Bounding_Box cylinder_bounds(const Matrix &m)
+{
+   Bounding_Box box;
+   for(int i = 0; i < 3; ++i)
+   {
+      GLfloat axis = 0.5 * fabs(m.data[4 + i]);
+      GLfloat disc = 0.5 * sqrt(m.data[0 + i] * m.data[0 + i] +
+                                m.data[8 + i] * m.data[8 + i]);
+      box.min[i] = m.data[12 + i] - axis - disc;
+      box.max[i] = m.data[12 + i] + axis + disc;
+   }
+   return box;
+}
+
+/*!
+ * Along each world axis, the transformed sphere reaches 0.5 times the
+ * length of the corresponding row of the transformation.
+ */
+static Bounding_Box sphere_bounds(const Matrix &m)
+{
+   Bounding_Box box;
+   for(int i = 0; i < 3; ++i)
+   {
+      GLfloat radius = 0.5 * sqrt(m.data[0 + i] * m.data[0 + i] +
+                                  m.data[4 + i] * m.data[4 + i] +
+                                  m.data[8 + i] * m.data[8 + i]);
+      box.min[i] = m.data[12 + i] - radius;
+      box.max[i] = m.data[12 + i] + radius;
+   }
+   return box;
+}
+
+Primitive_Store::Primitive_Store()
+{
+}
+
+Primitive_Store::Slot Primitive_Store::allocate(CSG_Object *object, Type type)
+{
+   Slot slot;
+   if(!_free.empty())
+   {
+      slot = _free.back();
+      _free.pop_back();
+   }
+   else
+   {
+      slot = _objects.size();
+      _transforms.push_back(Matrix());
+      _inverses.push_back(Matrix());
+      _bounds.push_back(Bounding_Box());
+      _colors.resize(_colors.size() + 3);
+      _precisions.push_back(0);
+      _types.push_back(0);
+      _objects.push_back(NULL);
+   }
+
+   _objects[slot] = object;
+   _types[slot] = type;
+   _precisions[slot] = 10;
+   set_color(slot, 1.0, 1.0, 1.0);
+   set_transform(slot, Matrix());
+   return slot;
+}
+
+void Primitive_Store::release(Slot slot)
+{
+   assert(_objects[slot]);
+   _objects[slot] = NULL;
+   _free.push_back(slot);
+}
+
+void Primitive_Store::set_transform(Slot slot, const Matrix &m)
+{
+   _transforms[slot] = m;
+   _inverses[slot] = affine_inverse(m);
+   switch(_types[slot])
+   {
+      case CUBE:
+         _bounds[slot] = cube_bounds(m);
+         break;
+      case CYLINDER:
+         _bounds[slot] = cylinder_bounds(m);
+         break;
+      case SPHERE:
+         _bounds[slot] = sphere_bounds(m);
+         break;
+   }
+}
+
+const Matrix &Primitive_Store::get_transform(Slot slot) const
+{
+   return _transforms[slot];
+}
+
+const Matrix &Primitive_Store::get_inverse(Slot slot) const
+{
+   return _inverses[slot];
+}
+
+const Bounding_Box &Primitive_Store::get_bounds(Slot slot) const
+{
+   return _bounds[slot];
+}
+
+Primitive_Store::Type Primitive_Store::get_type(Slot slot) const
+{
+   return Type(_types[slot]);
+}
+
+void Primitive_Store::set_color(Slot slot, GLfloat red, GLfloat green,
+                                GLfloat blue)
+{
+   _colors[3 * slot + 0] = red;
+   _colors[3 * slot + 1] = green;
+   _colors[3 * slot + 2] = blue;
+}
+
+const GLfloat *Primitive_Store::get_color(Slot slot) const
+{
+   return &_colors[3 * slot];
+}
+
+void Primitive_Store::set_precision(Slot slot, int precision)
+{
+   _precisions[slot] = precision;
+}
+
+int Primitive_Store::get_precision(Slot slot) const
+{
+   return _precisions[slot];
+}
+
+CSG_Object *Primitive_Store::get_object(Slot slot) const
+{
+   return _objects[slot];
+}
+
+void Primitive_Store::find_in_box(const Bounding_Box &box,
+                                  vector<CSG_Object *> &found) const
+{
+   found.clear();
+   for(Slot slot = 0; slot < _bounds.size(); ++slot)
+      if(_bounds[slot].overlaps(box) && _objects[slot])
+         found.push_back(_objects[slot]);
+}
+
+unsigned int Primitive_Store::size() const
+{
+   return _objects.size();
+}
+
+Primitive_Store &primitive_store()
+{
+   static Primitive_Store *store = new Primitive_Store;
+   return *store;
+}
@@ -0,0 +1,124 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file primitive_store.h
+ * The per-object data of all primitives, in parallel arrays.
+ */
+
+#ifndef __PRIMITIVE_STORE_H__
+#define __PRIMITIVE_STORE_H__
+
+#include <vector>
+#include <GL/gl.h>
+#include "matrix.h"
+#include "bounding_box.h"
+
+class CSG_Object;
+
+/*!
+ * Keeps the transformations, inverse transformations, world-space boxes,
+ * colors, precisions and types of all primitives in one array each, indexed
+ * by slot. A CSG_Object only holds its slot, so a pass over one property of
+ * all objects, such as culling by box, reads one contiguous array instead
+ * of following a pointer per object.
+ *
+ * Every CSG_Object takes a slot in the store returned by primitive_store()
+ * when it is created, and gives it back when it is deleted. Slots are
+ * reused, so a slot number says nothing about the age of an object.
+ * Creating objects moves the arrays, which makes earlier references into
+ * them invalid. Objects must not be created or deleted while another
+ * thread reads the store.
+ */
+class Primitive_Store
+{
+public:
+   enum Type { CUBE, CYLINDER, SPHERE };
+   typedef unsigned int Slot;
+
+   Primitive_Store();
+
+   /*!
+    * Takes a slot for object, with the identity transformation, white
+    * color and precision 10.
+    */
+   Slot allocate(CSG_Object *object, Type type);
+
+   //! Gives back a slot, which may then be handed out again.
+   void release(Slot slot);
+
+   /*!
+    * Sets the transformation of a slot, and computes its inverse and the
+    * box of the shape from the type.
+    */
+   void set_transform(Slot slot, const Matrix &m);
+
+   const Matrix &get_transform(Slot slot) const;
+   //! The transformation from world space to the unit shape of the type.
+   const Matrix &get_inverse(Slot slot) const;
+   const Bounding_Box &get_bounds(Slot slot) const;
+   Type get_type(Slot slot) const;
+
+   void set_color(Slot slot, GLfloat red, GLfloat green, GLfloat blue);
+   const GLfloat *get_color(Slot slot) const; //!< Red, green and blue.
+
+   void set_precision(Slot slot, int precision);
+   int get_precision(Slot slot) const;
+
+   //! The object in a slot, or NULL if the slot is free.
+   CSG_Object *get_object(Slot slot) const;
+
+   /*!
+    * Finds every object whose box overlaps box, by slot. Unlike
+    * find_in_box() in scene_query.h, this looks at all objects, in any
+    * tree or none, without walking a tree.
+    */
+   void find_in_box(const Bounding_Box &box,
+                    std::vector<CSG_Object *> &found) const;
+
+   //! Number of slots, free or not.
+   unsigned int size() const;
+
+private:
+   Primitive_Store(const Primitive_Store &);
+   void operator=(const Primitive_Store &);
+
+   std::vector<Matrix> _transforms;
+   std::vector<Matrix> _inverses;
+   std::vector<Bounding_Box> _bounds;
+   std::vector<GLfloat> _colors;      //!< Three per slot.
+   std::vector<int> _precisions;
+   std::vector<unsigned char> _types; //!< Type of each slot.
+   std::vector<CSG_Object *> _objects;
+   std::vector<Slot> _free;
+};
+
+/*!
+ * The store that holds all CSG_Objects. It is never deleted, so that
+ * objects can still be deleted by destructors of static objects.
+ */
+Primitive_Store &primitive_store();
+
+#endif
@@ -0,0 +1,203 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file product_list.cpp
+ * Flattening of normalized CSG trees.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include "product_list.h"
+
+using namespace std;
+
+//! Appends one product to list. Returns false if it is not a proper product.
+static bool add_product(const CSG_Node *tree, Product_List &list)
+{
+   Product_List::Product product;
+   vector<CSG_Object *> &primitives = list.primitives;
+
+   // The differences come first from the top, ...
+   vector<CSG_Object *> subtracted;
+   while (tree->get_type() == CSG_Node::DIFFERENCE)
+   {
+      if (tree->get_right()->get_type() != CSG_Node::PRIMITIVE)
+         return false;
+      subtracted.push_back(tree->get_right()->get_object());
+      tree = tree->get_left();
+   }
+
+   // ...then the intersections, whose rightmost primitive is at the top.
+   product.intersect_begin = primitives.size();
+   while (tree->get_type() == CSG_Node::INTERSECTION)
+   {
+      if (tree->get_right()->get_type() != CSG_Node::PRIMITIVE)
+         return false;
+      primitives.push_back(tree->get_right()->get_object());
+      tree = tree->get_left();
+   }
+   if (tree->get_type() != CSG_Node::PRIMITIVE)
+      return false;
+   primitives.push_back(tree->get_object());
+   reverse(primitives.begin() + product.intersect_begin, primitives.end());
+
+   product.subtract_begin = primitives.size();
+   primitives.insert(primitives.end(), subtracted.begin(), subtracted.end());
+   product.subtract_end = primitives.size();
+
+   list.products.push_back(product);
+   return true;
+}
+
+bool Product_List::assign(const CSG_Node *tree)
+{
+   clear();
+   if (!tree)
+      return true;
+
+   // Walk the unions from left to right.
+   vector<const CSG_Node *> stack(1, tree);
+   while (!stack.empty())
+   {
+      const CSG_Node *node = stack.back();
+      stack.pop_back();
+
+      if (node->get_type() == CSG_Node::UNION)
+      {
+         stack.push_back(node->get_right());
+         stack.push_back(node->get_left());
+      }
+      else if (!add_product(node, *this))
+      {
+         cout << "Product_List::assign: the tree is not normalized" << endl;
+         clear();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//! Ends the product that starts at begin, if there is one.
+static void end_product(Product_List &list, unsigned int begin,
+                        vector<CSG_Object *> &subtracted)
+{
+   if (begin == list.primitives.size())
+      return;
+
+   Product_List::Product product;
+   product.intersect_begin = begin;
+   product.subtract_begin = list.primitives.size();
+   list.primitives.insert(list.primitives.end(), subtracted.rbegin(),
+                          subtracted.rend());
+   product.subtract_end = list.primitives.size();
+   list.products.push_back(product);
+   subtracted.clear();
+}
+
+bool Product_List::assign(const CSG_Flat_Tree &tree)
+{
+   clear();
+
+   // In post-order, every product is a run of nodes from its leftmost
+   // primitive to its top difference, and the products come from left to
+   // right. Each operation in a product has the one before it as its
+   // right operand, and the top of the product so far as its left one.
+   const unsigned int NONE = ~0u;
+   unsigned int top = NONE, begin = 0;
+   vector<CSG_Object *> subtracted;
+   for (unsigned int i = 0; i < tree.size(); ++i)
+   {
+      switch (tree.types[i])
+      {
+         case CSG_Node::PRIMITIVE:
+            if (i + 1 < tree.size() && tree.rights[i + 1] == i &&
+                (tree.types[i + 1] == CSG_Node::INTERSECTION ||
+                 tree.types[i + 1] == CSG_Node::DIFFERENCE))
+               continue; // Added by the operation.
+            end_product(*this, begin, subtracted);
+            begin = primitives.size();
+            primitives.push_back(tree.objects[tree.primitives[i]]);
+            top = i;
+            continue;
+         case CSG_Node::UNION:
+            end_product(*this, begin, subtracted);
+            begin = primitives.size();
+            top = NONE;
+            continue;
+      }
+
+      unsigned int right = tree.rights[i];
+      if (top == NONE || tree.lefts[i] != top ||
+          tree.types[right] != CSG_Node::PRIMITIVE ||
+          (tree.types[i] == CSG_Node::INTERSECTION && !subtracted.empty()))
+      {
+         cout << "Product_List::assign: the tree is not normalized" << endl;
+         clear();
+         return false;
+      }
+
+      if (tree.types[i] == CSG_Node::INTERSECTION)
+         primitives.push_back(tree.objects[tree.primitives[right]]);
+      else
+         subtracted.push_back(tree.objects[tree.primitives[right]]);
+      top = i;
+   }
+   end_product(*this, begin, subtracted);
+
+   return true;
+}
+
+void Product_List::append(const Product_List &other)
+{
+   unsigned int offset = primitives.size();
+
+   for (unsigned int i = 0; i < other.products.size(); ++i)
+   {
+      Product product = other.products[i];
+      product.intersect_begin += offset;
+      product.subtract_begin += offset;
+      product.subtract_end += offset;
+      products.push_back(product);
+   }
+   primitives.insert(primitives.end(), other.primitives.begin(),
+                     other.primitives.end());
+}
+
+void Product_List::end_group(const Bounding_Box &bounds)
+{
+   Group group;
+   group.products_end = products.size();
+   group.bounds = bounds;
+   groups.push_back(group);
+}
+
+void Product_List::clear()
+{
+   products.clear();
+   primitives.clear();
+   groups.clear();
+}
@@ -0,0 +1,113 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file product_list.h
+ * A normalized CSG tree stored as a flat list of products.
+ */
+
+#ifndef __PRODUCT_LIST_H__
+#define __PRODUCT_LIST_H__
+
+#include <vector>
+#include "csg_tree.h"
+#include "csg_flat.h"
+#include "bounding_box.h"
+
+/*!
+ * The sum of products in a normalized CSG tree, flattened into two arrays
+ * so that the renderer can walk it without recursion or parent pointers.
+ *
+ * Each product is a range of consecutive primitives: first the intersected
+ * ones, then the subtracted ones. Products and primitives are stored in
+ * the same order as the renderer would find them in the tree.
+ */
+class Product_List
+{
+public:
+   struct Product
+   {
+      unsigned int intersect_begin; //!< First intersected primitive.
+      unsigned int subtract_begin;  //!< First subtracted primitive. Ends the intersected ones.
+      unsigned int subtract_end;    //!< One past the last subtracted primitive.
+   };
+
+   /*!
+    * A run of consecutive products whose primitives all lie inside a known
+    * box. The renderer only has to touch the part of the screen that the
+    * box covers when it draws them.
+    */
+   struct Group
+   {
+      unsigned int products_end; //!< One past the last product in the group.
+      Bounding_Box bounds;
+   };
+
+   /*!
+    * Replaces the contents with the products of a normalized tree.
+    *
+    * \return false if tree is not normalized (in which case the list is
+    *         left empty).
+    */
+   bool assign(const CSG_Node *tree);
+
+   /*!
+    * Replaces the contents with the products of a normalized flat tree in
+    * post-order, in one pass over its arrays.
+    *
+    * \return false if tree is not normalized (in which case the list is
+    *         left empty).
+    */
+   bool assign(const CSG_Flat_Tree &tree);
+
+   //! Appends the products of another list. Its groups are ignored.
+   void append(const Product_List &other);
+
+   /*!
+    * Makes a group of all products after the end of the last group.
+    *
+    * \param bounds Must contain all primitives of those products.
+    */
+   void end_group(const Bounding_Box &bounds);
+
+   void clear();
+
+   std::vector<Product> products;
+
+   /*!
+    * The intersected primitives of a product are stored from left to right.
+    * The subtracted ones are stored from the outermost difference in the
+    * tree and inwards, which is the order the renderer subtracts them in.
+    */
+   std::vector<CSG_Object *> primitives;
+
+   /*!
+    * Groups of products, in order. Lists made by assign() have no groups,
+    * and products outside all groups have no known bounds.
+    */
+   std::vector<Group> groups;
+};
+
+#endif
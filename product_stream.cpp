@@ -0,0 +1,355 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file product_stream.cpp
+ * Implementation of the lazy product enumerator.
+ */
+
+#include <cassert>
+#include <utility>
+#include "product_stream.h"
+
+using namespace std;
+
+/*!
+ * A node in the rewritten tree. Primitives know if they are subtracted,
+ * unions know which operand they are currently enumerating.
+ */
+struct Product_Stream::Node
+{
+   enum Type { PRIMITIVE, UNION, INTERSECTION };
+
+   Type type;
+   CSG_Object *object;
+   bool subtracted;
+   Node *left, *right;
+   bool on_right; //!< Unions only. The current product comes from right.
+};
+
+Product_Stream::Product_Stream(const CSG_Node *tree, unsigned long limit) :
+   _root(NULL), _limit(limit), _count(0), _started(false), _done(false),
+   _truncated(false), _estimate(0)
+{
+   if(tree)
+   {
+      _root = build(tree, false);
+      _estimate = count_products(_root);
+   }
+   _done = !_root;
+}
+
+Product_Stream::~Product_Stream()
+{
+   for(unsigned long i = 0; i < _nodes.size(); ++i)
+      delete _nodes[i];
+}
+
+Product_Stream::Node *Product_Stream::add_node(bool subtracted)
+{
+   Node *node = new Node;
+   _nodes.push_back(node);
+   node->object = NULL;
+   node->subtracted = subtracted;
+   node->left = node->right = NULL;
+   node->on_right = false;
+   return node;
+}
+
+/*
+ * Pushes the subtractions down to the primitives:
+ *   -(A+B) = (-A)*(-B)
+ *   -(A*B) = (-A)+(-B)
+ *   A-B    = A*(-B)
+ *   -(A-B) = (-A)+B
+ *
+ * None of the walks over the rewritten tree recurse, since it is as deep as
+ * the original. Nodes are created before their subtrees are built, and know
+ * if the subtree is subtracted until then.
+ */
+Product_Stream::Node *Product_Stream::build(const CSG_Node *tree, bool subtracted)
+{
+   Node *root = add_node(subtracted);
+   vector<pair<const CSG_Node *, Node *> > stack(1, make_pair(tree, root));
+
+   while(!stack.empty())
+   {
+      tree = stack.back().first;
+      Node *node = stack.back().second;
+      stack.pop_back();
+      subtracted = node->subtracted;
+
+      switch(tree->get_type())
+      {
+         case CSG_Node::PRIMITIVE:
+            node->type = Node::PRIMITIVE;
+            node->object = tree->get_object();
+            continue;
+         case CSG_Node::UNION:
+            node->type = subtracted ? Node::INTERSECTION : Node::UNION;
+            node->left = add_node(subtracted);
+            node->right = add_node(subtracted);
+            break;
+         case CSG_Node::INTERSECTION:
+            node->type = subtracted ? Node::UNION : Node::INTERSECTION;
+            node->left = add_node(subtracted);
+            node->right = add_node(subtracted);
+            break;
+         case CSG_Node::DIFFERENCE:
+            node->type = subtracted ? Node::UNION : Node::INTERSECTION;
+            node->left = add_node(subtracted);
+            node->right = add_node(!subtracted);
+            break;
+         default:
+            assert(!"Unknown node type");
+            continue;
+      }
+
+      node->subtracted = false;
+      stack.push_back(make_pair(tree->get_right(), node->right));
+      stack.push_back(make_pair(tree->get_left(), node->left));
+   }
+
+   return root;
+}
+
+//! Moves node to its first product. Every subtree has at least one.
+bool Product_Stream::first(Node *node)
+{
+   vector<Node *> stack(1, node);
+   while(!stack.empty())
+   {
+      node = stack.back();
+      stack.pop_back();
+      switch(node->type)
+      {
+         case Node::UNION:
+            node->on_right = false;
+            stack.push_back(node->left);
+            break;
+         case Node::INTERSECTION:
+            stack.push_back(node->left);
+            stack.push_back(node->right);
+            break;
+         default:
+            break;
+      }
+   }
+   return true;
+}
+
+//! What advance() is waiting for in a node.
+enum Advance_State
+{
+   ADVANCE_ENTER,  //!< Nothing yet.
+   ADVANCE_LEFT,   //!< The left operand to advance.
+   ADVANCE_RIGHT   //!< The right operand to advance.
+};
+
+/*!
+ * Moves node to its next product. Returns false if there was none.
+ *
+ * A union advances the operand it is on, and moves on to the first product
+ * of its right operand when the left one runs out. An intersection
+ * advances its right operand, and when that runs out, advances its left
+ * operand and starts over with the first product of the right one.
+ */
+bool Product_Stream::advance(Node *node)
+{
+   vector<pair<Node *, int> > stack(1, make_pair(node, (int)ADVANCE_ENTER));
+   bool advanced = false; // What the last finished node returned.
+
+   while(!stack.empty())
+   {
+      node = stack.back().first;
+      int &state = stack.back().second;
+
+      switch(state)
+      {
+         case ADVANCE_ENTER:
+            if(node->type == Node::PRIMITIVE)
+            {
+               advanced = false;
+               stack.pop_back();
+            }
+            else if(node->type == Node::UNION && !node->on_right)
+            {
+               state = ADVANCE_LEFT;
+               stack.push_back(make_pair(node->left, (int)ADVANCE_ENTER));
+            }
+            else
+            {
+               state = ADVANCE_RIGHT;
+               stack.push_back(make_pair(node->right, (int)ADVANCE_ENTER));
+            }
+            break;
+         case ADVANCE_RIGHT:
+            if(node->type == Node::UNION || advanced)
+               stack.pop_back();
+            else
+            {
+               state = ADVANCE_LEFT;
+               stack.push_back(make_pair(node->left, (int)ADVANCE_ENTER));
+            }
+            break;
+         default:
+            if(node->type == Node::UNION && !advanced)
+            {
+               node->on_right = true;
+               advanced = first(node->right);
+            }
+            else if(node->type == Node::INTERSECTION && advanced)
+               advanced = first(node->right);
+            stack.pop_back();
+            break;
+      }
+   }
+
+   return advanced;
+}
+
+void Product_Stream::collect(const Node *node, vector<CSG_Object *> &intersected,
+                             vector<CSG_Object *> &subtracted) const
+{
+   vector<const Node *> stack(1, node);
+   while(!stack.empty())
+   {
+      node = stack.back();
+      stack.pop_back();
+
+      while(node->type == Node::UNION)
+         node = node->on_right ? node->right : node->left;
+
+      if(node->type == Node::PRIMITIVE)
+         (node->subtracted ? subtracted : intersected).push_back(node->object);
+      else
+      {
+         stack.push_back(node->right);
+         stack.push_back(node->left);
+      }
+   }
+}
+
+double Product_Stream::count_products(const Node *node) const
+{
+   // Post-order, with the counts of the finished subtrees on a stack.
+   vector<pair<const Node *, bool> > stack(1, make_pair(node, false));
+   vector<double> counts;
+
+   while(!stack.empty())
+   {
+      node = stack.back().first;
+      if(node->type != Node::PRIMITIVE && !stack.back().second)
+      {
+         stack.back().second = true;
+         stack.push_back(make_pair((const Node *)node->right, false));
+         stack.push_back(make_pair((const Node *)node->left, false));
+         continue;
+      }
+      stack.pop_back();
+
+      if(node->type == Node::PRIMITIVE)
+      {
+         counts.push_back(1);
+         continue;
+      }
+      double right = counts.back();
+      counts.pop_back();
+      if(node->type == Node::UNION)
+         counts.back() += right;
+      else
+         counts.back() *= right;
+   }
+
+   return counts.back();
+}
+
+bool Product_Stream::next(Product_List &list)
+{
+   list.clear();
+
+   if(!_done && _limit && _count >= _limit)
+   {
+      // Only call it truncated if there really was something left.
+      _done = true;
+      _truncated = advance(_root);
+   }
+   if(_done)
+      return false;
+
+   if(!_started)
+   {
+      _started = true;
+      first(_root);
+   }
+   else if(!advance(_root))
+   {
+      _done = true;
+      return false;
+   }
+
+   _intersected.clear();
+   _subtracted.clear();
+   collect(_root, _intersected, _subtracted);
+   // Every product has an intersected primitive, since only right operands
+   // of differences are ever subtracted.
+   assert(!_intersected.empty());
+
+   Product_List::Product product;
+   product.intersect_begin = 0;
+   product.subtract_begin = _intersected.size();
+   product.subtract_end = _intersected.size() + _subtracted.size();
+   list.products.push_back(product);
+   list.primitives.insert(list.primitives.end(),
+                          _intersected.begin(), _intersected.end());
+   list.primitives.insert(list.primitives.end(),
+                          _subtracted.begin(), _subtracted.end());
+
+   _count++;
+   return true;
+}
+
+void Product_Stream::rewind()
+{
+   _count = 0;
+   _started = false;
+   _done = !_root;
+   _truncated = false;
+}
+
+double Product_Stream::estimate() const
+{
+   return _estimate;
+}
+
+unsigned long Product_Stream::count() const
+{
+   return _count;
+}
+
+bool Product_Stream::truncated() const
+{
+   return _truncated;
+}
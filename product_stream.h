@@ -0,0 +1,115 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file product_stream.h
+ * Enumerates the products of a CSG tree one at a time, without normalizing it.
+ */
+
+#ifndef __PRODUCT_STREAM_H__
+#define __PRODUCT_STREAM_H__
+
+#include <vector>
+#include "csg_tree.h"
+#include "product_list.h"
+
+/*!
+ * Generates the sum of products of an unnormalized CSG tree lazily.
+ *
+ * The tree is first rewritten with de Morgan's laws so that only primitives
+ * are ever subtracted, which gives a tree of unions and intersections of
+ * intersected and subtracted primitives of the same size as the original.
+ * The products are then enumerated like the digits of an odometer: a union
+ * yields the products of its left operand and then those of its right, and
+ * an intersection yields every combination of one product from each side.
+ *
+ * The memory used does not depend on the number of products, only on the
+ * size of the tree, so scenes whose normalized tree would not fit in memory
+ * can still be rendered. The tree must not change while it is enumerated.
+ *
+ * The products are the same as the ones normalize() gives, but not
+ * necessarily in the same order.
+ */
+class Product_Stream
+{
+public:
+   /*!
+    * \param tree The tree to enumerate. May be NULL, which has no products.
+    * \param limit Stop after this many products. 0 means no limit.
+    */
+   explicit Product_Stream(const CSG_Node *tree, unsigned long limit = 0);
+   ~Product_Stream();
+
+   /*!
+    * Replaces the contents of list with the next product.
+    *
+    * \return false if there are no more products (in which case list is
+    *         left empty).
+    */
+   bool next(Product_List &list);
+
+   //! Starts over from the first product.
+   void rewind();
+
+   /*!
+    * The number of products the whole tree has, calculated without
+    * enumerating them. Since it can be astronomical, it is a double.
+    */
+   double estimate() const;
+
+   //! Number of products returned by next() since the last rewind().
+   unsigned long count() const;
+
+   //! True if next() has left out products because of the limit.
+   bool truncated() const;
+
+private:
+   struct Node;
+
+   Product_Stream(const Product_Stream &);
+   void operator=(const Product_Stream &);
+
+   Node *add_node(bool subtracted);
+   Node *build(const CSG_Node *tree, bool subtracted);
+   bool first(Node *node);
+   bool advance(Node *node);
+   void collect(const Node *node, std::vector<CSG_Object *> &intersected,
+                std::vector<CSG_Object *> &subtracted) const;
+   double count_products(const Node *node) const;
+
+   std::vector<Node *> _nodes; //!< Owns all nodes. The root is the first one.
+   Node *_root;
+   unsigned long _limit;
+   unsigned long _count;
+   bool _started;
+   bool _done;
+   bool _truncated;
+   double _estimate;
+
+   //! Scratch space for next(), kept to avoid reallocating every product.
+   std::vector<CSG_Object *> _intersected, _subtracted;
+};
+
+#endif
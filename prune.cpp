@@ -0,0 +1,365 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file prune.cpp
+ * Implementation of bounding box pruning.
+ */
+
+#include <cassert>
+#include <map>
+#include <utility>
+#include <vector>
+#include "debug.h"
+#include "csg_visitor.h"
+#include "convex.h"
+#include "normalize.h"
+#include "prune.h"
+#ifdef DEBUG
+#  include <iostream>
+#endif
+
+using namespace std;
+
+/*
+ * All the pruning functions below use the same rules. The bounding box of a
+ * union is the union of the boxes of its operands, the box of an intersection
+ * is the intersection of their boxes, and the box of a difference is the box
+ * of its left operand. An intersection with an empty box is empty. A
+ * difference whose right operand does not overlap its left operand is just
+ * the left operand. Empty operands are dropped from unions and differences,
+ * and make intersections and differences they are the left operand of empty.
+ *
+ * When the boxes overlap, the primitives that enclose each operand are
+ * tested exactly as well. Every point of an intersection chain is inside its
+ * leftmost primitive and inside the primitives it is intersected with on
+ * the way there, so if one of those misses one of the primitives enclosing
+ * the other operand, the operands do not overlap after all.
+ */
+
+/*!
+ * Lists the primitives that enclose tree: the leftmost primitive, and the
+ * primitive right operands of the intersections on the way down to it.
+ * Stops at a union, since its operands do not enclose each other.
+ */
+template<class Node>
+static void find_enclosing(const Node *tree, vector<const CSG_Object *> &enclosing)
+{
+   while(tree->get_type() != CSG_Node::PRIMITIVE)
+   {
+      if(tree->get_type() == CSG_Node::UNION)
+         return;
+      if(tree->get_type() == CSG_Node::INTERSECTION &&
+         tree->get_right()->get_type() == CSG_Node::PRIMITIVE)
+         enclosing.push_back(tree->get_right()->get_object());
+      tree = tree->get_left();
+   }
+   enclosing.push_back(tree->get_object());
+}
+
+//! True if the exact shapes show that left and right do not overlap.
+template<class Node>
+static bool apart(const Node *left, const Node *right)
+{
+   vector<const CSG_Object *> a, b;
+   find_enclosing(left, a);
+   find_enclosing(right, b);
+   for(unsigned int i = 0; i < a.size(); ++i)
+      for(unsigned int j = 0; j < b.size(); ++j)
+         if(!primitives_overlap(a[i], b[j]))
+            return true;
+   return false;
+}
+
+//! Prunes a tree bottom up. Every subtree leaves its result on the stack.
+class Tree_Pruner : public CSG_Visitor<const CSG_Node>
+{
+public:
+   Tree_Pruner()
+   {
+      stats.products = stats.subtrahends = 0;
+   }
+
+   //! An empty left operand makes anything but a union empty, so the
+   //! right operand is not pruned, just taken to be empty too.
+   bool between(const CSG_Node *tree)
+   {
+      if(_pruned.back().first || tree->get_type() == CSG_Node::UNION)
+         return true;
+      _pruned.push_back(Pruned(NULL, Bounding_Box()));
+      return false;
+   }
+
+   void leave(const CSG_Node *tree)
+   {
+      if(tree->get_type() == CSG_Node::PRIMITIVE)
+      {
+         _pruned.push_back(Pruned(new CSG_Node(tree->get_object()),
+                                  tree->get_object()->get_bounds()));
+         return;
+      }
+      Pruned right = _pruned.back();
+      _pruned.pop_back();
+      CSG_Node *&left = _pruned.back().first;
+      Bounding_Box &box = _pruned.back().second;
+
+      switch(tree->get_type())
+      {
+         case CSG_Node::UNION:
+            if(!left)
+               _pruned.back() = right;
+            else if(right.first)
+            {
+               box.unite(right.second);
+               left = CSG_Node::create_and_insert(CSG_Node::UNION, left,
+                                                  right.first);
+            }
+            break;
+         case CSG_Node::INTERSECTION:
+            box.intersect(right.second);
+            if(!right.first || box.is_empty() || apart(left, right.first))
+            {
+               if(right.first)
+                  stats.products++;
+               delete left;
+               delete right.first;
+               left = NULL;
+            }
+            else
+               left = CSG_Node::create_and_insert(CSG_Node::INTERSECTION, left,
+                                                  right.first);
+            break;
+         case CSG_Node::DIFFERENCE:
+            if(!right.first)
+               break;
+            if(!box.overlaps(right.second) || apart(left, right.first))
+            {
+               stats.subtrahends++;
+               delete right.first;
+            }
+            else
+               left = CSG_Node::create_and_insert(CSG_Node::DIFFERENCE, left,
+                                                  right.first);
+            break;
+         default:
+            assert(!"Unknown node type");
+            break;
+      }
+   }
+
+   CSG_Node *result() const
+   {
+      return _pruned.back().first;
+   }
+
+   Prune_Stats stats;
+
+private:
+   typedef pair<CSG_Node *, Bounding_Box> Pruned;
+   vector<Pruned> _pruned;
+};
+
+CSG_Node *prune(const CSG_Node *tree, Prune_Stats *stats)
+{
+   Tree_Pruner pruner;
+   if(tree)
+      visit_tree(tree, pruner);
+   CSG_Node *result = tree ? pruner.result() : NULL;
+
+   DBG(cout << "prune: removed " << pruner.stats.products << " products and "
+            << pruner.stats.subtrahends << " subtrahends" << endl);
+
+   if(stats)
+      *stats = pruner.stats;
+   return result;
+}
+
+Bounding_Box get_bounds(const CSG_Node *tree)
+{
+   return tree->get_bounds();
+}
+
+/*!
+ * Prunes and normalizes expressions in one DAG, remembering what it has
+ * already done. The memos are only valid as long as no primitive moves, so
+ * a Dag_Pruner should not outlive the call that created it.
+ */
+class Dag_Pruner
+{
+public:
+   Dag_Pruner(CSG_Dag &dag) : _dag(dag)
+   {
+      stats.products = stats.subtrahends = 0;
+   }
+
+   //! Returns the pruned node, or NULL if it is empty.
+   const CSG_Dag_Node *prune(const CSG_Dag_Node *node, Bounding_Box &box);
+
+   //! Returns the normalized and pruned node, or NULL if it is empty.
+   const CSG_Dag_Node *normalize(const CSG_Dag_Node *node);
+
+   Prune_Stats stats;
+
+private:
+   typedef pair<const CSG_Dag_Node *, Bounding_Box> Pruned;
+
+   CSG_Dag &_dag;
+   map<const CSG_Dag_Node *, Pruned> _pruned;
+   map<const CSG_Dag_Node *, const CSG_Dag_Node *> _normalized;
+};
+
+const CSG_Dag_Node *Dag_Pruner::prune(const CSG_Dag_Node *node, Bounding_Box &box)
+{
+   map<const CSG_Dag_Node *, Pruned>::iterator i = _pruned.find(node);
+   if(i != _pruned.end())
+   {
+      box = i->second.second;
+      return i->second.first;
+   }
+
+   const CSG_Dag_Node *result = NULL;
+
+   if(node->get_type() == CSG_Node::PRIMITIVE)
+   {
+      box = node->get_object()->get_bounds();
+      result = node;
+   }
+   else
+   {
+      const CSG_Dag_Node *left = prune(node->get_left(), box);
+      Bounding_Box right_box;
+      const CSG_Dag_Node *right = NULL;
+      if(left || node->get_type() == CSG_Node::UNION)
+         right = prune(node->get_right(), right_box);
+
+      switch(node->get_type())
+      {
+         case CSG_Node::UNION:
+            if(!left)
+            {
+               box = right_box;
+               result = right;
+            }
+            else if(!right)
+               result = left;
+            else
+            {
+               box.unite(right_box);
+               result = _dag.operation(CSG_Node::UNION, left, right);
+            }
+            break;
+         case CSG_Node::INTERSECTION:
+            if(!left || !right)
+               break;
+            box.intersect(right_box);
+            if(box.is_empty() || apart(left, right))
+               stats.products++;
+            else
+               result = _dag.operation(CSG_Node::INTERSECTION, left, right);
+            break;
+         case CSG_Node::DIFFERENCE:
+            if(!left)
+               break;
+            if(!right)
+               result = left;
+            else if(!box.overlaps(right_box) || apart(left, right))
+            {
+               stats.subtrahends++;
+               result = left;
+            }
+            else
+               result = _dag.operation(CSG_Node::DIFFERENCE, left, right);
+            break;
+         default:
+            assert(!"Unknown node type");
+            break;
+      }
+   }
+
+   if(!result)
+      box = Bounding_Box();
+   _pruned[node] = Pruned(result, box);
+   return result;
+}
+
+const CSG_Dag_Node *Dag_Pruner::normalize(const CSG_Dag_Node *node)
+{
+   if(node->get_type() == CSG_Node::PRIMITIVE)
+      return node;
+
+   map<const CSG_Dag_Node *, const CSG_Dag_Node *>::iterator i = _normalized.find(node);
+   if(i != _normalized.end())
+      return i->second;
+
+   CSG_Node::CSG_Type type = node->get_type();
+   const CSG_Dag_Node *result = NULL;
+   const CSG_Dag_Node *left = normalize(node->get_left());
+   const CSG_Dag_Node *right = NULL;
+   if(left || type == CSG_Node::UNION)
+      right = normalize(node->get_right());
+
+   if(!left)
+      result = (type == CSG_Node::UNION) ? right : NULL;
+   else if(!right)
+      result = (type == CSG_Node::INTERSECTION) ? NULL : left;
+   else
+   {
+      // Both operands are already pruned sums of products, so the
+      // products the rewrite rules multiply out are as few as they get.
+      Bounding_Box box;
+      result = prune(::normalize(_dag, _dag.operation(type, left, right)), box);
+   }
+
+   _normalized[node] = result;
+   return result;
+}
+
+const CSG_Dag_Node *prune(CSG_Dag &dag, const CSG_Dag_Node *node, Prune_Stats *stats)
+{
+   Dag_Pruner pruner(dag);
+   Bounding_Box box;
+   const CSG_Dag_Node *result = pruner.prune(node, box);
+
+   if(stats)
+      *stats = pruner.stats;
+   return result;
+}
+
+CSG_Node *normalize_pruned(const CSG_Node *tree, Prune_Stats *stats)
+{
+   DBG(cout << "normalize_pruned" << endl);
+
+   CSG_Dag dag;
+   Dag_Pruner pruner(dag);
+   const CSG_Dag_Node *result = tree ? pruner.normalize(dag.import(tree)) : NULL;
+
+   DBG(cout << "normalize_pruned: removed " << pruner.stats.products
+            << " products and " << pruner.stats.subtrahends
+            << " subtrahends" << endl);
+
+   if(stats)
+      *stats = pruner.stats;
+   return result ? dag.expand(result) : NULL;
+}
@@ -0,0 +1,95 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file prune.h
+ * Removes parts of a CSG tree that can not contribute to the image.
+ */
+
+#ifndef __PRUNE_H__
+#define __PRUNE_H__
+
+#include "csg_tree.h"
+#include "csg_dag.h"
+#include "bounding_box.h"
+
+/*!
+ * What a pruning pass removed.
+ */
+struct Prune_Stats
+{
+   unsigned long products;    //!< Products that turned out to be empty.
+   unsigned long subtrahends; //!< Subtracted primitives that missed their product.
+};
+
+/*!
+ * Returns a copy of tree without the parts that the bounding boxes and the
+ * exact shapes of the primitives show can never be seen: intersections
+ * whose operands do not overlap, and subtracted subtrees that do not touch
+ * what they are subtracted from. Works on any tree, but is meant for normalized ones, where
+ * every removed intersection is a product the renderer does not have to draw.
+ *
+ * The result depends on the current transformations of the primitives, so
+ * prune the tree again after moving anything.
+ *
+ * \return The pruned copy, or NULL if nothing at all is left.
+ * \param stats If not NULL, receives the number of removed products and
+ *              subtrahends.
+ */
+CSG_Node *prune(const CSG_Node *tree, Prune_Stats *stats = NULL);
+
+/*!
+ * Returns a box around everything that tree can cover, by the same rules
+ * that prune() uses for boxes. The box is empty if the boxes alone make
+ * prune() remove all of tree.
+ * Same as tree->get_bounds(), which caches the boxes in the nodes.
+ */
+Bounding_Box get_bounds(const CSG_Node *tree);
+
+/*!
+ * Like prune(), but works on an expression in a DAG. Nothing is copied;
+ * the DAG nodes that are left untouched are shared with node.
+ */
+const CSG_Dag_Node *prune(CSG_Dag &dag, const CSG_Dag_Node *node,
+                          Prune_Stats *stats = NULL);
+
+/*!
+ * Returns a normalized and pruned copy of tree. Pruning is done during the
+ * normalization, on the normalized form of every subtree before it is
+ * distributed over its siblings, so that products which are going to be
+ * empty are never multiplied out.
+ *
+ * The result is a normalized tree, but not necessarily the same as the one
+ * from prune(normalize(tree)). It is never larger, and often smaller, since
+ * a subtrahend that is removed early is never distributed over anything.
+ *
+ * \return The normalized tree, or NULL if nothing at all is left.
+ * \param stats If not NULL, receives the number of removed products and
+ *              subtrahends. A product that is removed before it has been
+ *              multiplied out is only counted once.
+ */
+CSG_Node *normalize_pruned(const CSG_Node *tree, Prune_Stats *stats = NULL);
+
+#endif
@@ -30,6 +30,9 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
 #include <assert.h>
 #include "debug.h"
 #ifdef DEBUG
@@ -37,12 +40,19 @@
 #endif
 #include <GL/glut.h>
 #include "renderer_interface.h"
+#include "csg_visitor.h"
+#include "product_list.h"
+#include "product_stream.h"
+#include "mesh_cache.h"
+#include "level_of_detail.h"
+#include "impostor.h"
 
 using namespace std;
 
 static RenderType render_type = RENDER_CSG;
 static int render_partial = -1;
 static int render_counter;
+static const Overlap_Graph *overlap_graph = NULL;
 
 typedef GLuint ZValue;
 const GLenum ZBUFFER_TYPE = GL_DEPTH_COMPONENT;
@@ -81,25 +91,99 @@ bool render_primitive(CSG_Object *obj)
    return true;
 }
 
-//! Draw all primitives in tree to the Z-buffer using current GL settings.
-//! Tree must only contain intersected primitives.
-//! Returns the number of primitives in the tree.
-int render_intersected_primitives(const CSG_Node *tree)
+//! Draw a range of primitives to the Z-buffer using current GL settings.
+bool render_primitives(CSG_Object *const *first, CSG_Object *const *last)
 {
-   assert(tree->get_type() == CSG_Node::INTERSECTION ||
-          tree->get_type() == CSG_Node::PRIMITIVE);
-   if (tree->get_type() == CSG_Node::PRIMITIVE)
+   for (; first != last; ++first)
+      if (!render_primitive(*first))
+         return false;
+   return true;
+}
+
+//! The precision that picks the mesh of a primitive.
+static int mesh_precision(CSG_Object *object)
+{
+   return object->get_type() == Primitive_Store::CUBE ? 0 :
+      level_of_detail().precision(object);
+}
+
+//! Orders primitives by the mesh they are drawn with.
+struct Mesh_Order
+{
+   bool operator()(CSG_Object *a, CSG_Object *b) const
    {
-      return render_primitive(tree->get_object());
+      if (a->get_type() != b->get_type())
+         return a->get_type() < b->get_type();
+      return mesh_precision(a) < mesh_precision(b);
    }
-   else
+};
+
+//! Draw a range of primitives to the Z-buffer like render_primitives(),
+//! but with one instanced draw per mesh. Only for passes where the order
+//! of the primitives does not matter and no color is written. Falls back
+//! on render_primitives() when there is no instancing, when only part of
+//! the passes are drawn, so that render_counter can stop in the middle, and
+//! when the primitives are impostors, so that every pass has their depth.
+bool render_instanced(CSG_Object *const *first, CSG_Object *const *last)
+{
+   if (last - first < 2 || render_partial != -1 ||
+       !mesh_cache().instancing() || impostors().available())
+      return render_primitives(first, last);
+
+   static vector<CSG_Object *> batch;
+   static vector<GLfloat> transforms;
+   batch.assign(first, last);
+   sort(batch.begin(), batch.end(), Mesh_Order());
+
+   Mesh_Order order;
+   for (unsigned int begin = 0, end = 0; begin < batch.size(); begin = end)
    {
-      int r1 = render_intersected_primitives(tree->get_left());
-      if (!r1) return 0;
-      int r2 = render_intersected_primitives(tree->get_right());
-      if (!r2) return 0;
-      return r1 + r2;
+      transforms.clear();
+      for (end = begin; end < batch.size() &&
+              !order(batch[begin], batch[end]); ++end)
+      {
+         const GLfloat *m = batch[end]->get_transform().data;
+         transforms.insert(transforms.end(), m, m + 16);
+      }
+      mesh_cache().draw_instanced(batch[begin]->get_type(),
+                                  mesh_precision(batch[begin]),
+                                  &transforms[0], end - begin);
+      render_counter -= end - begin;
+      FETDEBUG;
    }
+   return true;
+}
+
+//! Lists the primitives for render_intersected_primitives().
+struct Intersected_Lister : public CSG_Visitor<const CSG_Node>
+{
+   bool enter(const CSG_Node *tree)
+   {
+      assert(tree->get_type() == CSG_Node::INTERSECTION ||
+             tree->get_type() == CSG_Node::PRIMITIVE);
+      return true;
+   }
+
+   void leave(const CSG_Node *tree)
+   {
+      if (tree->get_type() == CSG_Node::PRIMITIVE)
+         objects.push_back(tree->get_object());
+   }
+
+   vector<CSG_Object *> objects;
+};
+
+//! Draw all primitives in tree to the Z-buffer using current GL settings.
+//! Tree must only contain intersected primitives.
+//! Returns the number of primitives in the tree, or 0 if rendering stopped.
+int render_intersected_primitives(const CSG_Node *tree)
+{
+   Intersected_Lister lister;
+   visit_tree(tree, lister);
+   CSG_Object *const *first = &lister.objects[0];
+   if (!render_instanced(first, first + lister.objects.size()))
+      return 0;
+   return lister.objects.size();
 }
 
 //! Overwrite the Z-buffer with the image of an intersection.
@@ -176,6 +260,62 @@ bool scs_intersect(const CSG_Node *tree)
    return true;
 }
 
+//! Finds the representative of x in a union-find forest.
+static int find_group(vector<int> &parent, int x)
+{
+   while (parent[x] != x)
+   {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+   }
+   return x;
+}
+
+/*!
+ * How many passes the subtraction sequence needs over the subtracted
+ * primitives first to last. The order only matters among primitives that
+ * overlap, since the surface a subtraction moves z to can only be inside
+ * primitives that overlap the subtracted one. It is therefore enough to
+ * embed every ordering of the largest group of primitives that overlap
+ * each other, directly or through others in the group.
+ */
+static int subtraction_passes(CSG_Object *const *first,
+                              CSG_Object *const *last)
+{
+   int n = last - first;
+   if (!overlap_graph || n < 3)
+      return n;
+
+   vector<CSG_Object *> sorted(first, last);
+   sort(sorted.begin(), sorted.end());
+   vector<int> parent(n);
+   for (int i = 0; i < n; ++i)
+      parent[i] = i;
+
+   for (int i = 0; i < n; ++i)
+   {
+      if (!overlap_graph->contains(sorted[i]))
+         return n;
+      const vector<CSG_Object *> &near = overlap_graph->neighbours(sorted[i]);
+      for (unsigned int k = 0; k < near.size(); ++k)
+      {
+         vector<CSG_Object *>::iterator j =
+            lower_bound(sorted.begin(), sorted.end(), near[k]);
+         if (j != sorted.end() && *j == near[k])
+            parent[find_group(parent, i)] =
+               find_group(parent, j - sorted.begin());
+      }
+   }
+
+   vector<int> size(n, 0);
+   int largest = 0;
+   for (int i = 0; i < n; ++i)
+      largest = max(largest, ++size[find_group(parent, i)]);
+   DBG(cout << "subtraction_passes: " << largest << " instead of " << n
+            << endl);
+   return largest;
+}
+
 //! Render a subtracted primitive.
 bool scs_subtract_primitive(const CSG_Node *node)
 {
@@ -218,12 +358,15 @@ bool scs_product(const CSG_Node *tree)
    if (tree->get_type() == CSG_Node::DIFFERENCE)
    {
       // Count the number of subtracted objects.
-      int num_subtracted = 1;
+      vector<CSG_Object *> subtracted(1, first_diff->get_right()->get_object());
       while (last_diff->get_left()->get_type() == CSG_Node::DIFFERENCE)
       {
-         ++num_subtracted;
          last_diff = last_diff->get_left();
+         subtracted.push_back(last_diff->get_right()->get_object());
       }
+      int num_subtracted = subtraction_passes(&subtracted[0],
+                                              &subtracted[0] +
+                                              subtracted.size());
 
       // Overwrite z with the image of the intersected objects.
       CSG_Node *first_inter = last_diff->get_left();
@@ -243,7 +386,8 @@ bool scs_product(const CSG_Node *tree)
       // Example:
       // For four objects, we subtract (ABCDCBABCDCBA)
       // Any ordering of ABCD, e.g.    (  C   A  D B ),
-      // is embedded inside this sequence.
+      // is embedded inside this sequence. If no more than two of them
+      // overlap each other, (ABCDCBA) is enough.
 
       for(int pass = 0; pass < num_subtracted; ++pass)
       {
@@ -297,9 +441,10 @@ bool scs_product(const CSG_Node *tree)
       return scs_intersect(tree);
 }
 
-//! Traverse tree and render the products in it.
-bool scs_traverse_products(const CSG_Node *tree, bool first,
-                           GLint *dims, ZValue *zmerged)
+//! Render a product, and merge it with the previous ones in the Z-buffer
+//! unless it is the first.
+bool scs_merge_product(const CSG_Node *tree, bool first,
+                       GLint *dims, ZValue *zmerged)
 {
    if (tree->get_type() == CSG_Node::PRIMITIVE)
    {
@@ -321,7 +466,7 @@ bool scs_traverse_products(const CSG_Node *tree, bool first,
 
       return true;
    }
-   else if (tree->get_type() != CSG_Node::UNION)
+   else
    {
       if (!first)
       {
@@ -358,16 +503,381 @@ bool scs_traverse_products(const CSG_Node *tree, bool first,
 
       return true;
    }
-   else
+}
+
+//! Merges the products of a tree for scs_traverse_products().
+struct Product_Merger : public CSG_Visitor<const CSG_Node>
+{
+   Product_Merger(GLint *dims, ZValue *zmerged) :
+      dims(dims), zmerged(zmerged), first(true), ok(true)
    {
-      if (!scs_traverse_products(tree->get_left(), first, dims, zmerged))
+   }
+
+   bool enter(const CSG_Node *tree)
+   {
+      if (!ok)
          return false;
-      return scs_traverse_products(tree->get_right(), false, dims, zmerged);
+      if (tree->get_type() == CSG_Node::UNION)
+         return true;
+      ok = scs_merge_product(tree, first, dims, zmerged);
+      first = false;
+      return false;
    }
+
+   GLint *dims;
+   ZValue *zmerged;
+   bool first;
+   bool ok;
+};
+
+//! Traverse tree and render the products in it.
+bool scs_traverse_products(const CSG_Node *tree, GLint *dims, ZValue *zmerged)
+{
+   Product_Merger merger(dims, zmerged);
+   visit_tree(tree, merger);
+   return merger.ok;
 }
 
-//! Render a normalized CSG tree to the Z-buffer.
-void scs_render(const CSG_Node *tree)
+//! Overwrite the Z-buffer with the image of the intersected primitives of
+//! a product. Flat version of scs_intersect().
+bool scs_intersect(CSG_Object *const *first, CSG_Object *const *last)
+{
+   if (last - first == 1)
+   {
+      DBG(cout << "scs_intersect: primitive" << endl);
+
+      glDisable(GL_STENCIL_TEST);
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+      glDepthFunc(GL_ALWAYS);
+      glCullFace(GL_BACK);
+
+      glClearDepth(1.0);
+      glClear(GL_DEPTH_BUFFER_BIT);
+
+      FETDEBUG;
+      if (!--render_counter) return false;
+
+      return render_primitive(*first);
+   }
+
+   DBG(cout << "scs_intersect: intersection" << endl);
+
+   // See scs_intersect(const CSG_Node *) for what all of this does.
+   glDisable(GL_STENCIL_TEST);
+   glEnable(GL_DEPTH_TEST);
+   glDepthMask(GL_TRUE);
+   glDepthFunc(GL_GREATER);
+   glCullFace(GL_BACK);
+
+   glClearDepth(0.0);
+   glClearStencil(0);
+   glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+   FETDEBUG;
+   if (!--render_counter) return false;
+
+   if (!render_instanced(first, last))
+      return false;
+
+   glEnable(GL_STENCIL_TEST);
+   glStencilFunc(GL_ALWAYS, 0, ~0);
+   glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+   glDepthMask(GL_FALSE);
+   glDepthFunc(GL_GREATER);
+   glCullFace(GL_FRONT);
+
+   if (!render_instanced(first, last))
+      return false;
+
+   glStencilFunc(GL_NOTEQUAL, last - first, ~0);
+   glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+   glDepthMask(GL_TRUE);
+   glDepthFunc(GL_ALWAYS);
+
+   draw_zfar();
+   FETDEBUG;
+   if (!--render_counter) return false;
+   return true;
+}
+
+//! Render a subtracted primitive. Flat version of scs_subtract_primitive().
+bool scs_subtract_primitive(CSG_Object *object)
+{
+   glEnable(GL_STENCIL_TEST);
+   glStencilFunc(GL_ALWAYS, 1, ~0);
+   glStencilOp(GL_ZERO, GL_ZERO, GL_REPLACE);
+   glEnable(GL_DEPTH_TEST);
+   glDepthMask(GL_FALSE);
+   glDepthFunc(GL_LESS);
+   glCullFace(GL_BACK);
+
+   if (!render_primitive(object))
+      return false;
+
+   glStencilFunc(GL_EQUAL, 1, ~0);
+   glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+   glDepthMask(GL_TRUE);
+   glDepthFunc(GL_GREATER);
+   glCullFace(GL_FRONT);
+
+   return render_primitive(object);
+}
+
+//! Overwrite the Z-buffer with the image of a product. Flat version of
+//! scs_product(const CSG_Node *), doing exactly the same passes.
+bool scs_product(const Product_List &list, const Product_List::Product &product)
+{
+   DBG(cout << "scs_product" << endl);
+   CSG_Object *const *primitives = &list.primitives[0];
+   CSG_Object *const *first_inter = primitives + product.intersect_begin;
+   CSG_Object *const *first_diff = primitives + product.subtract_begin;
+   CSG_Object *const *last_diff = primitives + product.subtract_end - 1;
+
+   if (product.subtract_begin == product.subtract_end)
+      // No subtractions in the product, saves work.
+      return scs_intersect(first_inter, first_diff);
+
+   if (!scs_intersect(first_inter, first_diff))
+      return false;
+
+   // Subtract back and forth over the subtracted primitives, just like the
+   // tree version does up and down the chain of differences.
+   CSG_Object *const *node = first_diff;
+   if (!scs_subtract_primitive(*node))
+      return false;
+
+   int num_subtracted = subtraction_passes(first_diff, last_diff + 1);
+   for (int pass = 0; pass < num_subtracted; ++pass)
+   {
+      if (node == first_diff)
+         while (node != last_diff)
+         {
+            if (!scs_subtract_primitive(*++node))
+               return false;
+         }
+      else // node == last_diff
+         while (node != first_diff)
+         {
+            if (!scs_subtract_primitive(*--node))
+               return false;
+         }
+   }
+
+   // Reset z to zfar in holes through the objects.
+   glEnable(GL_STENCIL_TEST);
+   glStencilFunc(GL_ALWAYS, 1, ~0);
+   glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+   glEnable(GL_DEPTH_TEST);
+   glDepthMask(GL_FALSE);
+   glDepthFunc(GL_LESS);
+   glCullFace(GL_FRONT);
+
+   if (!render_instanced(first_inter, first_diff))
+      return false;
+
+   glStencilFunc(GL_EQUAL, 1, ~0);
+   glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+   glDepthMask(GL_TRUE);
+   glDepthFunc(GL_ALWAYS);
+
+   draw_zfar();
+   FETDEBUG;
+   if (!--render_counter) return false;
+
+   return true;
+}
+
+//! Render one product of a list, and merge it with the previous products
+//! in the Z-buffer. Flat version of scs_merge_product(const CSG_Node *).
+bool scs_merge_product(const Product_List &list,
+                       const Product_List::Product &product, bool first,
+                       GLint *dims, ZValue *zmerged)
+{
+   if (product.subtract_begin - product.intersect_begin == 1 &&
+       product.subtract_begin == product.subtract_end)
+   {
+      // A lone primitive. No need to copy anything.
+      glDisable(GL_STENCIL_TEST);
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+      glDepthFunc(GL_LESS);
+      glCullFace(GL_BACK);
+
+      if (first)
+      {
+         glClearDepth(1.0);
+         glClear(GL_DEPTH_BUFFER_BIT);
+      }
+
+      return render_primitive(list.primitives[product.intersect_begin]);
+   }
+
+   if (!first)
+   {
+      DBG(cout << "Saving zmerged" << endl);
+      glReadPixels(dims[0], dims[1], dims[2], dims[3],
+                   ZBUFFER_TYPE, ZBUFFER_FORMAT, zmerged);
+      FETDEBUG;
+      if (!--render_counter) return false;
+   }
+
+   if (!scs_product(list, product))
+      return false;
+
+   if (!first)
+   {
+      DBG(cout << "Drawing zmerged" << endl);
+      glDisable(GL_STENCIL_TEST);
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+      glDepthFunc(GL_LESS);
+      glDrawPixels(dims[2], dims[3], ZBUFFER_TYPE, ZBUFFER_FORMAT,
+                   zmerged);
+      FETDEBUG;
+      if (!--render_counter) return false;
+   }
+
+   return true;
+}
+
+//! Finds the part of the viewport dims that box covers on the screen, with
+//! the current transformations. Returns false if that part is empty.
+bool screen_rect(const Bounding_Box &box, const GLint *dims, GLint *rect)
+{
+   GLdouble modelview[16], projection[16];
+   glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+   glGetDoublev(GL_PROJECTION_MATRIX, projection);
+
+   GLdouble low[2], high[2];
+   for (int i = 0; i < 2; ++i)
+   {
+      low[i] = dims[i] + dims[2 + i];
+      high[i] = dims[i];
+   }
+   for (int corner = 0; corner < 8; ++corner)
+   {
+      GLdouble p[4] = { corner & 1 ? box.max[0] : box.min[0],
+                        corner & 2 ? box.max[1] : box.min[1],
+                        corner & 4 ? box.max[2] : box.min[2], 1 };
+      GLdouble eye[4], clip[4];
+      for (int i = 0; i < 4; ++i)
+         eye[i] = modelview[i] * p[0] + modelview[4 + i] * p[1] +
+            modelview[8 + i] * p[2] + modelview[12 + i] * p[3];
+      for (int i = 0; i < 4; ++i)
+         clip[i] = projection[i] * eye[0] + projection[4 + i] * eye[1] +
+            projection[8 + i] * eye[2] + projection[12 + i] * eye[3];
+
+      if (clip[3] <= 0)
+      {
+         // Behind the eye, where the projection turns inside out.
+         for (int i = 0; i < 4; ++i)
+            rect[i] = dims[i];
+         return true;
+      }
+
+      for (int i = 0; i < 2; ++i)
+      {
+         GLdouble window = dims[i] + (clip[i] / clip[3] + 1) * dims[2 + i] / 2;
+         if (window < low[i]) low[i] = window;
+         if (window > high[i]) high[i] = window;
+      }
+   }
+
+   // Leave a pixel of margin for the rasterization rules.
+   for (int i = 0; i < 2; ++i)
+   {
+      GLint first = (GLint)floor(low[i]) - 1;
+      GLint last = (GLint)ceil(high[i]) + 1;
+      if (first < dims[i]) first = dims[i];
+      if (last > dims[i] + dims[2 + i]) last = dims[i] + dims[2 + i];
+      rect[i] = first;
+      rect[2 + i] = last - first;
+   }
+   return rect[2] > 0 && rect[3] > 0;
+}
+
+//! Render one product of a list like scs_merge_product(), but only inside
+//! rect, which must cover the whole product on the screen. Only the part
+//! of the Z-buffer inside rect has to be copied.
+bool scs_merge_product_in(const Product_List &list,
+                          const Product_List::Product &product,
+                          GLint *dims, GLint *rect, ZValue *zmerged)
+{
+   glPushAttrib(GL_SCISSOR_BIT);
+   glEnable(GL_SCISSOR_TEST);
+   glScissor(rect[0], rect[1], rect[2], rect[3]);
+
+   // zmerged and zfar are drawn at the raster position, which is kept in
+   // the corner of the viewport.
+   glBitmap(0, 0, 0, 0, rect[0] - dims[0], rect[1] - dims[1], NULL);
+   bool result = scs_merge_product(list, product, false, rect, zmerged);
+   glBitmap(0, 0, 0, 0, dims[0] - rect[0], dims[1] - rect[1], NULL);
+
+   glPopAttrib();
+   return result;
+}
+
+//! Render all products in a list, merging them in the Z-buffer. Flat
+//! version of scs_traverse_products().
+bool scs_traverse_products(const Product_List &list, GLint *dims, ZValue *zmerged)
+{
+   bool first = true;
+   unsigned int i = 0;
+
+   // The products in a group are only drawn where its box is on the screen,
+   // and the ones that are off the screen are not drawn at all. Partial
+   // rendering and the split screen want to see every pass in full, though.
+   if (render_partial == -1 && render_type != RENDER_CSG_SPLIT_SCREEN)
+      for (unsigned int g = 0; g < list.groups.size(); ++g)
+      {
+         const Product_List::Group &group = list.groups[g];
+         GLint rect[4];
+         if (!screen_rect(group.bounds, dims, rect))
+         {
+            i = group.products_end;
+            continue;
+         }
+         for (; i < group.products_end; ++i, first = false)
+            // The first product clears the whole Z-buffer.
+            if (first ? !scs_merge_product(list, list.products[i], true,
+                                           dims, zmerged)
+                      : !scs_merge_product_in(list, list.products[i], dims,
+                                              rect, zmerged))
+               return false;
+      }
+
+   for (; i < list.products.size(); ++i, first = false)
+      if (!scs_merge_product(list, list.products[i], first, dims, zmerged))
+         return false;
+
+   if (first)
+   {
+      // Nothing to see.
+      glDepthMask(GL_TRUE);
+      glClearDepth(1.0);
+      glClear(GL_DEPTH_BUFFER_BIT);
+   }
+   return true;
+}
+
+//! Render all products from a stream, merging them in the Z-buffer. Only
+//! one product at a time is ever held in memory.
+bool scs_traverse_products(Product_Stream &stream, GLint *dims, ZValue *zmerged)
+{
+   Product_List product;
+   stream.rewind();
+   for (bool first = true; stream.next(product); first = false)
+      if (!scs_merge_product(product, product.products[0], first, dims, zmerged))
+         return false;
+   DBG(cout << "Streamed " << stream.count() << " products" << endl);
+   return true;
+}
+
+//! Render a normalized CSG tree to the Z-buffer. Uses the flat product
+//! list or the product stream instead, if there is one.
+void scs_render(const CSG_Node *tree, const Product_List *products,
+                Product_Stream *stream)
 {
   if (render_type == RENDER_NO_CSG ||
       render_type == RENDER_NO_CSG_Z)
@@ -405,7 +915,12 @@ void scs_render(const CSG_Node *tree)
    }
    DBG(cout << "   ...done" << endl);
 
-   scs_traverse_products(tree, true, usedDims, zmerged);
+   if (stream)
+      scs_traverse_products(*stream, usedDims, zmerged);
+   else if (products)
+      scs_traverse_products(*products, usedDims, zmerged);
+   else
+      scs_traverse_products(tree, usedDims, zmerged);
 
    if (render_type == RENDER_CSG_SPLIT_SCREEN)
    {
@@ -454,19 +969,79 @@ void render_with_workaround(const CSG_Node *tree, bool csg)
       tree->get_object()->render();
 }
 
-//! Render a tree to the color buffer, using a unique color per object.
-unsigned long render_picking_colors(const CSG_Node *tree, unsigned long color,
-                                    bool csg)
+/*!
+ * Draws the primitives of a tree that does not have to be normalized. In
+ * an unnormalized tree more than right operands of differences can be
+ * subtracted, so it keeps track of which primitives are, and draws them
+ * with their front faces culled when csg is true.
+ */
+class Primitive_Drawer : public CSG_Visitor<const CSG_Node>
 {
-   if(tree->get_type() == CSG_Node::PRIMITIVE)
+public:
+   explicit Primitive_Drawer(bool csg) : _csg(csg) {}
+   virtual ~Primitive_Drawer() {}
+
+   bool enter(const CSG_Node *tree)
+   {
+      // The left operand is subtracted if the operation is.
+      if (tree->get_type() != CSG_Node::PRIMITIVE)
+         _subtracted.push_back(subtracted());
+      return true;
+   }
+
+   bool between(const CSG_Node *tree)
+   {
+      if (tree->get_type() == CSG_Node::DIFFERENCE)
+         _subtracted.back() = !_subtracted.back();
+      return true;
+   }
+
+   void leave(const CSG_Node *tree)
+   {
+      if (tree->get_type() != CSG_Node::PRIMITIVE)
+      {
+         _subtracted.pop_back();
+         return;
+      }
+      glCullFace(_csg && subtracted() ? GL_FRONT : GL_BACK);
+      draw(tree);
+   }
+
+protected:
+   virtual void draw(const CSG_Node *tree) = 0;
+
+   bool _csg;
+
+private:
+   bool subtracted() const
+   {
+      return !_subtracted.empty() && _subtracted.back();
+   }
+
+   vector<bool> _subtracted; //!< One per operation being visited.
+};
+
+//! Draws every primitive in a unique color, see color_to_counter().
+class Picking_Drawer : public Primitive_Drawer
+{
+public:
+   Picking_Drawer(unsigned long color, bool csg) :
+      Primitive_Drawer(csg), color(color)
+   {
+   }
+
+   unsigned long color; //!< The color of the next primitive.
+
+protected:
+   void draw(const CSG_Node *tree)
    {
       GLubyte r =  color        & 0xFF;
       GLubyte g = (color >>  8) & 0xFF;
       GLubyte b = (color >> 16) & 0xFF;
       //cout << "RGB: " << (int)r << " " << (int)g << " " << (int)b << endl;
       glColor3ub(r, g, b);
-      
-      render_with_workaround(tree, csg);
+
+      render_with_workaround(tree, _csg);
 
       r += COLOR_STEP;
       if (!r)
@@ -476,46 +1051,51 @@ unsigned long render_picking_colors(const CSG_Node *tree, unsigned long color,
             b += COLOR_STEP;
       }
 
-      return r | (g << 8) | (b << 16);
-   }
-   else
-   {
-      glCullFace(GL_BACK);
-      color = render_picking_colors(tree->get_left(), color, csg);
-      glCullFace(csg && tree->get_type() == CSG_Node::DIFFERENCE
-                 ? GL_FRONT : GL_BACK);
-      return render_picking_colors(tree->get_right(), color, csg);
+      color = r | (g << 8) | (b << 16);
    }
+};
+
+//! Render a tree to the color buffer, using a unique color per object.
+//! Returns the color after the last one used.
+unsigned long render_picking_colors(const CSG_Node *tree, unsigned long color,
+                                    bool csg)
+{
+   Picking_Drawer drawer(color, csg);
+   visit_tree(tree, drawer);
+   return drawer.color;
 }
 
-//! Returns the object drawn in a certain color.
-const CSG_Node *object_with_picking_color(const CSG_Node *tree,
-                                          unsigned long count =
-                                          (unsigned long)-1)
+//! Looks for the n:th primitive of a tree, counted from 0.
+struct Nth_Primitive : public CSG_Visitor<const CSG_Node>
 {
-   static unsigned long counter;
-   if (count != (unsigned long)-1)
+   explicit Nth_Primitive(unsigned long n) : n(n), found(NULL) {}
+
+   bool enter(const CSG_Node *)
    {
-      if (count)
-         counter = count - 1;
-      else
-         return NULL; // Picked background color
+      return !found;
    }
-   if(tree->get_type() == CSG_Node::PRIMITIVE)
+
+   void leave(const CSG_Node *tree)
    {
-      if (!counter) return tree;
-      --counter;
-      return NULL;
-   }
-   else
-   {
-      const CSG_Node *n;
-      if ((n = object_with_picking_color(tree->get_left())))
-         return n;
-      if ((n = object_with_picking_color(tree->get_right())))
-         return n;
-      return NULL;
+      if (!found && tree->get_type() == CSG_Node::PRIMITIVE && !n--)
+         found = tree;
    }
+
+   unsigned long n;
+   const CSG_Node *found;
+};
+
+//! Returns the object drawn in a certain color, with count from
+//! color_to_counter().
+const CSG_Node *object_with_picking_color(const CSG_Node *tree,
+                                          unsigned long count)
+{
+   if (!count)
+      return NULL; // Picked background color
+
+   Nth_Primitive finder(count - 1);
+   visit_tree(tree, finder);
+   return finder.found;
 }
 
 unsigned long color_to_counter(GLubyte r, GLubyte g, GLubyte b)
@@ -527,11 +1107,14 @@ unsigned long color_to_counter(GLubyte r, GLubyte g, GLubyte b)
 }
 
 
-// Interface function
 // Renders a CSG tree to the Z buffer, and returns the object drawn at
-// the specified image coordinate.
-const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
-                          bool select_invisible)
+// the specified image coordinate. Does the Z passes from stream or
+// products instead of from the tree, unless they are NULL.
+static const CSG_Node *prerender_products(const CSG_Node *tree,
+                                          const Product_List *products,
+                                          Product_Stream *stream,
+                                          int mouse_x, int mouse_y,
+                                          bool select_invisible)
 {
    render_counter = render_partial + 1;
 
@@ -558,7 +1141,7 @@ const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
 
    if (render_type == RENDER_CSG_SPLIT_SCREEN)
    {
-      scs_render(tree);
+      scs_render(tree, products, stream);
    }
    else if (select_invisible)
    {
@@ -581,11 +1164,11 @@ const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
    
       result = object_with_picking_color(tree, count);
 
-      scs_render(tree);
+      scs_render(tree, products, stream);
    }
    else
    {
-      scs_render(tree);
+      scs_render(tree, products, stream);
 
       glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
       glDisable(GL_STENCIL_TEST);
@@ -613,24 +1196,61 @@ const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
    return result;
 }
 
-//! Render a CSG tree using current GL settings.
-void traverse_and_render(const CSG_Node *tree, bool csg)
+// Interface function
+const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
+                          bool select_invisible)
+{
+   return prerender_products(tree, NULL, NULL, mouse_x, mouse_y, select_invisible);
+}
+
+// Interface function
+const CSG_Node *prerender(const CSG_Node *tree, const Product_List &products,
+                          int mouse_x, int mouse_y, bool select_invisible)
+{
+   return prerender_products(tree, &products, NULL, mouse_x, mouse_y, select_invisible);
+}
+
+// Interface function
+const CSG_Node *prerender(const CSG_Node *tree, const CSG_Flat_Tree &normal,
+                          int mouse_x, int mouse_y, bool select_invisible)
 {
-   if(tree->get_type() == CSG_Node::PRIMITIVE)
+   Product_List products;
+   if (!products.assign(normal))
+      return NULL;
+   return prerender_products(tree, &products, NULL, mouse_x, mouse_y,
+                             select_invisible);
+}
+
+// Interface function
+const CSG_Node *prerender(const CSG_Node *tree, Product_Stream &stream,
+                          int mouse_x, int mouse_y, bool select_invisible)
+{
+   return prerender_products(tree, NULL, &stream, mouse_x, mouse_y,
+                             select_invisible);
+}
+
+//! Draws every primitive in its own color.
+class Color_Drawer : public Primitive_Drawer
+{
+public:
+   explicit Color_Drawer(bool csg) : Primitive_Drawer(csg) {}
+
+protected:
+   void draw(const CSG_Node *tree)
    {
       GLfloat r, g, b;
       tree->get_object()->get_color(r, g, b);
       glColor3f(r, g, b);
-      render_with_workaround(tree, csg);
-   }
-   else
-   {
-      glCullFace(GL_BACK);
-      traverse_and_render(tree->get_left(), csg);
-      glCullFace(csg && tree->get_type() == CSG_Node::DIFFERENCE
-                 ? GL_FRONT : GL_BACK);
-      traverse_and_render(tree->get_right(), csg);
+      render_with_workaround(tree, _csg);
    }
+};
+
+//! Render a CSG tree using current GL settings. The tree does not have to
+//! be normalized, see Primitive_Drawer.
+void traverse_and_render(const CSG_Node *tree, bool csg)
+{
+   Color_Drawer drawer(csg);
+   visit_tree(tree, drawer);
 }
 
 //! Render CSG normally.
@@ -776,6 +1396,11 @@ void set_render_whole()
    render_partial = -1;
 }
 
+void set_overlap_graph(const Overlap_Graph *graph)
+{
+   overlap_graph = graph;
+}
+
 // Interface function
 // Draws the final image in the color buffer.
 void render(const CSG_Node *tree)
@@ -32,6 +32,10 @@
 #define __RENDERER_INTERFACE_H__
 
 #include "csg_tree.h"
+#include "csg_flat.h"
+#include "product_list.h"
+#include "product_stream.h"
+#include "overlap_graph.h"
 
 /*!
  * Does all the magic stuff for CSG rendering, but doesn't draw to the color
@@ -54,12 +58,54 @@
 const CSG_Node *prerender(const CSG_Node *tree, int mouse_x, int mouse_y,
                           bool select_invisible = false);
 
+/*!
+ * Like prerender(const CSG_Node *, int, int, bool), but takes the products
+ * of the tree as a flat list, which the Z-buffer passes can walk without
+ * chasing pointers through the tree. The tree is still used for colors and
+ * picking, and does not have to be normalized.
+ *
+ * \param products Must hold the products of the normalized form of tree,
+ *                 e.g. from Product_List::assign(), or the ones of them
+ *                 that are not empty. The products in a Product_List::Group
+ *                 are only drawn where the bounds of the group are on the
+ *                 screen.
+ */
+const CSG_Node *prerender(const CSG_Node *tree, const Product_List &products,
+                          int mouse_x, int mouse_y,
+                          bool select_invisible = false);
+
+/*!
+ * Like prerender(const CSG_Node *, const Product_List &, int, int, bool),
+ * but takes the normalized tree in flat form, and reads the products
+ * straight out of its arrays.
+ *
+ * \param normal The normalized form of tree, in post-order, e.g. from
+ *               normalize(const CSG_Flat_Tree &, CSG_Flat_Tree &).
+ */
+const CSG_Node *prerender(const CSG_Node *tree, const CSG_Flat_Tree &normal,
+                          int mouse_x, int mouse_y,
+                          bool select_invisible = false);
+
+/*!
+ * Like prerender(const CSG_Node *, int, int, bool), but fetches the products
+ * one at a time from a stream instead of from a normalized tree, so the
+ * normalized tree never has to exist.
+ *
+ * \param tree The unnormalized tree that stream enumerates. It is used for
+ *             colors and picking, and must also be given to render().
+ * \param stream Is rewound before use.
+ */
+const CSG_Node *prerender(const CSG_Node *tree, Product_Stream &stream,
+                          int mouse_x, int mouse_y,
+                          bool select_invisible = false);
+
 /*!
  * Uses the Z-buffer values calculated by prerender() to draw the final image
  * into the color buffer. Horrible things will happen if you don't call
  * prerender() first. This is not checked.
  *
- * \param tree The root of the normalized CSG tree to render.
+ * \param tree The root of the normalized CSG tree to render, or the
+ *             unnormalized one if prerender() was given a Product_Stream.
  * \sa prerender()
  */
 void render(const CSG_Node *tree);
@@ -95,4 +141,14 @@ void set_render_partial(int part);
  */
 void set_render_whole();
 
+/*!
+ * Gives prerender() a graph of which primitives overlap which. The
+ * subtracted primitives of a product are then only passed over as many
+ * times as there are in the largest group of them that overlap, instead of
+ * as many times as there are subtracted primitives. The graph must hold
+ * every primitive of the tree that is rendered, and live until it is
+ * replaced. NULL, the default, turns this off.
+ */
+void set_overlap_graph(const Overlap_Graph *graph);
+
 #endif
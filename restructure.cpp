@@ -0,0 +1,553 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file restructure.cpp
+ * Implementation of the tree restructuring pass.
+ */
+
+#include <cassert>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "debug.h"
+#include "csg_visitor.h"
+#include "restructure.h"
+#ifdef DEBUG
+#  include <iostream>
+#endif
+
+using namespace std;
+
+const double Tree_Cost::PRODUCT_WEIGHT = 10;
+
+double Tree_Cost::total() const
+{
+   return PRODUCT_WEIGHT * products + subtractions;
+}
+
+/*!
+ * Sums over the products of an expression. With the number of subtracted
+ * primitives in a product called n, these are enough to get the cost.
+ */
+struct Moments
+{
+   double products;   //!< Number of products.
+   double plain;      //!< Number of products with n = 0.
+   double n;          //!< Sum of n.
+   double n2;         //!< Sum of n^2.
+};
+
+//! The products of A+B are those of A and those of B.
+static Moments add(const Moments &a, const Moments &b)
+{
+   Moments m;
+   m.products = a.products + b.products;
+   m.plain = a.plain + b.plain;
+   m.n = a.n + b.n;
+   m.n2 = a.n2 + b.n2;
+   return m;
+}
+
+//! The products of A*B are every product of A combined with every one of B.
+static Moments multiply(const Moments &a, const Moments &b)
+{
+   Moments m;
+   m.products = a.products * b.products;
+   m.plain = a.plain * b.plain;
+   m.n = a.n * b.products + b.n * a.products;
+   m.n2 = a.n2 * b.products + b.n2 * a.products + 2 * a.n * b.n;
+   return m;
+}
+
+/*!
+ * Calculates the moments of expressions, both as they are and subtracted,
+ * since subtracting a union gives an intersection of subtractions and so on.
+ */
+class Cost_Model
+{
+public:
+   Tree_Cost cost(const CSG_Dag_Node *node);
+
+private:
+   struct Both
+   {
+      Moments positive, negative;
+   };
+
+   struct Folder;
+   friend struct Folder;
+
+   const Both &moments(const CSG_Dag_Node *node);
+
+   map<const CSG_Dag_Node *, Both> _memo;
+};
+
+//! Calculates the moments that are not in the memo yet, bottom up.
+struct Cost_Model::Folder : public CSG_Folder<const CSG_Dag_Node, Cost_Model::Both>
+{
+   Folder(map<const CSG_Dag_Node *, Both> &memo) : memo(memo) {}
+
+   bool find(const CSG_Dag_Node *node, Both &m)
+   {
+      map<const CSG_Dag_Node *, Both>::iterator i = memo.find(node);
+      if(i == memo.end())
+         return false;
+      m = i->second;
+      return true;
+   }
+
+   Both primitive(const CSG_Dag_Node *node)
+   {
+      Moments intersected = { 1, 1, 0, 0 }, subtracted = { 1, 0, 1, 1 };
+      Both m;
+      m.positive = intersected;
+      m.negative = subtracted;
+      return memo[node] = m;
+   }
+
+   Both operation(const CSG_Dag_Node *node, const Both &l, const Both &r)
+   {
+      Both m;
+      switch(node->get_type())
+      {
+         case CSG_Node::UNION:
+            m.positive = add(l.positive, r.positive);
+            m.negative = multiply(l.negative, r.negative);
+            break;
+         case CSG_Node::INTERSECTION:
+            m.positive = multiply(l.positive, r.positive);
+            m.negative = add(l.negative, r.negative);
+            break;
+         case CSG_Node::DIFFERENCE:
+            m.positive = multiply(l.positive, r.negative);
+            m.negative = add(l.negative, r.positive);
+            break;
+         default:
+            assert(!"Unknown node type");
+            break;
+      }
+      return memo[node] = m;
+   }
+
+   map<const CSG_Dag_Node *, Both> &memo;
+};
+
+const Cost_Model::Both &Cost_Model::moments(const CSG_Dag_Node *node)
+{
+   map<const CSG_Dag_Node *, Both>::iterator i = _memo.find(node);
+   if(i != _memo.end())
+      return i->second;
+
+   Folder folder(_memo);
+   fold_tree<Both>(node, folder);
+   return _memo[node];
+}
+
+Tree_Cost Cost_Model::cost(const CSG_Dag_Node *node)
+{
+   Tree_Cost c = { 0, 0 };
+   if(!node)
+      return c;
+
+   // Sum of 1 + n(n - 1) over the products with n > 0.
+   const Moments &m = moments(node).positive;
+   c.products = m.products;
+   c.subtractions = m.n2 - m.n + (m.products - m.plain);
+   return c;
+}
+
+Tree_Cost estimate_cost(const CSG_Dag_Node *node)
+{
+   Cost_Model model;
+   return model.cost(node);
+}
+
+Tree_Cost estimate_cost(const CSG_Node *tree)
+{
+   if(!tree)
+      return estimate_cost((const CSG_Dag_Node *)NULL);
+
+   CSG_Dag dag;
+   return estimate_cost(dag.import(tree));
+}
+
+typedef vector<const CSG_Dag_Node *> Operands;
+
+//! Appends node to operands, unless it is already there.
+static void add_operand(Operands &operands, const CSG_Dag_Node *node)
+{
+   if(find(operands.begin(), operands.end(), node) == operands.end())
+      operands.push_back(node);
+}
+
+//! Collects the operands for flatten_union().
+struct Union_Flattener : public CSG_Visitor<const CSG_Dag_Node>
+{
+   Union_Flattener(Operands &operands) : operands(operands) {}
+
+   bool enter(const CSG_Dag_Node *node)
+   {
+      if(node->get_type() == CSG_Node::UNION)
+         return true;
+      add_operand(operands, node);
+      return false;
+   }
+
+   Operands &operands;
+};
+
+//! Appends the operands of a chain of unions, or node itself.
+static void flatten_union(Operands &operands, const CSG_Dag_Node *node)
+{
+   Union_Flattener flattener(operands);
+   visit_tree(node, flattener);
+}
+
+/*!
+ * Appends the intersected operands of a product made of intersections and
+ * differences to operands, and the subtracted ones to subtrahends.
+ */
+static void flatten_product(Operands &operands, Operands &subtrahends,
+                            const CSG_Dag_Node *node)
+{
+   // The second member is true for the right operands of differences.
+   vector<pair<const CSG_Dag_Node *, bool> > stack(1, make_pair(node, false));
+   while(!stack.empty())
+   {
+      node = stack.back().first;
+      bool subtracted = stack.back().second;
+      stack.pop_back();
+
+      if(subtracted)
+         flatten_union(subtrahends, node);
+      else if(node->get_type() == CSG_Node::INTERSECTION ||
+              node->get_type() == CSG_Node::DIFFERENCE)
+      {
+         stack.push_back(make_pair(node->get_right(),
+                                   node->get_type() == CSG_Node::DIFFERENCE));
+         stack.push_back(make_pair(node->get_left(), false));
+      }
+      else
+         add_operand(operands, node);
+   }
+}
+
+static bool is_product(const CSG_Dag_Node *node)
+{
+   return node->get_type() == CSG_Node::INTERSECTION ||
+          node->get_type() == CSG_Node::DIFFERENCE;
+}
+
+/*!
+ * Lists the operands below a node that Restructurer::restructure() would
+ * be called on, and that are not in its memo, with every operand after its
+ * own operands. Restructuring them in that order never recurses deeply.
+ */
+class Operand_Lister : public CSG_Visitor<const CSG_Dag_Node>
+{
+public:
+   Operand_Lister(const map<const CSG_Dag_Node *, const CSG_Dag_Node *> &memo) :
+      _memo(memo)
+   {
+   }
+
+   bool enter(const CSG_Dag_Node *node)
+   {
+      if(node->get_type() == CSG_Node::PRIMITIVE || _memo.count(node) ||
+         !_seen.insert(node).second)
+         return false;
+      _path.push_back(node);
+      return true;
+   }
+
+   void leave(const CSG_Dag_Node *node)
+   {
+      _path.pop_back();
+      if(_path.empty())
+         return;
+
+      // Flattening goes through unions in unions, through products in
+      // products, and through unions subtracted from products.
+      const CSG_Dag_Node *parent = _path.back();
+      bool operand;
+      if(parent->get_type() == CSG_Node::UNION)
+         operand = node->get_type() != CSG_Node::UNION;
+      else if(parent->get_type() == CSG_Node::INTERSECTION)
+         operand = !is_product(node);
+      else
+         operand = (node == parent->get_left() && !is_product(node)) ||
+                   (node == parent->get_right() &&
+                    node->get_type() != CSG_Node::UNION);
+      if(operand)
+         operands.push_back(node);
+   }
+
+   Operands operands;
+
+private:
+   const map<const CSG_Dag_Node *, const CSG_Dag_Node *> &_memo;
+   set<const CSG_Dag_Node *> _seen;
+   Operands _path;
+};
+
+//! True if a contains b, i.e. if b is a, or a product with a as an operand.
+static bool contains(const CSG_Dag_Node *a, const CSG_Dag_Node *b)
+{
+   if(a == b)
+      return true;
+   if(b->get_type() != CSG_Node::INTERSECTION &&
+      b->get_type() != CSG_Node::DIFFERENCE)
+      return false;
+
+   Operands operands, subtrahends;
+   flatten_product(operands, subtrahends, b);
+   return find(operands.begin(), operands.end(), a) != operands.end();
+}
+
+/*!
+ * Does the actual restructuring of expressions in one DAG, and remembers
+ * what it has already done.
+ */
+class Restructurer
+{
+public:
+   Restructurer(CSG_Dag &dag) : _dag(dag) {}
+
+   //! Returns an equivalent and cheaper expression, or NULL if it is empty.
+   const CSG_Dag_Node *restructure(const CSG_Dag_Node *node);
+
+private:
+   const CSG_Dag_Node *rebuild_union(const CSG_Dag_Node *node);
+   const CSG_Dag_Node *rebuild_product(const CSG_Dag_Node *node);
+   const CSG_Dag_Node *build_product(Operands operands, const Operands &subtrahends);
+   const CSG_Dag_Node *build_chain(CSG_Node::CSG_Type type, const Operands &operands);
+   bool factor(Operands &operands, const Operands &subtrahends);
+
+   CSG_Dag &_dag;
+   Cost_Model _model;
+   map<const CSG_Dag_Node *, const CSG_Dag_Node *> _memo;
+};
+
+const CSG_Dag_Node *Restructurer::build_chain(CSG_Node::CSG_Type type,
+                                              const Operands &operands)
+{
+   assert(!operands.empty());
+   const CSG_Dag_Node *result = operands[0];
+   for(unsigned long i = 1; i < operands.size(); ++i)
+      result = _dag.operation(type, result, operands[i]);
+   return result;
+}
+
+const CSG_Dag_Node *Restructurer::rebuild_union(const CSG_Dag_Node *node)
+{
+   Operands raw, operands;
+   flatten_union(raw, node);
+   for(unsigned long i = 0; i < raw.size(); ++i)
+   {
+      const CSG_Dag_Node *operand = restructure(raw[i]);
+      if(operand)
+         flatten_union(operands, operand);
+   }
+
+   // A+(A*B) = A, A+(A-B) = A
+   Operands kept;
+   for(unsigned long i = 0; i < operands.size(); ++i)
+   {
+      bool absorbed = false;
+      for(unsigned long j = 0; j < operands.size() && !absorbed; ++j)
+         absorbed = i != j && contains(operands[j], operands[i]);
+      if(!absorbed)
+         kept.push_back(operands[i]);
+   }
+
+   return kept.empty() ? NULL : build_chain(CSG_Node::UNION, kept);
+}
+
+const CSG_Dag_Node *Restructurer::build_product(Operands operands,
+                                                const Operands &subtrahends)
+{
+   // A*(A+B) = A
+   for(unsigned long i = 0; i < operands.size(); ++i)
+   {
+      if(operands[i]->get_type() != CSG_Node::UNION)
+         continue;
+      Operands terms;
+      flatten_union(terms, operands[i]);
+      for(unsigned long j = 0; j < operands.size(); ++j)
+         if(j != i && find(terms.begin(), terms.end(), operands[j]) != terms.end())
+         {
+            operands.erase(operands.begin() + i--);
+            break;
+         }
+   }
+
+   // (A*B)-A is empty.
+   for(unsigned long i = 0; i < subtrahends.size(); ++i)
+      if(find(operands.begin(), operands.end(), subtrahends[i]) != operands.end())
+         return NULL;
+
+   const CSG_Dag_Node *result = build_chain(CSG_Node::INTERSECTION, operands);
+   for(unsigned long i = 0; i < subtrahends.size(); ++i)
+      result = _dag.operation(CSG_Node::DIFFERENCE, result, subtrahends[i]);
+   return result;
+}
+
+/*!
+ * Looks for two unions among operands with a term in common, and factors
+ * it out if that makes the product cheaper: (A+B)*(A+C) = A+(B*C).
+ * Returns true if it did.
+ */
+bool Restructurer::factor(Operands &operands, const Operands &subtrahends)
+{
+   const CSG_Dag_Node *current = build_product(operands, subtrahends);
+   if(!current)
+      return false;
+   double current_cost = _model.cost(current).total();
+
+   for(unsigned long i = 0; i < operands.size(); ++i)
+   {
+      if(operands[i]->get_type() != CSG_Node::UNION)
+         continue;
+      Operands a;
+      flatten_union(a, operands[i]);
+
+      for(unsigned long j = i + 1; j < operands.size(); ++j)
+      {
+         if(operands[j]->get_type() != CSG_Node::UNION)
+            continue;
+         Operands b;
+         flatten_union(b, operands[j]);
+
+         for(unsigned long k = 0; k < a.size(); ++k)
+         {
+            if(find(b.begin(), b.end(), a[k]) == b.end())
+               continue;
+
+            Operands rest_a(a), rest_b(b);
+            rest_a.erase(find(rest_a.begin(), rest_a.end(), a[k]));
+            rest_b.erase(find(rest_b.begin(), rest_b.end(), a[k]));
+
+            const CSG_Dag_Node *factored = a[k];
+            if(!rest_a.empty() && !rest_b.empty())
+               factored = restructure(
+                  _dag.operation(CSG_Node::UNION, a[k],
+                                 _dag.operation(CSG_Node::INTERSECTION,
+                                                build_chain(CSG_Node::UNION, rest_a),
+                                                build_chain(CSG_Node::UNION, rest_b))));
+
+            Operands candidate(operands);
+            candidate.erase(candidate.begin() + j);
+            candidate[i] = factored;
+            const CSG_Dag_Node *result = build_product(candidate, subtrahends);
+            if(!result || _model.cost(result).total() < current_cost)
+            {
+               operands = candidate;
+               return true;
+            }
+         }
+      }
+   }
+
+   return false;
+}
+
+const CSG_Dag_Node *Restructurer::rebuild_product(const CSG_Dag_Node *node)
+{
+   Operands raw_operands, raw_subtrahends;
+   flatten_product(raw_operands, raw_subtrahends, node);
+
+   // Restructure the parts, and pull the differences out of them.
+   Operands operands, subtrahends;
+   for(unsigned long i = 0; i < raw_operands.size(); ++i)
+   {
+      const CSG_Dag_Node *operand = restructure(raw_operands[i]);
+      if(!operand)
+         return NULL;
+      flatten_product(operands, subtrahends, operand);
+   }
+   for(unsigned long i = 0; i < raw_subtrahends.size(); ++i)
+   {
+      const CSG_Dag_Node *subtrahend = restructure(raw_subtrahends[i]);
+      if(subtrahend)
+         flatten_union(subtrahends, subtrahend);
+   }
+
+   while(factor(operands, subtrahends))
+      ;
+
+   return build_product(operands, subtrahends);
+}
+
+const CSG_Dag_Node *Restructurer::restructure(const CSG_Dag_Node *node)
+{
+   if(node->get_type() == CSG_Node::PRIMITIVE)
+      return node;
+
+   map<const CSG_Dag_Node *, const CSG_Dag_Node *>::iterator i = _memo.find(node);
+   if(i != _memo.end())
+      return i->second;
+
+   // Restructure the operands first, innermost first, so that the calls
+   // below find them in the memo instead of recursing through the tree.
+   Operand_Lister lister(_memo);
+   visit_tree(node, lister);
+   for(unsigned long k = 0; k < lister.operands.size(); ++k)
+      restructure(lister.operands[k]);
+
+   const CSG_Dag_Node *result = node->get_type() == CSG_Node::UNION
+      ? rebuild_union(node)
+      : rebuild_product(node);
+
+   // Only use the new expression if it is better. Otherwise, keep the
+   // tree the way the user built it.
+   if(result && _model.cost(result).total() >= _model.cost(node).total())
+      result = node;
+
+   _memo[node] = result;
+   return result;
+}
+
+const CSG_Dag_Node *restructure(CSG_Dag &dag, const CSG_Dag_Node *node)
+{
+   Restructurer restructurer(dag);
+   return restructurer.restructure(node);
+}
+
+CSG_Node *restructure(const CSG_Node *tree)
+{
+   if(!tree)
+      return NULL;
+
+   CSG_Dag dag;
+   const CSG_Dag_Node *result = restructure(dag, dag.import(tree));
+
+   DBG(cout << "restructure: cost " << estimate_cost(tree).total() << " -> "
+            << estimate_cost(result).total() << endl);
+
+   return result ? dag.expand(result) : NULL;
+}
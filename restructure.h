@@ -0,0 +1,98 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file restructure.h
+ * Rewrites CSG trees into equivalent ones that are cheaper to normalize
+ * and render.
+ */
+
+#ifndef __RESTRUCTURE_H__
+#define __RESTRUCTURE_H__
+
+#include "csg_tree.h"
+#include "csg_dag.h"
+
+/*!
+ * What rendering the normalized form of a tree is expected to cost,
+ * calculated from the unnormalized tree.
+ */
+struct Tree_Cost
+{
+   //! Number of products in the normalized tree.
+   double products;
+
+   /*!
+    * Total length of the subtraction sequences. The renderer subtracts
+    * the n primitives of a product in a sequence of 1 + n(n - 1) steps.
+    */
+   double subtractions;
+
+   /*!
+    * The two above, weighed together. Every product costs a read and a
+    * write of the whole Z-buffer, which is taken to be worth as much as
+    * PRODUCT_WEIGHT subtraction steps.
+    */
+   double total() const;
+
+   static const double PRODUCT_WEIGHT;
+};
+
+/*!
+ * Calculates the cost of normalizing and rendering tree, without normalizing
+ * it. Primitives that occur more than once are counted every time, just
+ * like normalize() copies them.
+ */
+Tree_Cost estimate_cost(const CSG_Node *tree);
+Tree_Cost estimate_cost(const CSG_Dag_Node *node);
+
+/*!
+ * Returns an equivalent expression that costs less to normalize and render,
+ * or node itself if no cheaper one was found.
+ *
+ * Chains of unions and intersections are flattened, which amounts to
+ * reassociating and commuting them, and differences are moved out of
+ * intersections so that all subtractions of a product end up together.
+ * Operands and subtrahends that occur twice are then removed, as are
+ * operands of unions and intersections that are absorbed by another one
+ * (A+(A*B) = A, A*(A+B) = A). Products that subtract one of their own
+ * operands are empty. Finally, intersections of unions with an operand in
+ * common are factored ((A+B)*(A+C) = A+(B*C)) when that lowers the cost.
+ *
+ * The same primitive can only occur more than once when the same CSG_Object
+ * is in several leaves, so trees built by the modeler, which creates a new
+ * object for every leaf, mostly come back untouched.
+ *
+ * \return The new expression, or NULL if the expression is empty.
+ */
+const CSG_Dag_Node *restructure(CSG_Dag &dag, const CSG_Dag_Node *node);
+
+/*!
+ * Returns a restructured copy of tree, or NULL if tree is empty.
+ * See restructure(CSG_Dag &, const CSG_Dag_Node *).
+ */
+CSG_Node *restructure(const CSG_Node *tree);
+
+#endif
@@ -0,0 +1,183 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file scene_query.cpp
+ * Implementation of the spatial queries on CSG trees.
+ */
+
+#include "csg_visitor.h"
+#include "scene_query.h"
+
+using namespace std;
+
+Frustum::Frustum(const Matrix &clip)
+{
+   // Row r of the matrix; the data is stored column by column.
+   const GLfloat *m = clip.data;
+   for(int axis = 0; axis < 3; ++axis)
+      for(int i = 0; i < 4; ++i)
+      {
+         planes[2 * axis][i] = m[4 * i + 3] + m[4 * i + axis];
+         planes[2 * axis + 1][i] = m[4 * i + 3] - m[4 * i + axis];
+      }
+}
+
+Frustum Frustum::current()
+{
+   Matrix projection, modelview;
+   glGetFloatv(GL_PROJECTION_MATRIX, projection.data);
+   glGetFloatv(GL_MODELVIEW_MATRIX, modelview.data);
+   return Frustum(projection * modelview);
+}
+
+bool Frustum::overlaps(const Bounding_Box &box) const
+{
+   if(box.is_empty())
+      return false;
+
+   // The box is outside a plane if even its corner furthest along the
+   // normal of the plane is.
+   for(int p = 0; p < 6; ++p)
+   {
+      const GLfloat *plane = planes[p];
+      GLfloat distance = plane[3];
+      for(int i = 0; i < 3; ++i)
+         distance += plane[i] * (plane[i] > 0 ? box.max[i] : box.min[i]);
+      if(distance < 0)
+         return false;
+   }
+   return true;
+}
+
+bool Frustum::contains(const Bounding_Box &box) const
+{
+   if(box.is_empty())
+      return true;
+
+   // The box is inside a plane if even its corner furthest against the
+   // normal of the plane is.
+   for(int p = 0; p < 6; ++p)
+   {
+      const GLfloat *plane = planes[p];
+      GLfloat distance = plane[3];
+      for(int i = 0; i < 3; ++i)
+         distance += plane[i] * (plane[i] > 0 ? box.min[i] : box.max[i]);
+      if(distance < 0)
+         return false;
+   }
+   return true;
+}
+
+//! Collects the primitives whose boxes, and those of their ancestors, pass test.
+template <class Test>
+struct Query_Visitor : public CSG_Visitor<const CSG_Node>
+{
+   Query_Visitor(const Test &test, vector<const CSG_Node *> &found) :
+      test(test), found(found)
+   {
+   }
+
+   bool enter(const CSG_Node *tree)
+   {
+      if(!test(tree->get_bounds()))
+         return false;
+      if(tree->get_type() == CSG_Node::PRIMITIVE)
+         found.push_back(tree);
+      return true;
+   }
+
+   const Test &test;
+   vector<const CSG_Node *> &found;
+};
+
+template <class Test>
+static void query(const CSG_Node *tree, const Test &test,
+                  vector<const CSG_Node *> &found)
+{
+   found.clear();
+   if(!tree)
+      return;
+   Query_Visitor<Test> visitor(test, found);
+   visit_tree(tree, visitor);
+}
+
+struct Box_Test
+{
+   explicit Box_Test(const Bounding_Box &box) : box(box) {}
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return box.overlaps(b);
+   }
+
+   const Bounding_Box &box;
+};
+
+struct Ray_Test
+{
+   Ray_Test(const GLfloat *origin, const GLfloat *direction) :
+      origin(origin), direction(direction)
+   {
+   }
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return b.hit_by_ray(origin, direction);
+   }
+
+   const GLfloat *origin;
+   const GLfloat *direction;
+};
+
+struct Frustum_Test
+{
+   explicit Frustum_Test(const Frustum &frustum) : frustum(frustum) {}
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return frustum.overlaps(b);
+   }
+
+   const Frustum &frustum;
+};
+
+void find_in_box(const CSG_Node *tree, const Bounding_Box &box,
+                 vector<const CSG_Node *> &found)
+{
+   query(tree, Box_Test(box), found);
+}
+
+void find_on_ray(const CSG_Node *tree, const GLfloat origin[3],
+                 const GLfloat direction[3], vector<const CSG_Node *> &found)
+{
+   query(tree, Ray_Test(origin, direction), found);
+}
+
+void find_in_frustum(const CSG_Node *tree, const Frustum &frustum,
+                     vector<const CSG_Node *> &found)
+{
+   query(tree, Frustum_Test(frustum), found);
+}
@@ -0,0 +1,90 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file scene_query.h
+ * Finds the primitives of a CSG tree in a part of space.
+ */
+
+#ifndef __SCENE_QUERY_H__
+#define __SCENE_QUERY_H__
+
+#include <vector>
+#include "csg_tree.h"
+#include "bounding_box.h"
+#include "matrix.h"
+
+/*!
+ * The six planes of a view frustum. A point (x, y, z) is inside when
+ * a x + b y + c z + d >= 0 for every plane (a, b, c, d).
+ */
+class Frustum
+{
+public:
+   /*!
+    * Extracts the planes from clip, which transforms world coordinates to
+    * clip coordinates, e.g. the projection matrix times the modelview
+    * matrix.
+    */
+   explicit Frustum(const Matrix &clip);
+
+   //! The frustum of the current OpenGL projection and modelview matrices.
+   static Frustum current();
+
+   //! False if the box is entirely outside the frustum.
+   bool overlaps(const Bounding_Box &box) const;
+
+   //! True if the box is entirely inside the frustum.
+   bool contains(const Bounding_Box &box) const;
+
+   GLfloat planes[6][4];
+};
+
+/*
+ * The queries below return the primitive nodes of tree, from left to
+ * right, whose boxes overlap the region, and whose ancestors' boxes from
+ * CSG_Node::get_bounds() do too. Subtrees whose boxes miss are never
+ * entered, so with the boxes cached, a query costs little more than the
+ * number of nodes it finds. Whatever tree covers inside the region is
+ * bounded by the surfaces of the primitives that are found.
+ */
+
+//! Finds the primitives that can cover something inside box.
+void find_in_box(const CSG_Node *tree, const Bounding_Box &box,
+                 std::vector<const CSG_Node *> &found);
+
+/*!
+ * Finds the primitives that the ray from origin in direction can hit,
+ * e.g. for picking.
+ */
+void find_on_ray(const CSG_Node *tree, const GLfloat origin[3],
+                 const GLfloat direction[3],
+                 std::vector<const CSG_Node *> &found);
+
+//! Finds the primitives that can be seen in frustum.
+void find_in_frustum(const CSG_Node *tree, const Frustum &frustum,
+                     std::vector<const CSG_Node *> &found);
+
+#endif
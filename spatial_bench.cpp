@@ -0,0 +1,378 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file spatial_bench.cpp
+ * Measures how long it takes to build a Spatial_Index, to keep it up to
+ * date while objects are dragged around, and to query it, compared with
+ * looking at the box of every object. Then compares the exact overlap and
+ * distance tests of convex.h with the box test, on random pairs of
+ * primitives. Build with "make release", or the debug output will dominate
+ * the numbers.
+ *
+ * Usage: spatial_bench [--sizes=N,N,...]
+ *
+ * The spheres are spread at random through a cube that grows with their
+ * number, so that every sphere overlaps a few others whatever the size.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+
+#include "csg_object.h"
+#include "spatial_index.h"
+#include "convex.h"
+#include "scene_query.h"
+
+using namespace std;
+
+//! Returns the number of milliseconds of CPU time used since start.
+double ms_since(clock_t start)
+{
+   return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+//! A random number from 0 to max.
+GLfloat random_float(GLfloat max)
+{
+   return max * rand() / RAND_MAX;
+}
+
+//! Milliseconds per operation, or per build.
+struct Spatial_Result
+{
+   double build;
+   double insert;        //!< Per object, one at a time.
+   double drag;          //!< Per moved(), for small steps.
+   double jump;          //!< Per moved(), for moves across the scene.
+   double box[2];        //!< Index, scan of every object.
+   double ray[2];
+   double frustum[2];
+   double overlaps;      //!< All pairs at once.
+   unsigned int height;
+   unsigned long pairs;
+};
+
+//! The objects whose boxes pass test, by looking at every one of them.
+template <class Test>
+void scan(const vector<CSG_Object *> &objects, const Test &test,
+          vector<CSG_Object *> &found)
+{
+   found.clear();
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      if (test(objects[i]->get_bounds()))
+         found.push_back(objects[i]);
+}
+
+struct Scan_Box
+{
+   bool operator()(const Bounding_Box &b) const { return box.overlaps(b); }
+   Bounding_Box box;
+};
+
+struct Scan_Ray
+{
+   bool operator()(const Bounding_Box &b) const
+   {
+      return b.hit_by_ray(origin, direction);
+   }
+   GLfloat origin[3], direction[3];
+};
+
+struct Scan_Frustum
+{
+   Scan_Frustum(const Matrix &clip) : frustum(clip) {}
+   bool operator()(const Bounding_Box &b) const { return frustum.overlaps(b); }
+   Frustum frustum;
+};
+
+Spatial_Result measure(const vector<CSG_Object *> &objects, GLfloat side)
+{
+   const int n = objects.size();
+   const int queries = 1000;
+   Spatial_Result result;
+   Spatial_Index index;
+   vector<CSG_Object *> found;
+   clock_t start;
+
+   start = clock();
+   index.build(objects);
+   result.build = ms_since(start);
+
+   {
+      Spatial_Index one_by_one;
+      start = clock();
+      for (int i = 0; i < n; ++i)
+         one_by_one.insert(objects[i]);
+      result.insert = ms_since(start) / n;
+   }
+
+   // Drag a tenth of the objects a hundred small steps each, as the mouse
+   // does, and then put them back.
+   int dragged = n / 10 ? n / 10 : 1;
+   start = clock();
+   for (int step = 0; step < 100; ++step)
+      for (int i = 0; i < dragged; ++i)
+      {
+         CSG_Object *object = objects[i];
+         object->set_transform(translate(0.02, 0.01, 0) *
+                               object->get_transform());
+         index.moved(object);
+      }
+   result.drag = ms_since(start) / (100 * dragged);
+   for (int i = 0; i < dragged; ++i)
+   {
+      objects[i]->set_transform(translate(-2, -1, 0) *
+                                objects[i]->get_transform());
+      index.moved(objects[i]);
+   }
+
+   vector<Matrix> places(dragged);
+   for (int i = 0; i < dragged; ++i)
+      places[i] = translate(random_float(side), random_float(side),
+                            random_float(side));
+   start = clock();
+   for (int i = 0; i < dragged; ++i)
+   {
+      objects[i]->set_transform(places[i]);
+      index.moved(objects[i]);
+   }
+   result.jump = ms_since(start) / dragged;
+
+   vector<Scan_Box> boxes(queries);
+   vector<Scan_Ray> rays(queries);
+   for (int q = 0; q < queries; ++q)
+   {
+      for (int i = 0; i < 3; ++i)
+      {
+         boxes[q].box.min[i] = random_float(side);
+         boxes[q].box.max[i] = boxes[q].box.min[i] + 2;
+         rays[q].origin[i] = random_float(side);
+         rays[q].direction[i] = random_float(2) - 1;
+      }
+   }
+
+   // Both ways must find the same number of objects.
+   for (int q = 0; q < 100; ++q)
+   {
+      vector<CSG_Object *> scanned;
+      index.find_in_box(boxes[q].box, found);
+      scan(objects, boxes[q], scanned);
+      bool same = found.size() == scanned.size();
+      index.find_on_ray(rays[q].origin, rays[q].direction, found);
+      scan(objects, rays[q], scanned);
+      if (!same || found.size() != scanned.size())
+         cout << "Different objects found" << endl;
+   }
+
+   for (int indexed = 1; indexed >= 0; --indexed)
+   {
+      start = clock();
+      for (int q = 0; q < queries; ++q)
+         if (indexed)
+            index.find_in_box(boxes[q].box, found);
+         else
+            scan(objects, boxes[q], found);
+      result.box[1 - indexed] = ms_since(start) / queries;
+
+      start = clock();
+      for (int q = 0; q < queries; ++q)
+         if (indexed)
+            index.find_on_ray(rays[q].origin, rays[q].direction, found);
+         else
+            scan(objects, rays[q], found);
+      result.ray[1 - indexed] = ms_since(start) / queries;
+
+      // A view of the middle quarter of the scene, through all of it.
+      Scan_Frustum view(scale(4, 4, 2) * translate(-0.5, -0.5, -0.5) *
+                        scale(1.0 / side, 1.0 / side, 1.0 / side));
+      start = clock();
+      for (int q = 0; q < queries / 10; ++q)
+         if (indexed)
+            index.find_in_frustum(view.frustum, found);
+         else
+            scan(objects, view, found);
+      result.frustum[1 - indexed] = ms_since(start) / (queries / 10);
+   }
+
+   vector<pair<CSG_Object *, CSG_Object *> > pairs;
+   start = clock();
+   index.find_overlaps(pairs);
+   result.overlaps = ms_since(start);
+   result.pairs = pairs.size();
+   result.height = index.height();
+
+   return result;
+}
+
+//! A primitive of random type, rotation and size near the origin.
+CSG_Object *random_primitive()
+{
+   CSG_Object *object;
+   switch (rand() % 3)
+   {
+      case 0: object = new CSG_Object_Cube(); break;
+      case 1: object = new CSG_Object_Cylinder(); break;
+      default: object = new CSG_Object_Sphere(); break;
+   }
+   object->set_transform(translate(random_float(3), random_float(3),
+                                   random_float(3)) *
+                         rotate(random_float(6.3), random_float(2) - 1,
+                                random_float(2) - 1, random_float(2) - 1) *
+                         scale(0.5 + random_float(2), 0.5 + random_float(2),
+                               0.5 + random_float(2)));
+   return object;
+}
+
+/*!
+ * Times the box test, the exact overlap test and the distance on the same
+ * random pairs, and counts how many pairs with overlapping boxes the exact
+ * test finds apart: the pairs pruning can now remove.
+ */
+void measure_exact(int n)
+{
+   vector<CSG_Object *> objects;
+   for (int i = 0; i < 2 * n; ++i)
+      objects.push_back(random_primitive());
+
+   unsigned long boxes = 0, overlaps = 0;
+   double distance = 0;
+   clock_t start = clock();
+   for (int i = 0; i < n; ++i)
+      boxes += objects[2 * i]->get_bounds().overlaps(objects[2 * i + 1]->get_bounds());
+   double box_ms = ms_since(start);
+
+   start = clock();
+   for (int i = 0; i < n; ++i)
+      overlaps += primitives_overlap(objects[2 * i], objects[2 * i + 1]);
+   double overlap_ms = ms_since(start);
+
+   start = clock();
+   for (int i = 0; i < n; ++i)
+      distance += primitive_distance(objects[2 * i], objects[2 * i + 1]);
+   double distance_ms = ms_since(start);
+
+   cout << endl << "Exact tests on " << n << " random pairs, pairs per second:"
+        << endl << fixed << setprecision(0)
+        << setw(12) << "box" << setw(12) << "overlap" << setw(12) << "distance"
+        << setw(20) << "boxes overlap" << setw(20) << "shapes apart" << endl
+        << setw(12) << n / (box_ms + 1e-3) * 1000
+        << setw(12) << n / (overlap_ms + 1e-3) * 1000
+        << setw(12) << n / (distance_ms + 1e-3) * 1000
+        << setw(20) << boxes << setw(20) << boxes - overlaps << endl;
+   if (distance < 0)
+      cout << "Negative distance" << endl;
+
+   for (unsigned int i = 0; i < objects.size(); ++i)
+      delete objects[i];
+}
+
+//! Prints an index / scan pair of times.
+void print_pair(const double ms[2])
+{
+   ostringstream pair;
+   pair << fixed << setprecision(4) << ms[0] << " / " << ms[1];
+   cout << setw(22) << pair.str();
+}
+
+int main(int argc, char **argv)
+{
+   vector<int> sizes;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      string arg = argv[i];
+      if (arg.compare(0, 8, "--sizes=") == 0)
+      {
+         istringstream in(arg.substr(8));
+         int size;
+         while (in >> size)
+         {
+            if (size > 0)
+               sizes.push_back(size);
+            in.ignore(1);
+         }
+      }
+      else
+      {
+         cout << "Usage: " << argv[0] << " [--sizes=N,N,...]" << endl;
+         return 1;
+      }
+   }
+   if (sizes.empty())
+   {
+      sizes.push_back(1000);
+      sizes.push_back(10000);
+      sizes.push_back(100000);
+   }
+
+   cout << "Milliseconds; the queries are index / scan of every object."
+        << endl << endl;
+   cout << setw(10) << "primitives" << setw(8) << "height"
+        << setw(10) << "build" << setw(10) << "insert"
+        << setw(10) << "drag" << setw(10) << "jump"
+        << setw(22) << "box" << setw(22) << "ray"
+        << setw(22) << "frustum" << setw(10) << "overlaps"
+        << setw(10) << "pairs" << endl;
+
+   srand(1);
+   for (unsigned int s = 0; s < sizes.size(); ++s)
+   {
+      int n = sizes[s];
+      // About two spheres per unit cube.
+      GLfloat side = pow(n / 2.0, 1.0 / 3);
+      vector<CSG_Object *> objects;
+      for (int i = 0; i < n; ++i)
+      {
+         objects.push_back(new CSG_Object_Sphere());
+         objects.back()->set_transform(translate(random_float(side),
+                                                 random_float(side),
+                                                 random_float(side)));
+      }
+
+      Spatial_Result result = measure(objects, side);
+      cout << fixed << setprecision(4)
+           << setw(10) << n << setw(8) << result.height
+           << setw(10) << result.build << setw(10) << result.insert
+           << setw(10) << result.drag << setw(10) << result.jump;
+      print_pair(result.box);
+      print_pair(result.ray);
+      print_pair(result.frustum);
+      cout << setw(10) << result.overlaps << setw(10) << result.pairs << endl;
+
+      for (unsigned int i = 0; i < objects.size(); ++i)
+         delete objects[i];
+   }
+
+   measure_exact(100000);
+
+   return 0;
+}
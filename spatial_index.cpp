@@ -0,0 +1,590 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file spatial_index.cpp
+ * Implementation of the bounding volume hierarchy over primitives.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include "debug.h"
+#include "spatial_index.h"
+
+using namespace std;
+
+//! No node. The parent of the root, and the children of a leaf.
+static const int NO_NODE = -1;
+
+/*!
+ * How much larger than the box of its object the box of a leaf is, as a
+ * fraction of the longest side. Larger margins make moved() rebuild less
+ * often, and the queries visit more nodes.
+ */
+static const GLfloat MARGIN = 0.1;
+
+//! The cost of a box, for choosing where to insert: half its surface area.
+static GLfloat area(const Bounding_Box &box)
+{
+   GLfloat x = box.max[0] - box.min[0];
+   GLfloat y = box.max[1] - box.min[1];
+   GLfloat z = box.max[2] - box.min[2];
+   return x * y + y * z + z * x;
+}
+
+static Bounding_Box united(const Bounding_Box &a, const Bounding_Box &b)
+{
+   Bounding_Box box = a;
+   box.unite(b);
+   return box;
+}
+
+static Bounding_Box fattened(const Bounding_Box &box)
+{
+   GLfloat longest = 0;
+   for(int i = 0; i < 3; ++i)
+      longest = max(longest, box.max[i] - box.min[i]);
+   Bounding_Box fat = box;
+   for(int i = 0; i < 3; ++i)
+   {
+      fat.min[i] -= MARGIN * longest;
+      fat.max[i] += MARGIN * longest;
+   }
+   return fat;
+}
+
+Spatial_Index::Spatial_Index() :
+   _root(NO_NODE), _size(0), _reinsertions(0)
+{
+}
+
+int Spatial_Index::allocate()
+{
+   int node;
+   if(!_free.empty())
+   {
+      node = _free.back();
+      _free.pop_back();
+   }
+   else
+   {
+      node = _nodes.size();
+      _nodes.push_back(Node());
+   }
+   Node &n = _nodes[node];
+   n.parent = n.left = n.right = NO_NODE;
+   n.object = NULL;
+   n.height = 0;
+   return node;
+}
+
+void Spatial_Index::release(int node)
+{
+   _nodes[node].object = NULL;
+   _free.push_back(node);
+}
+
+void Spatial_Index::clear()
+{
+   _nodes.clear();
+   _free.clear();
+   _leaf_of_slot.clear();
+   _root = NO_NODE;
+   _size = 0;
+   _reinsertions = 0;
+}
+
+int Spatial_Index::leaf_of(const CSG_Object *object) const
+{
+   Primitive_Store::Slot slot = object->get_slot();
+   if(slot >= _leaf_of_slot.size())
+      return NO_NODE;
+   int leaf = _leaf_of_slot[slot];
+   if(leaf == NO_NODE || _nodes[leaf].object != object)
+      return NO_NODE;
+   return leaf;
+}
+
+bool Spatial_Index::contains(const CSG_Object *object) const
+{
+   return leaf_of(object) != NO_NODE;
+}
+
+void Spatial_Index::build(const vector<CSG_Object *> &objects)
+{
+   clear();
+   vector<int> leaves;
+   for(unsigned int i = 0; i < objects.size(); ++i)
+   {
+      if(contains(objects[i]))
+         continue;
+      int leaf = allocate();
+      _nodes[leaf].object = objects[i];
+      _nodes[leaf].bounds = objects[i]->get_bounds();
+      _nodes[leaf].box = fattened(_nodes[leaf].bounds);
+      Primitive_Store::Slot slot = objects[i]->get_slot();
+      if(slot >= _leaf_of_slot.size())
+         _leaf_of_slot.resize(slot + 1, NO_NODE);
+      _leaf_of_slot[slot] = leaf;
+      leaves.push_back(leaf);
+   }
+   _size = leaves.size();
+   if(leaves.empty())
+      return;
+   _root = build(leaves, 0, leaves.size(), NO_NODE);
+
+   // Number the nodes in the order the queries visit them, so that the
+   // nodes below a node are next to each other in memory.
+   vector<int> renumbered(_nodes.size(), NO_NODE);
+   vector<Node> nodes;
+   nodes.reserve(_nodes.size());
+   vector<int> stack(1, _root);
+   while(!stack.empty())
+   {
+      int node = stack.back();
+      stack.pop_back();
+      renumbered[node] = nodes.size();
+      nodes.push_back(_nodes[node]);
+      if(_nodes[node].height > 0)
+      {
+         stack.push_back(_nodes[node].right);
+         stack.push_back(_nodes[node].left);
+      }
+   }
+   for(unsigned int node = 0; node < nodes.size(); ++node)
+   {
+      Node &n = nodes[node];
+      if(n.parent != NO_NODE)
+         n.parent = renumbered[n.parent];
+      if(n.height > 0)
+      {
+         n.left = renumbered[n.left];
+         n.right = renumbered[n.right];
+      }
+      else
+         _leaf_of_slot[n.object->get_slot()] = node;
+   }
+   _nodes.swap(nodes);
+   _root = 0;
+
+   DBG(cout << "Spatial_Index::build: " << _size << " objects, height "
+            << height() << endl);
+}
+
+//! Builds the hierarchy of leaves[first] to leaves[last - 1].
+int Spatial_Index::build(vector<int> &leaves, unsigned int first,
+                         unsigned int last, int parent)
+{
+   if(last - first == 1)
+   {
+      _nodes[leaves[first]].parent = parent;
+      return leaves[first];
+   }
+
+   // Split at the median center along the axis where the centers are
+   // furthest apart.
+   Bounding_Box centers;
+   for(unsigned int i = first; i < last; ++i)
+   {
+      const Bounding_Box &box = _nodes[leaves[i]].box;
+      centers.add_point((box.min[0] + box.max[0]) / 2,
+                        (box.min[1] + box.max[1]) / 2,
+                        (box.min[2] + box.max[2]) / 2);
+   }
+   int axis = 0;
+   for(int i = 1; i < 3; ++i)
+      if(centers.max[i] - centers.min[i] >
+         centers.max[axis] - centers.min[axis])
+         axis = i;
+
+   vector<pair<GLfloat, int> > order;
+   for(unsigned int i = first; i < last; ++i)
+   {
+      const Bounding_Box &box = _nodes[leaves[i]].box;
+      order.push_back(make_pair(box.min[axis] + box.max[axis], leaves[i]));
+   }
+   unsigned int middle = order.size() / 2;
+   nth_element(order.begin(), order.begin() + middle, order.end());
+   for(unsigned int i = 0; i < order.size(); ++i)
+      leaves[first + i] = order[i].second;
+
+   int node = allocate();
+   int left = build(leaves, first, first + middle, node);
+   int right = build(leaves, first + middle, last, node);
+   Node &n = _nodes[node];
+   n.parent = parent;
+   n.left = left;
+   n.right = right;
+   n.box = united(_nodes[left].box, _nodes[right].box);
+   n.height = 1 + max(_nodes[left].height, _nodes[right].height);
+   return node;
+}
+
+void Spatial_Index::insert(CSG_Object *object)
+{
+   if(contains(object))
+      return;
+   int leaf = allocate();
+   _nodes[leaf].object = object;
+   _nodes[leaf].bounds = object->get_bounds();
+   _nodes[leaf].box = fattened(_nodes[leaf].bounds);
+   Primitive_Store::Slot slot = object->get_slot();
+   if(slot >= _leaf_of_slot.size())
+      _leaf_of_slot.resize(slot + 1, NO_NODE);
+   _leaf_of_slot[slot] = leaf;
+   insert_leaf(leaf);
+   _size++;
+}
+
+void Spatial_Index::remove(const CSG_Object *object)
+{
+   int leaf = leaf_of(object);
+   if(leaf == NO_NODE)
+      return;
+   remove_leaf(leaf);
+   release(leaf);
+   _leaf_of_slot[object->get_slot()] = NO_NODE;
+   _size--;
+}
+
+void Spatial_Index::moved(const CSG_Object *object)
+{
+   int leaf = leaf_of(object);
+   if(leaf == NO_NODE)
+      return;
+   const Bounding_Box &box = object->get_bounds();
+   _nodes[leaf].bounds = box;
+   if(_nodes[leaf].box.contains(box))
+      return;
+
+   remove_leaf(leaf);
+   _nodes[leaf].box = fattened(box);
+   insert_leaf(leaf);
+   _reinsertions++;
+}
+
+/*!
+ * Puts a leaf next to the node where it adds the least area to the
+ * hierarchy, counting both the new parent and the growth of the boxes on
+ * the way down.
+ */
+void Spatial_Index::insert_leaf(int leaf)
+{
+   if(_root == NO_NODE)
+   {
+      _root = leaf;
+      _nodes[leaf].parent = NO_NODE;
+      return;
+   }
+
+   const Bounding_Box box = _nodes[leaf].box;
+   int sibling = _root;
+   while(_nodes[sibling].height > 0)
+   {
+      const Node &n = _nodes[sibling];
+      GLfloat combined = area(united(n.box, box));
+      GLfloat here = 2 * combined;
+      // Going down grows this box all the same.
+      GLfloat inherited = 2 * (combined - area(n.box));
+
+      GLfloat cost[2];
+      int children[2] = { n.left, n.right };
+      for(int c = 0; c < 2; ++c)
+      {
+         const Node &child = _nodes[children[c]];
+         cost[c] = area(united(child.box, box)) + inherited;
+         if(child.height > 0)
+            cost[c] -= area(child.box);
+      }
+
+      if(here < cost[0] && here < cost[1])
+         break;
+      sibling = cost[0] < cost[1] ? children[0] : children[1];
+   }
+
+   int old_parent = _nodes[sibling].parent;
+   int parent = allocate();
+   Node &p = _nodes[parent];
+   p.parent = old_parent;
+   p.left = sibling;
+   p.right = leaf;
+   p.box = united(_nodes[sibling].box, box);
+   p.height = _nodes[sibling].height + 1;
+   _nodes[sibling].parent = parent;
+   _nodes[leaf].parent = parent;
+   if(old_parent == NO_NODE)
+      _root = parent;
+   else
+      replace_child(old_parent, sibling, parent);
+
+   refit_from(old_parent);
+}
+
+//! Takes a leaf out of the hierarchy, and drops its parent.
+void Spatial_Index::remove_leaf(int leaf)
+{
+   if(leaf == _root)
+   {
+      _root = NO_NODE;
+      return;
+   }
+
+   int parent = _nodes[leaf].parent;
+   int grandparent = _nodes[parent].parent;
+   int sibling = _nodes[parent].left == leaf ? _nodes[parent].right :
+      _nodes[parent].left;
+
+   _nodes[sibling].parent = grandparent;
+   if(grandparent == NO_NODE)
+      _root = sibling;
+   else
+      replace_child(grandparent, parent, sibling);
+   release(parent);
+   _nodes[leaf].parent = NO_NODE;
+
+   refit_from(grandparent);
+}
+
+void Spatial_Index::replace_child(int parent, int old_child, int new_child)
+{
+   Node &p = _nodes[parent];
+   if(p.left == old_child)
+      p.left = new_child;
+   else
+      p.right = new_child;
+}
+
+//! Rebalances and recomputes the boxes from node up to the root.
+void Spatial_Index::refit_from(int node)
+{
+   while(node != NO_NODE)
+   {
+      node = balance(node);
+      Node &n = _nodes[node];
+      n.box = united(_nodes[n.left].box, _nodes[n.right].box);
+      n.height = 1 + max(_nodes[n.left].height, _nodes[n.right].height);
+      node = n.parent;
+   }
+}
+
+/*!
+ * If one child of node is more than one level higher than the other, lifts
+ * the higher child into the place of node, and gives node its lower
+ * grandchild. Returns the node that is now in the place of node.
+ */
+int Spatial_Index::balance(int a)
+{
+   Node &na = _nodes[a];
+   if(na.height < 2)
+      return a;
+
+   int b = na.left;
+   int c = na.right;
+   int skew = _nodes[c].height - _nodes[b].height;
+   if(skew >= -1 && skew <= 1)
+      return a;
+
+   // Lift the higher child into the place of a.
+   int up = skew > 1 ? c : b;
+   int stays = skew > 1 ? b : c;
+   Node &nu = _nodes[up];
+   int f = nu.left;
+   int g = nu.right;
+
+   nu.left = a;
+   nu.parent = na.parent;
+   na.parent = up;
+   if(nu.parent == NO_NODE)
+      _root = up;
+   else
+      replace_child(nu.parent, a, up);
+
+   // The higher grandchild goes with up, the lower one to a.
+   int high = _nodes[f].height > _nodes[g].height ? f : g;
+   int low = high == f ? g : f;
+   nu.right = high;
+   if(skew > 1)
+      na.right = low;
+   else
+      na.left = low;
+   _nodes[low].parent = a;
+
+   na.box = united(_nodes[stays].box, _nodes[low].box);
+   na.height = 1 + max(_nodes[stays].height, _nodes[low].height);
+   nu.box = united(na.box, _nodes[high].box);
+   nu.height = 1 + max(na.height, _nodes[high].height);
+   return up;
+}
+
+/*!
+ * Walks the nodes whose boxes pass test, and collects the objects of the
+ * leaves whose objects' boxes do. Below a node whose box is entirely
+ * inside the region, every leaf is collected without testing.
+ */
+template <class Test>
+void Spatial_Index::query(const Test &test, vector<CSG_Object *> &found) const
+{
+   found.clear();
+   if(_root == NO_NODE)
+      return;
+
+   // Every node comes with whether an ancestor is inside the region.
+   vector<pair<int, bool> > stack(1, make_pair(_root, false));
+   while(!stack.empty())
+   {
+      const Node &n = _nodes[stack.back().first];
+      bool inside = stack.back().second;
+      stack.pop_back();
+      if(!inside)
+      {
+         if(!test(n.box))
+            continue;
+         inside = n.height > 0 && test.contains(n.box);
+      }
+
+      if(n.height == 0)
+      {
+         if(inside || test(n.bounds))
+            found.push_back(n.object);
+      }
+      else
+      {
+         stack.push_back(make_pair(n.right, inside));
+         stack.push_back(make_pair(n.left, inside));
+      }
+   }
+}
+
+struct Index_Box_Test
+{
+   explicit Index_Box_Test(const Bounding_Box &box) : box(box) {}
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return box.overlaps(b);
+   }
+
+   bool contains(const Bounding_Box &b) const
+   {
+      return box.contains(b);
+   }
+
+   const Bounding_Box &box;
+};
+
+struct Index_Ray_Test
+{
+   Index_Ray_Test(const GLfloat *origin, const GLfloat *direction) :
+      origin(origin), direction(direction)
+   {
+   }
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return b.hit_by_ray(origin, direction);
+   }
+
+   //! A ray has no inside.
+   bool contains(const Bounding_Box &) const
+   {
+      return false;
+   }
+
+   const GLfloat *origin;
+   const GLfloat *direction;
+};
+
+struct Index_Frustum_Test
+{
+   explicit Index_Frustum_Test(const Frustum &frustum) : frustum(frustum) {}
+
+   bool operator()(const Bounding_Box &b) const
+   {
+      return frustum.overlaps(b);
+   }
+
+   bool contains(const Bounding_Box &b) const
+   {
+      return frustum.contains(b);
+   }
+
+   const Frustum &frustum;
+};
+
+void Spatial_Index::find_in_box(const Bounding_Box &box,
+                                vector<CSG_Object *> &found) const
+{
+   query(Index_Box_Test(box), found);
+}
+
+void Spatial_Index::find_on_ray(const GLfloat origin[3],
+                                const GLfloat direction[3],
+                                vector<CSG_Object *> &found) const
+{
+   query(Index_Ray_Test(origin, direction), found);
+}
+
+void Spatial_Index::find_in_frustum(const Frustum &frustum,
+                                    vector<CSG_Object *> &found) const
+{
+   query(Index_Frustum_Test(frustum), found);
+}
+
+/*!
+ * Looks up the box of every object in the hierarchy, and keeps the pairs
+ * where the other leaf has the higher number, so that each pair is found
+ * once.
+ */
+void Spatial_Index::find_overlaps(vector<pair<CSG_Object *, CSG_Object *> >
+                                  &found) const
+{
+   found.clear();
+   vector<CSG_Object *> near;
+   for(unsigned int leaf = 0; leaf < _nodes.size(); ++leaf)
+   {
+      CSG_Object *object = _nodes[leaf].object;
+      if(!object || leaf_of(object) != int(leaf))
+         continue;
+      find_in_box(_nodes[leaf].bounds, near);
+      for(unsigned int i = 0; i < near.size(); ++i)
+         if(leaf_of(near[i]) > int(leaf))
+            found.push_back(make_pair(object, near[i]));
+   }
+}
+
+unsigned int Spatial_Index::size() const
+{
+   return _size;
+}
+
+unsigned int Spatial_Index::height() const
+{
+   return _root == NO_NODE ? 0 : _nodes[_root].height;
+}
+
+unsigned long Spatial_Index::reinsertions() const
+{
+   return _reinsertions;
+}
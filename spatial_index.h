@@ -0,0 +1,150 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file spatial_index.h
+ * A bounding volume hierarchy over primitives, for queries without a CSG
+ * tree.
+ */
+
+#ifndef __SPATIAL_INDEX_H__
+#define __SPATIAL_INDEX_H__
+
+#include <vector>
+#include <utility>
+#include "csg_object.h"
+#include "bounding_box.h"
+#include "scene_query.h"
+
+/*!
+ * A dynamic bounding volume hierarchy over the world-space boxes of a set
+ * of objects. Unlike the queries in scene_query.h, which follow the shape
+ * of a CSG tree, the hierarchy is built from where the objects are, so
+ * objects that are far apart in space are far apart in the hierarchy, no
+ * matter how the CSG tree combines them.
+ *
+ * Every leaf keeps a box that is a bit larger than the box of its object.
+ * When an object has moved, moved() does nothing as long as the object is
+ * still inside that box, and otherwise takes the leaf out and puts it back
+ * where it now fits, refitting the boxes on the two paths to the root.
+ * Dragging an object therefore costs about the depth of the hierarchy per
+ * step, and only now and then.
+ *
+ * Objects are found by slot in primitive_store(), so an object must be
+ * removed before it is deleted. The queries compare against the boxes of
+ * the objects themselves, as they were when the objects were added or last
+ * moved(), and return each object once, in no particular order.
+ */
+class Spatial_Index
+{
+public:
+   Spatial_Index();
+
+   /*!
+    * Replaces the contents with objects, and builds a balanced hierarchy
+    * by splitting them at the median along the longest axis.
+    */
+   void build(const std::vector<CSG_Object *> &objects);
+
+   //! Adds an object. Adding an object twice does nothing.
+   void insert(CSG_Object *object);
+
+   //! Removes an object. Does nothing if it is not in the index.
+   void remove(const CSG_Object *object);
+
+   //! Updates the index after object has been moved, rotated or scaled.
+   void moved(const CSG_Object *object);
+
+   bool contains(const CSG_Object *object) const;
+
+   void clear();
+
+   //! Finds the objects whose boxes overlap box.
+   void find_in_box(const Bounding_Box &box,
+                    std::vector<CSG_Object *> &found) const;
+
+   //! Finds the objects whose boxes the ray from origin in direction hits.
+   void find_on_ray(const GLfloat origin[3], const GLfloat direction[3],
+                    std::vector<CSG_Object *> &found) const;
+
+   //! Finds the objects whose boxes can be seen in frustum.
+   void find_in_frustum(const Frustum &frustum,
+                        std::vector<CSG_Object *> &found) const;
+
+   //! Finds every pair of objects whose boxes overlap, each pair once.
+   void find_overlaps(std::vector<std::pair<CSG_Object *, CSG_Object *> >
+                      &found) const;
+
+   //! Number of objects.
+   unsigned int size() const;
+
+   //! Number of levels below the root, for statistics.
+   unsigned int height() const;
+
+   //! Number of times moved() has had to move a leaf.
+   unsigned long reinsertions() const;
+
+private:
+   Spatial_Index(const Spatial_Index &);
+   void operator=(const Spatial_Index &);
+
+   /*!
+    * A leaf has an object and no children. An inner node has two
+    * children and a box around both of them.
+    */
+   struct Node
+   {
+      Bounding_Box box;
+      Bounding_Box bounds; //!< Box of the object, in leaves.
+      int parent;          //!< -1 for the root.
+      int left;
+      int right;
+      CSG_Object *object;
+      int height;          //!< 0 for leaves.
+   };
+
+   int allocate();
+   void release(int node);
+   int build(std::vector<int> &leaves, unsigned int first, unsigned int last,
+             int parent);
+   void insert_leaf(int leaf);
+   void remove_leaf(int leaf);
+   void refit_from(int node);
+   int balance(int node);
+   void replace_child(int parent, int old_child, int new_child);
+   int leaf_of(const CSG_Object *object) const;
+
+   template <class Test>
+   void query(const Test &test, std::vector<CSG_Object *> &found) const;
+
+   std::vector<Node> _nodes;
+   std::vector<int> _free;
+   std::vector<int> _leaf_of_slot; //!< Leaf of each store slot, or -1.
+   int _root;
+   unsigned int _size;
+   unsigned long _reinsertions;
+};
+
+#endif
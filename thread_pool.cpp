@@ -0,0 +1,148 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file thread_pool.cpp
+ * Implementation of the thread pool.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include "debug.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+Thread_Task::Thread_Task() :
+   _done(false)
+{
+}
+
+Thread_Task::~Thread_Task()
+{
+}
+
+Thread_Pool::Thread_Pool(unsigned int workers) :
+   _stopping(false)
+{
+   pthread_mutex_init(&_mutex, NULL);
+   pthread_cond_init(&_queued, NULL);
+   pthread_cond_init(&_finished, NULL);
+
+   for(unsigned int i = 0; i < workers; ++i)
+   {
+      pthread_t thread;
+      if(pthread_create(&thread, NULL, work, this) != 0)
+      {
+         cout << "Unable to start more than " << i << " worker threads"
+              << endl;
+         break;
+      }
+      _threads.push_back(thread);
+   }
+
+   DBG(cout << "Thread_Pool: " << _threads.size() << " workers" << endl);
+}
+
+Thread_Pool::~Thread_Pool()
+{
+   pthread_mutex_lock(&_mutex);
+   _stopping = true;
+   pthread_cond_broadcast(&_queued);
+   pthread_mutex_unlock(&_mutex);
+
+   for(unsigned int i = 0; i < _threads.size(); ++i)
+      pthread_join(_threads[i], NULL);
+
+   pthread_cond_destroy(&_finished);
+   pthread_cond_destroy(&_queued);
+   pthread_mutex_destroy(&_mutex);
+}
+
+void Thread_Pool::submit(Thread_Task *task)
+{
+   pthread_mutex_lock(&_mutex);
+   task->_done = false;
+   _queue.push_back(task);
+   pthread_cond_signal(&_queued);
+   pthread_mutex_unlock(&_mutex);
+}
+
+void Thread_Pool::wait(Thread_Task *task)
+{
+   pthread_mutex_lock(&_mutex);
+   deque<Thread_Task *>::iterator i = find(_queue.begin(), _queue.end(), task);
+   if(i != _queue.end())
+   {
+      // Nobody has started it, so there is no point in waiting.
+      _queue.erase(i);
+      pthread_mutex_unlock(&_mutex);
+      task->run();
+      finish(task);
+      return;
+   }
+
+   while(!task->_done)
+      pthread_cond_wait(&_finished, &_mutex);
+   pthread_mutex_unlock(&_mutex);
+}
+
+unsigned int Thread_Pool::workers() const
+{
+   return _threads.size();
+}
+
+//! Marks task as done, and wakes up whoever waits for it.
+void Thread_Pool::finish(Thread_Task *task)
+{
+   pthread_mutex_lock(&_mutex);
+   task->_done = true;
+   pthread_cond_broadcast(&_finished);
+   pthread_mutex_unlock(&_mutex);
+}
+
+void *Thread_Pool::work(void *p)
+{
+   Thread_Pool *pool = (Thread_Pool *)p;
+
+   pthread_mutex_lock(&pool->_mutex);
+   for(;;)
+   {
+      while(pool->_queue.empty() && !pool->_stopping)
+         pthread_cond_wait(&pool->_queued, &pool->_mutex);
+      if(pool->_queue.empty())
+         break;
+
+      Thread_Task *task = pool->_queue.front();
+      pool->_queue.pop_front();
+      pthread_mutex_unlock(&pool->_mutex);
+      task->run();
+      pool->finish(task);
+      pthread_mutex_lock(&pool->_mutex);
+   }
+   pthread_mutex_unlock(&pool->_mutex);
+
+   return NULL;
+}
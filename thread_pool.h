@@ -0,0 +1,98 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file thread_pool.h
+ * A fixed set of worker threads that run tasks.
+ */
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+/*!
+ * Work to be done by a Thread_Pool. Derived classes put the work in run().
+ */
+class Thread_Task
+{
+public:
+   Thread_Task();
+   virtual ~Thread_Task();
+
+   virtual void run() = 0;
+
+private:
+   friend class Thread_Pool;
+   bool _done;
+};
+
+/*!
+ * Worker threads that take tasks from a queue, oldest first.
+ *
+ * A thread that waits for a task which no worker has started yet takes it
+ * back and runs it itself. Tasks can therefore submit and wait for tasks of
+ * their own without the pool running out of threads, even with no workers
+ * at all, in which case everything runs in the thread that waits.
+ */
+class Thread_Pool
+{
+public:
+   //! Starts that many worker threads. 0 is fine.
+   explicit Thread_Pool(unsigned int workers);
+
+   //! Stops the workers. All submitted tasks must have been waited for.
+   ~Thread_Pool();
+
+   /*!
+    * Queues task to be run. The caller keeps ownership, and must wait() for
+    * it before deleting it.
+    */
+   void submit(Thread_Task *task);
+
+   //! Returns when task has been run.
+   void wait(Thread_Task *task);
+
+   //! Number of worker threads.
+   unsigned int workers() const;
+
+private:
+   Thread_Pool(const Thread_Pool &);
+   void operator=(const Thread_Pool &);
+
+   static void *work(void *pool);
+   void finish(Thread_Task *task);
+
+   pthread_mutex_t _mutex;
+   pthread_cond_t _queued;   //!< Signalled when a task is submitted.
+   pthread_cond_t _finished; //!< Signalled when a task is done.
+   std::deque<Thread_Task *> _queue;
+   std::vector<pthread_t> _threads;
+   bool _stopping;
+};
+
+#endif
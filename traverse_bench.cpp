@@ -0,0 +1,479 @@
+//
+//   Solid Cheese - a simple CSG-SCS modeler and renderer
+//
+//   Copyright (C) 2003
+//   Simon Eln, Marcus Eriksson, Karl-Johan Karlsson, Nils ster
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+//
+// $Id$
+//
+
+/*!
+ * \file traverse_bench.cpp
+ * Compares the cost of walking CSG trees with the stack on the heap, as the
+ * library does, against plain recursion, on deep and on balanced trees, and
+ * the cost of copying and dropping trees on the heap and in a CSG_Arena.
+ * Then compares the pointer trees with CSG_Flat_Tree, including on a mixed
+ * shape that has something for normalize() to rewrite. Build with "make release", or the debug output will dominate the numbers.
+ *
+ * Usage: traverse_bench [--sizes=N,N,...] [--max-recursive=N]
+ *
+ * The recursive versions are only run on trees no deeper than
+ * --max-recursive, since they crash when the stack runs out.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+
+#include "csg_tree.h"
+#include "csg_object.h"
+#include "csg_visitor.h"
+#include "csg_arena.h"
+#include "csg_flat.h"
+#include "product_list.h"
+#include "normalize.h"
+
+using namespace std;
+
+//! Returns the number of milliseconds of CPU time used since start.
+double ms_since(clock_t start)
+{
+   return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+//! A left-deep chain of unions of n primitives, as deep as it gets.
+CSG_Node *deep_tree(vector<CSG_Object *> &objects, int n)
+{
+   CSG_Node *tree = NULL;
+   for (int i = 0; i < n; ++i)
+   {
+      objects.push_back(new CSG_Object_Sphere());
+      CSG_Node *leaf = new CSG_Node(objects.back());
+      tree = tree ? CSG_Node::create_and_insert(CSG_Node::UNION, tree, leaf) :
+         leaf;
+   }
+   return tree;
+}
+
+//! A balanced tree of unions of n primitives, as shallow as it gets.
+CSG_Node *balanced_tree(vector<CSG_Object *> &objects, int n)
+{
+   vector<CSG_Node *> level;
+   for (int i = 0; i < n; ++i)
+   {
+      objects.push_back(new CSG_Object_Sphere());
+      level.push_back(new CSG_Node(objects.back()));
+   }
+   while (level.size() > 1)
+   {
+      vector<CSG_Node *> next;
+      for (unsigned int i = 0; i + 1 < level.size(); i += 2)
+         next.push_back(CSG_Node::create_and_insert(CSG_Node::UNION,
+                                                    level[i], level[i + 1]));
+      if (level.size() % 2)
+         next.push_back(level.back());
+      level.swap(next);
+   }
+   return level.front();
+}
+
+/*!
+ * A balanced tree of unions of n / 4 terms (A*B)-(C+D), which normalize()
+ * turns into ((A*B)-C)-D.
+ */
+CSG_Node *mixed_tree(vector<CSG_Object *> &objects, int n)
+{
+   vector<CSG_Node *> level;
+   for (int i = 0; i + 4 <= n; i += 4)
+   {
+      CSG_Node *leaves[4];
+      for (int j = 0; j < 4; ++j)
+      {
+         objects.push_back(new CSG_Object_Sphere());
+         leaves[j] = new CSG_Node(objects.back());
+      }
+      level.push_back(CSG_Node::create_and_insert(
+                         CSG_Node::DIFFERENCE,
+                         CSG_Node::create_and_insert(CSG_Node::INTERSECTION,
+                                                     leaves[0], leaves[1]),
+                         CSG_Node::create_and_insert(CSG_Node::UNION,
+                                                     leaves[2], leaves[3])));
+   }
+   while (level.size() > 1)
+   {
+      vector<CSG_Node *> next;
+      for (unsigned int i = 0; i + 1 < level.size(); i += 2)
+         next.push_back(CSG_Node::create_and_insert(CSG_Node::UNION,
+                                                    level[i], level[i + 1]));
+      if (level.size() % 2)
+         next.push_back(level.back());
+      level.swap(next);
+   }
+   return level.empty() ? NULL : level.front();
+}
+
+//! The copy constructor as it was written before it stopped recursing.
+CSG_Node *recursive_copy(const CSG_Node *tree)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      return new CSG_Node(tree->get_object());
+   return CSG_Node::create_and_insert(tree->get_type(),
+                                      recursive_copy(tree->get_left()),
+                                      recursive_copy(tree->get_right()));
+}
+
+//! CSG_Node::stringify() as it was written before it stopped recursing.
+void recursive_stringify(const CSG_Node *tree, string &s)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+   {
+      s += "[ " + tree->get_object()->stringify() + " ]";
+      return;
+   }
+   recursive_stringify(tree->get_left(), s);
+   s += " ";
+   recursive_stringify(tree->get_right(), s);
+   switch (tree->get_type())
+   {
+      case CSG_Node::UNION:
+         s += " + ";
+         break;
+      case CSG_Node::DIFFERENCE:
+         s += " - ";
+         break;
+      default:
+         s += " * ";
+         break;
+   }
+}
+
+int recursive_count(const CSG_Node *tree)
+{
+   if (tree->get_type() == CSG_Node::PRIMITIVE)
+      return 1;
+   return recursive_count(tree->get_left()) + recursive_count(tree->get_right());
+}
+
+//! Counts primitives with fold_tree().
+struct Leaf_Counter : public CSG_Folder<const CSG_Node, int>
+{
+   int primitive(const CSG_Node *)
+   {
+      return 1;
+   }
+
+   int operation(const CSG_Node *, int left, int right)
+   {
+      return left + right;
+   }
+};
+
+//! Milliseconds per run of every operation on one tree.
+struct Traverse_Result
+{
+   double copy[2];      //!< Recursive, iterative.
+   double stringify[2];
+   double count[2];
+   double destroy;
+   double arena_copy;   //!< Copying into an arena.
+   double arena_drop;   //!< Clearing the arena with all the copies.
+   double normalize;
+};
+
+/*!
+ * Runs every operation until at least about a million nodes have been
+ * walked, and returns the average time per run.
+ */
+Traverse_Result measure(const CSG_Node *tree, int n, bool recursive)
+{
+   const int runs = n < 1000000 ? 1000000 / n : 1;
+   Traverse_Result result;
+   clock_t start;
+
+   for (int iterative = recursive ? 0 : 1; iterative < 2; ++iterative)
+   {
+      vector<CSG_Node *> copies(runs);
+      start = clock();
+      for (int r = 0; r < runs; ++r)
+         copies[r] = iterative ? new CSG_Node(*tree) : recursive_copy(tree);
+      result.copy[iterative] = ms_since(start) / runs;
+
+      if (iterative)
+      {
+         start = clock();
+         for (int r = 0; r < runs; ++r)
+            delete copies[r];
+         result.destroy = ms_since(start) / runs;
+      }
+      else
+      {
+         // There is no recursive destructor to compare with.
+         for (int r = 0; r < runs; ++r)
+            delete copies[r];
+      }
+
+      start = clock();
+      for (int r = 0; r < runs; ++r)
+      {
+         string s;
+         if (iterative)
+            s = tree->stringify();
+         else
+            recursive_stringify(tree, s);
+      }
+      result.stringify[iterative] = ms_since(start) / runs;
+
+      int leaves = 0;
+      start = clock();
+      for (int r = 0; r < runs; ++r)
+      {
+         Leaf_Counter counter;
+         leaves += iterative ? fold_tree<int>(tree, counter) :
+            recursive_count(tree);
+      }
+      result.count[iterative] = ms_since(start) / runs;
+      if (leaves != runs * n)
+         cout << "Wrong number of leaves: " << leaves << endl;
+   }
+   if (!recursive)
+      result.copy[0] = result.stringify[0] = result.count[0] = -1;
+
+   CSG_Arena arena;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      new (&arena) CSG_Node(*tree);
+   result.arena_copy = ms_since(start) / runs;
+   start = clock();
+   arena.clear();
+   result.arena_drop = ms_since(start) / runs;
+
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      delete normalize_shared(tree);
+   result.normalize = ms_since(start) / runs;
+
+   return result;
+}
+
+//! Milliseconds per run on one tree, pointer tree and flat tree.
+struct Flat_Result
+{
+   double to_flat;      //!< CSG_Flat_Tree::assign().
+   double to_tree;      //!< CSG_Flat_Tree::to_tree().
+   double stringify[2]; //!< Pointer, flat.
+   double count[2];
+   double normalize[2];
+   double products[2];  //!< Product_List::assign() on the normalized tree.
+};
+
+//! Counts the primitives of a flat tree.
+int flat_count(const CSG_Flat_Tree &flat)
+{
+   int leaves = 0;
+   for (unsigned int i = 0; i < flat.size(); ++i)
+      leaves += flat.types[i] == CSG_Node::PRIMITIVE;
+   return leaves;
+}
+
+Flat_Result measure_flat(const CSG_Node *tree, int n)
+{
+   const int runs = n < 1000000 ? 1000000 / n : 1;
+   Flat_Result result;
+   CSG_Flat_Tree flat;
+   clock_t start;
+
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      flat.assign(tree);
+   result.to_flat = ms_since(start) / runs;
+
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      delete flat.to_tree();
+   result.to_tree = ms_since(start) / runs;
+
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      tree->stringify();
+   result.stringify[0] = ms_since(start) / runs;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      flat.stringify();
+   result.stringify[1] = ms_since(start) / runs;
+
+   int leaves[2] = { 0, 0 };
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+   {
+      Leaf_Counter counter;
+      leaves[0] += fold_tree<int>(tree, counter);
+   }
+   result.count[0] = ms_since(start) / runs;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      leaves[1] += flat_count(flat);
+   result.count[1] = ms_since(start) / runs;
+   if (leaves[0] != leaves[1])
+      cout << "Wrong number of leaves: " << leaves[1] << endl;
+
+   CSG_Node *ntree = NULL;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+   {
+      delete ntree;
+      ntree = normalize_shared(tree);
+   }
+   result.normalize[0] = ms_since(start) / runs;
+   CSG_Flat_Tree nflat;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      normalize(flat, nflat);
+   result.normalize[1] = ms_since(start) / runs;
+   if (nflat.size() != CSG_Flat_Tree(ntree).size())
+      cout << "Different normalized trees" << endl;
+
+   Product_List list;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      list.assign(ntree);
+   result.products[0] = ms_since(start) / runs;
+   start = clock();
+   for (int r = 0; r < runs; ++r)
+      list.assign(nflat);
+   result.products[1] = ms_since(start) / runs;
+
+   delete ntree;
+   return result;
+}
+
+//! Prints a recursive / iterative pair of times, or "-" for a missing one.
+void print_pair(const double ms[2])
+{
+   ostringstream pair;
+   pair << fixed << setprecision(3);
+   if (ms[0] < 0)
+      pair << "-";
+   else
+      pair << ms[0];
+   pair << " / " << ms[1];
+   cout << setw(22) << pair.str();
+}
+
+int main(int argc, char **argv)
+{
+   vector<int> sizes;
+   int max_recursive = 10000;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      string arg = argv[i];
+      if (arg.compare(0, 8, "--sizes=") == 0)
+      {
+         istringstream in(arg.substr(8));
+         int size;
+         while (in >> size)
+         {
+            if (size > 0)
+               sizes.push_back(size);
+            in.ignore(1);
+         }
+      }
+      else if (arg.compare(0, 16, "--max-recursive=") == 0)
+         max_recursive = atoi(arg.c_str() + 16);
+      else
+      {
+         cout << "Usage: " << argv[0] << " [--sizes=N,N,...] "
+              << "[--max-recursive=N]" << endl;
+         return 1;
+      }
+   }
+   if (sizes.empty())
+      for (int size = 1000; size <= 1000000; size *= 10)
+         sizes.push_back(size);
+
+   cout << "Milliseconds per run, recursive / iterative." << endl << endl;
+   cout << setw(10) << "shape" << setw(12) << "primitives"
+        << setw(22) << "copy" << setw(22) << "stringify()"
+        << setw(22) << "count" << setw(10) << "delete"
+        << setw(12) << "arena copy" << setw(12) << "arena drop"
+        << setw(12) << "normalize" << endl;
+   cout << fixed << setprecision(3);
+
+   for (int balanced = 0; balanced < 2; ++balanced)
+      for (unsigned int s = 0; s < sizes.size(); ++s)
+      {
+         int n = sizes[s];
+         vector<CSG_Object *> objects;
+         CSG_Node *tree = balanced ? balanced_tree(objects, n) :
+            deep_tree(objects, n);
+         // A balanced tree is never deeper than the number of bits in n.
+         Traverse_Result result = measure(tree, n,
+                                          balanced || n <= max_recursive);
+
+         cout << setw(10) << (balanced ? "balanced" : "deep")
+              << setw(12) << n;
+         print_pair(result.copy);
+         print_pair(result.stringify);
+         print_pair(result.count);
+         cout << setw(10) << result.destroy << setw(12) << result.arena_copy
+              << setw(12) << result.arena_drop << setw(12) << result.normalize
+              << endl;
+
+         delete tree;
+         for (unsigned int i = 0; i < objects.size(); ++i)
+            delete objects[i];
+      }
+
+   cout << endl << "Milliseconds per run, pointer / flat." << endl << endl;
+   cout << setw(10) << "shape" << setw(12) << "primitives"
+        << setw(10) << "to flat" << setw(10) << "to tree"
+        << setw(22) << "stringify()" << setw(22) << "count"
+        << setw(22) << "normalize" << setw(22) << "products" << endl;
+
+   for (int shape = 0; shape < 3; ++shape)
+      for (unsigned int s = 0; s < sizes.size(); ++s)
+      {
+         int n = sizes[s];
+         vector<CSG_Object *> objects;
+         CSG_Node *tree = shape == 0 ? deep_tree(objects, n) :
+            shape == 1 ? balanced_tree(objects, n) : mixed_tree(objects, n);
+         if (!tree)
+            continue;
+         Flat_Result result = measure_flat(tree, n);
+
+         static const char *names[] = { "deep", "balanced", "mixed" };
+         cout << setw(10) << names[shape] << setw(12) << objects.size()
+              << setw(10) << result.to_flat << setw(10) << result.to_tree;
+         print_pair(result.stringify);
+         print_pair(result.count);
+         print_pair(result.normalize);
+         print_pair(result.products);
+         cout << endl;
+
+         delete tree;
+         for (unsigned int i = 0; i < objects.size(); ++i)
+            delete objects[i];
+      }
+
+   return 0;
+}